@@ -1,14 +1,77 @@
-QT += core gui widgets
+QT += core gui widgets concurrent network
 CONFIG += c++17
 TARGET = nova_editor
 TEMPLATE = app
 
 SOURCES += \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    lineindex.cpp \
+    newlinescanner.cpp \
+    piecetable.cpp \
+    mapguard.cpp \
+    largefileeditor.cpp \
+    gutterrenderer.cpp \
+    decorationlayer.cpp \
+    fileloader.cpp \
+    filesaver.cpp \
+    sessionstore.cpp \
+    cpplexer.cpp \
+    syntaxhighlighter.cpp \
+    cpphighlighter.cpp \
+    textsearch.cpp \
+    foldersearch.cpp \
+    searchpanel.cpp \
+    symbolindex.cpp \
+    outlinepanel.cpp \
+    undohistory.cpp \
+    linediff.cpp \
+    filewatcher.cpp \
+    filereloader.cpp \
+    filefollower.cpp \
+    structureindex.cpp \
+    grammar.cpp \
+    grammarregistry.cpp \
+    grammarhighlighter.cpp \
+    batchrunner.cpp \
+    singleinstance.cpp \
+    tracer.cpp \
+    performancehud.cpp
 
 HEADERS += \
-    mainwindow.h
+    mainwindow.h \
+    lineindex.h \
+    newlinescanner.h \
+    piecetable.h \
+    mapguard.h \
+    largefileeditor.h \
+    gutterrenderer.h \
+    decorationlayer.h \
+    fileloader.h \
+    filesaver.h \
+    sessionstore.h \
+    cpplexer.h \
+    syntaxhighlighter.h \
+    cpphighlighter.h \
+    textsearch.h \
+    foldersearch.h \
+    searchpanel.h \
+    symbolindex.h \
+    outlinepanel.h \
+    undohistory.h \
+    linediff.h \
+    filewatcher.h \
+    filereloader.h \
+    filefollower.h \
+    structureindex.h \
+    grammar.h \
+    grammarregistry.h \
+    grammarhighlighter.h \
+    batchrunner.h \
+    singleinstance.h \
+    tracer.h \
+    performancehud.h \
+    blockdata.h
 
 TRANSLATIONS += translations/ru.ts
 
@@ -0,0 +1,434 @@
+#include "batchrunner.h"
+#include "cpphighlighter.h"
+#include "fileloader.h"
+#include "grammarregistry.h"
+#include <QCommandLineParser>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QVector>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+QMutex outputMutex;
+
+void print(FILE *file, const QString &line)
+{
+    QMutexLocker locker(&outputMutex);
+    std::fputs(qPrintable(line + '\n'), file);
+    std::fflush(file);
+}
+
+bool parseEncoding(const QString &name, BatchRunner::Encoding &encoding)
+{
+    const QString key = name.toLower();
+    if (key == "utf-8" || key == "utf8") {
+        encoding = BatchRunner::Utf8;
+    } else if (key == "utf-8-bom" || key == "utf8-bom") {
+        encoding = BatchRunner::Utf8Bom;
+    } else if (key == "utf-16le" || key == "utf-16") {
+        encoding = BatchRunner::Utf16LE;
+    } else if (key == "utf-16be") {
+        encoding = BatchRunner::Utf16BE;
+    } else if (key == "latin1" || key == "iso-8859-1") {
+        encoding = BatchRunner::Latin1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+TextSearch::Options lineSearch(TextSearch::Options options)
+{
+    options.singleLine = true;
+    return options;
+}
+
+QString megabytes(qint64 bytes)
+{
+    return QString::number(double(bytes) / (1024 * 1024), 'f', 2);
+}
+
+}
+
+// Per-file state, owned by the worker running the file. It holds its own
+// copy of the search, as TextSearch is not shared between threads.
+struct BatchRunner::Stream
+{
+    explicit Stream(const TextSearch &searcher) : searcher(searcher) {}
+
+    TextSearch searcher;
+    QIODevice *output = nullptr;
+    QCryptographicHash outputHash{QCryptographicHash::Md5};
+    Encoding encoding = Utf8;
+    bool crlf = false;
+    bool failed = false;
+    // The first character the target encoding has no bytes for.
+    ushort unencodable = 0;
+    int matches = 0;
+    QString language;
+    QSharedPointer<const Grammar> grammar;
+    CppLexer::State cppState;
+    int grammarState = Grammar::Normal;
+    QVector<CppLexer::Token> tokens;
+
+    void write(const QByteArray &bytes)
+    {
+        if (failed || unencodable || !output) return;
+        outputHash.addData(bytes);
+        failed = output->write(bytes) != bytes.size();
+    }
+};
+
+int BatchRunner::exec(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs the text engine over files without opening a window.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"batch", "Run without a window."},
+        {"find", "Counts matches of <pattern>.", "pattern"},
+        {"replace", "Replaces the matches with <text>; \\1 refers to a group.", "text"},
+        {"regex", "The pattern is a regular expression."},
+        {"case-sensitive", "Matches case."},
+        {"whole-words", "Matches whole words only."},
+        {"line-endings", "Writes line endings as <lf|crlf>; otherwise each line keeps its own.", "style"},
+        {"encoding", "Writes the files as <utf-8|utf-8-bom|utf-16le|utf-16be|latin1>.", "name"},
+        {"html", "Writes a highlighted <file>.html next to each file."},
+        {"jobs", "Runs <n> files at a time (default: one per core).", "n"},
+    });
+    parser.addPositionalArgument("files", "Files to process; - reads the list from standard input.", "[files...]");
+    parser.process(arguments);
+
+    Options options;
+    options.search.pattern = parser.value("find");
+    options.search.regularExpression = parser.isSet("regex");
+    options.search.caseSensitive = parser.isSet("case-sensitive");
+    options.search.wholeWords = parser.isSet("whole-words");
+    options.replace = parser.isSet("replace");
+    options.replacement = parser.value("replace");
+    options.html = parser.isSet("html");
+    if (options.replace && options.search.pattern.isEmpty()) {
+        print(stderr, "--replace needs --find");
+        return 2;
+    }
+    if (!options.search.pattern.isEmpty()) {
+        TextSearch search(options.search);
+        if (!search.isValid()) {
+            print(stderr, search.errorString());
+            return 2;
+        }
+    }
+    if (parser.isSet("line-endings")) {
+        QString style = parser.value("line-endings").toLower();
+        if (style != "lf" && style != "crlf") {
+            print(stderr, QString("Unknown line ending style: %1").arg(style));
+            return 2;
+        }
+        options.lineEnding = style == "lf" ? Lf : CrLf;
+    }
+    if (parser.isSet("encoding") && !parseEncoding(parser.value("encoding"), options.encoding)) {
+        print(stderr, QString("Unknown encoding: %1").arg(parser.value("encoding")));
+        return 2;
+    }
+    if (options.search.pattern.isEmpty() && options.lineEnding == KeepLineEnding && options.encoding == KeepEncoding
+        && !options.html) {
+        print(stderr, "Nothing to do; give --find, --line-endings, --encoding or --html.");
+        return 2;
+    }
+
+    QStringList paths;
+    const QStringList positional = parser.positionalArguments();
+    for (const QString &argument : positional) {
+        if (argument != "-") {
+            paths.append(argument);
+            continue;
+        }
+        QTextStream in(stdin);
+        QString line;
+        while (in.readLineInto(&line)) {
+            if (!line.isEmpty()) paths.append(line);
+        }
+    }
+    if (paths.isEmpty()) {
+        print(stderr, "No files given.");
+        return 2;
+    }
+
+    // Languages are resolved here; the registry is not thread-safe, the
+    // grammars it hands out are.
+    GrammarRegistry registry(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation));
+    QVector<Job> jobs;
+    for (const QString &path : qAsConst(paths)) {
+        Job job;
+        job.path = path;
+        job.size = QFileInfo(path).size();
+        if (options.html) {
+            job.language = registry.languageFor(path);
+            job.grammar = registry.grammar(job.language);
+        }
+        jobs.append(job);
+    }
+    // Big files start first, so one of them does not run alone at the end.
+    std::stable_sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) { return a.size > b.size; });
+
+    QThreadPool pool;
+    if (parser.isSet("jobs")) pool.setMaxThreadCount(qMax(1, parser.value("jobs").toInt()));
+
+    const BatchRunner runner(options);
+    QVector<Result> results(jobs.size());
+    Result *outcomes = results.data();
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < jobs.size(); ++i) {
+        pool.start([&runner, &jobs, outcomes, i]() {
+            const Job &job = jobs.at(i);
+            Result result = runner.process(job);
+            outcomes[i] = result;
+            if (!result.error.isEmpty()) {
+                print(stderr, QString("%1: %2").arg(job.path, result.error));
+                return;
+            }
+            QString line = QString("%1  %2 MB  %3 ms").arg(job.path, megabytes(result.bytes)).arg(result.msecs);
+            if (result.skipped) line += "  skipped (binary)";
+            if (!runner.options.search.pattern.isEmpty()) line += QString("  %1 matches").arg(result.matches);
+            if (result.written) line += "  written";
+            print(stdout, line);
+        });
+    }
+    pool.waitForDone();
+    qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+
+    qint64 bytes = 0;
+    int matches = 0;
+    int written = 0;
+    int failed = 0;
+    for (const Result &result : qAsConst(results)) {
+        bytes += result.bytes;
+        matches += result.matches;
+        written += result.written ? 1 : 0;
+        failed += result.error.isEmpty() ? 0 : 1;
+    }
+    QString summary = QString("%1 files, %2 MB in %3 ms (%4 MB/s, %5 threads)")
+        .arg(jobs.size()).arg(megabytes(bytes)).arg(elapsed)
+        .arg(megabytes(bytes * 1000 / elapsed)).arg(pool.maxThreadCount());
+    if (!options.search.pattern.isEmpty()) summary += QString(", %1 matches").arg(matches);
+    summary += QString(", %1 written").arg(written);
+    if (failed) summary += QString(", %1 failed").arg(failed);
+    print(stdout, summary);
+    return failed ? 1 : 0;
+}
+
+BatchRunner::BatchRunner(const Options &options) : options(options), searcher(lineSearch(options.search))
+{
+    QTextCharFormat formats[CppLexer::TokenKindCount];
+    CppHighlighter::setFormats(formats);
+    for (int kind = 0; kind < CppLexer::TokenKindCount; ++kind) {
+        QString style;
+        if (formats[kind].hasProperty(QTextFormat::ForegroundBrush)) {
+            style += "color:" + formats[kind].foreground().color().name() + ";";
+        }
+        if (formats[kind].fontWeight() == QFont::Bold) style += "font-weight:bold;";
+        styles[kind] = style;
+    }
+}
+
+BatchRunner::Result BatchRunner::process(const Job &job) const
+{
+    Result result;
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile input(job.path);
+    if (!input.open(QFile::ReadOnly)) {
+        result.error = input.errorString();
+        return result;
+    }
+    const QByteArray head = input.peek(BinaryProbe);
+    if (head.contains('\0')) {
+        result.skipped = true;
+        result.msecs = timer.elapsed();
+        return result;
+    }
+
+    Stream stream(searcher);
+    stream.language = job.language;
+    stream.grammar = job.grammar;
+    bool hasBom = head.startsWith("\xEF\xBB\xBF");
+    stream.encoding = options.encoding != KeepEncoding ? options.encoding : hasBom ? Utf8Bom : Utf8;
+    stream.crlf = options.lineEnding == CrLf;
+
+    // Counting matches reads the file and writes nothing.
+    bool rewrite = options.replace || options.encoding != KeepEncoding || options.lineEnding != KeepLineEnding;
+    QSaveFile output(options.html ? job.path + ".html" : job.path);
+    if (options.html || rewrite) {
+        if (!output.open(QFile::WriteOnly)) {
+            result.error = output.errorString();
+            return result;
+        }
+        stream.output = &output;
+    }
+
+    if (options.html) {
+        stream.write("<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>"
+                     + QFileInfo(job.path).fileName().toHtmlEscaped().toUtf8()
+                     + "</title>\n</head>\n<body style=\"background-color:#1e1e1e;color:#f8f8f2\">\n<pre>");
+    } else if (stream.encoding == Utf8Bom) {
+        stream.write("\xEF\xBB\xBF");
+    } else if (stream.encoding == Utf16LE) {
+        stream.write(QByteArray("\xFF\xFE", 2));
+    } else if (stream.encoding == Utf16BE) {
+        stream.write(QByteArray("\xFE\xFF", 2));
+    }
+
+    // Text is handed on in whole lines; a line longer than a chunk simply
+    // waits until its end arrives.
+    QCryptographicHash inputHash(QCryptographicHash::Md5);
+    // Without a style every line keeps the ending it has, so a file with
+    // mixed endings comes back out byte for byte.
+    ChunkDecoder decoder(options.lineEnding != KeepLineEnding || options.html);
+    QString pending;
+    // Just past the last line feed in pending; only newly decoded text is
+    // searched for one, so a very long line is not rescanned on every read.
+    int end = 0;
+    bool invalid = false;
+    while (!stream.failed && !stream.unencodable && !invalid) {
+        QByteArray bytes = input.read(ChunkBytes);
+        if (bytes.isEmpty()) break;
+        result.bytes += bytes.size();
+        inputHash.addData(bytes);
+        QString decoded = decoder.decode(bytes);
+        // Bytes that are not UTF-8 would be lost on the way back out.
+        invalid = rewrite && decoder.hasInvalidInput();
+        int newline = int(decoded.lastIndexOf(QLatin1Char('\n')));
+        if (newline >= 0) end = int(pending.size()) + newline + 1;
+        pending += decoded;
+        if (pending.size() < ChunkChars || end == 0) continue;
+        QString text = pending.left(end);
+        pending.remove(0, end);
+        end = 0;
+        processText(text, stream);
+    }
+    pending += decoder.flush();
+    invalid = invalid || (rewrite && decoder.hasInvalidInput());
+    if (!pending.isEmpty() && !invalid) processText(pending, stream);
+    if (options.html) stream.write("</pre>\n</body>\n</html>\n");
+    result.matches = stream.matches;
+
+    if (input.error() != QFile::NoError) {
+        result.error = input.errorString();
+    } else if (invalid) {
+        result.error = "not valid UTF-8, left unchanged";
+    } else if (stream.unencodable) {
+        QString code = QString::number(stream.unencodable, 16).toUpper().rightJustified(4, QLatin1Char('0'));
+        result.error = QString("U+%1 cannot be written as Latin-1, left unchanged").arg(code);
+    } else if (stream.failed) {
+        result.error = output.errorString();
+    } else if (stream.output && !options.html && stream.outputHash.result() == inputHash.result()) {
+        output.cancelWriting();
+    } else if (stream.output && !output.commit()) {
+        result.error = output.errorString();
+    } else {
+        result.written = stream.output != nullptr;
+    }
+    result.msecs = timer.elapsed();
+    return result;
+}
+
+void BatchRunner::processText(QString &text, Stream &stream) const
+{
+    if (!options.search.pattern.isEmpty()) {
+        if (options.replace) {
+            TextSearch::Replacement replacement = stream.searcher.replaceAll(text, options.replacement);
+            if (replacement.count > 0) text.replace(replacement.from, replacement.to - replacement.from, replacement.text);
+            stream.matches += replacement.count;
+        } else {
+            stream.searcher.findAll(text, [&stream](const TextSearch::Match &) {
+                ++stream.matches;
+                return true;
+            });
+        }
+    }
+
+    if (options.html) {
+        writeHtml(text, stream);
+        return;
+    }
+    if (!stream.output) return;
+    if (stream.encoding == Latin1) {
+        // toLatin1() would write '?' for these without a word.
+        for (QChar c : qAsConst(text)) {
+            if (c.unicode() > 0xFF) {
+                stream.unencodable = c.unicode();
+                return;
+            }
+        }
+    }
+    if (stream.crlf) text.replace(QLatin1String("\n"), QLatin1String("\r\n"));
+    stream.write(encode(text, stream.encoding));
+}
+
+void BatchRunner::writeHtml(const QString &text, Stream &stream) const
+{
+    // Lexed a line at a time like the editor does, carrying the state
+    // across lines and chunks.
+    QString html;
+    int start = 0;
+    while (start < text.size()) {
+        int end = int(text.indexOf(QLatin1Char('\n'), start));
+        if (end < 0) end = int(text.size());
+        const QChar *line = text.constData() + start;
+        int length = end - start;
+
+        stream.tokens.clear();
+        if (stream.language == QLatin1String(GrammarRegistry::CppLanguage)) {
+            CppLexer::lex(line, length, stream.cppState, stream.tokens);
+        } else if (stream.grammar) {
+            stream.grammarState = stream.grammar->lex(line, length, stream.grammarState, stream.tokens);
+        }
+        int at = 0;
+        for (const CppLexer::Token &token : qAsConst(stream.tokens)) {
+            if (token.start < at) continue;
+            html += QString(line + at, token.start - at).toHtmlEscaped();
+            html += "<span style=\"" + styles[token.kind] + "\">";
+            html += QString(line + token.start, token.length).toHtmlEscaped();
+            html += "</span>";
+            at = token.start + token.length;
+        }
+        html += QString(line + at, length - at).toHtmlEscaped();
+        if (end < text.size()) html += QLatin1Char('\n');
+        start = end + 1;
+    }
+    stream.write(html.toUtf8());
+}
+
+QByteArray BatchRunner::encode(const QString &text, Encoding encoding)
+{
+    switch (encoding) {
+    case Latin1:
+        return text.toLatin1();
+    case Utf16LE:
+    case Utf16BE: {
+        QByteArray bytes(int(text.size()) * 2, Qt::Uninitialized);
+        char *data = bytes.data();
+        bool little = encoding == Utf16LE;
+        for (int i = 0; i < text.size(); ++i) {
+            ushort c = text.at(i).unicode();
+            data[2 * i + (little ? 0 : 1)] = char(c & 0xFF);
+            data[2 * i + (little ? 1 : 0)] = char(c >> 8);
+        }
+        return bytes;
+    }
+    default:
+        return text.toUtf8();
+    }
+}
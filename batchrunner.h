@@ -0,0 +1,77 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include "cpplexer.h"
+#include "grammar.h"
+#include "textsearch.h"
+#include <QSharedPointer>
+#include <QStringList>
+
+class QIODevice;
+
+// The text engine without a window: `nova_editor --batch` runs find and
+// replace, line ending and encoding conversion or export of highlighted
+// HTML over a list of files, one file per task on a thread pool. Files are
+// streamed in chunks cut at line ends, so memory stays flat whatever their
+// size. Each line is searched on its own, so a match never spans lines and
+// the results do not depend on where a chunk was cut. Rewritten files go
+// through QSaveFile; a file whose bytes would not change is left alone.
+// Each file is reported as it finishes, with the totals and throughput at
+// the end.
+class BatchRunner
+{
+public:
+    enum Encoding { Utf8, Utf8Bom, Utf16LE, Utf16BE, Latin1, KeepEncoding };
+    enum LineEnding { Lf, CrLf, KeepLineEnding };
+
+    struct Options
+    {
+        TextSearch::Options search;
+        QString replacement;
+        bool replace = false;
+        Encoding encoding = KeepEncoding;
+        LineEnding lineEnding = KeepLineEnding;
+        bool html = false;
+    };
+
+    struct Job
+    {
+        QString path;
+        qint64 size = 0;
+        QString language;
+        QSharedPointer<const Grammar> grammar;
+    };
+
+    struct Result
+    {
+        qint64 bytes = 0;
+        qint64 msecs = 0;
+        int matches = 0;
+        bool written = false;
+        bool skipped = false;
+        QString error;
+    };
+
+    // Parses the command line, runs it and returns the exit code.
+    static int exec(const QStringList &arguments);
+
+    explicit BatchRunner(const Options &options);
+    Result process(const Job &job) const;
+
+private:
+    static const int ChunkBytes = 1024 * 1024;
+    static const int ChunkChars = 1024 * 1024;
+    static const int BinaryProbe = 8192;
+
+    struct Stream;
+
+    void processText(QString &text, Stream &stream) const;
+    void writeHtml(const QString &text, Stream &stream) const;
+    static QByteArray encode(const QString &text, Encoding encoding);
+
+    Options options;
+    TextSearch searcher;
+    QString styles[CppLexer::TokenKindCount];
+};
+
+#endif
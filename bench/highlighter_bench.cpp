@@ -0,0 +1,341 @@
+// Headless benchmark for the C++ highlighter. Runs the lexer alone and the
+// full highlighter (scheduler, QTextLayout formats) over a generated corpus
+// and prints one JSON document, so runs can be diffed over time.
+//
+//   highlighter_bench [--iterations N] [--corpus DIR] [--output FILE]
+
+#include "cpphighlighter.h"
+#include "cpplexer.h"
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPlainTextEdit>
+#include <QTextStream>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<quint64> allocations(0);
+
+#if defined(__GLIBC__)
+// Qt containers allocate with malloc, so count there; operator new ends up
+// here as well.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+}
+#else
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1)) return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+struct Case
+{
+    QString name;
+    QStringList files;
+};
+
+struct Sample
+{
+    qint64 nanoseconds;
+    quint64 allocations;
+};
+
+// Small deterministic generator so every run sees the same corpus.
+class Generator
+{
+public:
+    explicit Generator(quint32 seed) : state(seed) {}
+
+    quint32 next()
+    {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+
+    int below(int n) { return int(next() % quint32(n)); }
+
+    QString identifier()
+    {
+        static const char *const parts[] = {"value", "count", "index", "buffer", "node", "item", "result",
+                                            "left", "right", "size", "data", "name", "cursor", "block"};
+        QString name = QLatin1String(parts[below(14)]);
+        if (below(3) == 0) {
+            QString part = QLatin1String(parts[below(14)]);
+            part[0] = part.at(0).toUpper();
+            name += part;
+        }
+        return name;
+    }
+
+    QString line(int depth)
+    {
+        QString indent(depth * 4, QLatin1Char(' '));
+        switch (below(12)) {
+        case 0: return indent + QString("int %1 = %2;").arg(identifier()).arg(next() % 100000);
+        case 1: return indent + QString("QString %1 = \"%2 \\\"%3\\\"\";").arg(identifier(), identifier(), identifier());
+        case 2: return indent + QString("if (%1 < %2.size() && !%3) {").arg(identifier(), identifier(), identifier());
+        case 3: return indent + QString("// %1 the %2 before %3").arg(identifier(), identifier(), identifier());
+        case 4: return indent + QString("%1->%2(%3, 0x%4, %5.5e-3);").arg(identifier(), identifier(), identifier())
+                                    .arg(next() % 0xFFFF, 0, 16).arg(below(100));
+        case 5: return indent + QString("for (auto &%1 : %2) %3 += static_cast<double>(%1);").arg(identifier(), identifier(), identifier());
+        case 6: return indent + QString("/* %1 */ return %2(%3) + '%4';").arg(identifier(), identifier(), identifier()).arg(QChar('a' + below(26)));
+        case 7: return QString("#include <%1.h>").arg(identifier());
+        case 8: return indent + QString("template <typename T> const T &%1(const T &%2) noexcept;").arg(identifier(), identifier());
+        case 9: return indent + QString("auto %1 = R\"sql(SELECT %2 FROM %3)sql\";").arg(identifier(), identifier(), identifier());
+        case 10: return indent + "}";
+        default: return QString();
+        }
+    }
+
+    QString source(int lines)
+    {
+        QStringList text;
+        text.reserve(lines);
+        for (int i = 0; i < lines; ++i) text.append(line(1 + below(4)));
+        return text.join(QLatin1Char('\n'));
+    }
+
+    QString nestedComments(int lines)
+    {
+        // Block comments do not nest in C++, so inner "/*" must not open a
+        // second level; long spans make the carried state matter.
+        QStringList text;
+        text.reserve(lines);
+        for (int i = 0; i < lines; ++i) {
+            switch (i % 40) {
+            case 0: text.append("/* outer /* inner /* deeper"); break;
+            case 39: text.append(QString("   still comment */ int %1 = 1; /* %2 */").arg(identifier(), identifier())); break;
+            default: text.append(QString("   %1 /* %2 \"%3\" // %4").arg(identifier(), identifier(), identifier(), identifier())); break;
+            }
+        }
+        return text.join(QLatin1Char('\n'));
+    }
+
+    QString longLine(int bytes)
+    {
+        QString text;
+        text.reserve(bytes + 128);
+        while (text.size() < bytes) {
+            text += line(0);
+            text += QLatin1Char(' ');
+        }
+        return text;
+    }
+
+private:
+    quint32 state;
+};
+
+static QList<Case> generatedCorpus()
+{
+    Generator generator(20240601u);
+    QList<Case> cases;
+
+    Case small{"small_files", {}};
+    for (int i = 0; i < 200; ++i) small.files.append(generator.source(200));
+    cases.append(small);
+
+    cases.append(Case{"large_100k_lines", {generator.source(100000)}});
+    cases.append(Case{"nested_block_comments", {generator.nestedComments(50000)}});
+
+    Case longLines{"long_lines", {}};
+    for (int i = 0; i < 4; ++i) longLines.files.append(generator.longLine(1024 * 1024));
+    cases.append(longLines);
+    return cases;
+}
+
+static QList<Case> directoryCorpus(const QString &path)
+{
+    QList<Case> cases;
+    QDir dir(path);
+    const QStringList names = dir.entryList(QDir::Files, QDir::Name);
+    for (const QString &name : names) {
+        QFile file(dir.filePath(name));
+        if (file.open(QFile::ReadOnly)) {
+            cases.append(Case{"corpus/" + name, {QString::fromUtf8(file.readAll())}});
+        }
+    }
+    return cases;
+}
+
+static Sample runLexer(const Case &benchCase)
+{
+    QVector<QStringList> lines;
+    for (const QString &text : benchCase.files) lines.append(text.split(QLatin1Char('\n')));
+
+    QVector<CppLexer::Token> tokens;
+    tokens.reserve(256);
+    quint64 before = allocations.load();
+    QElapsedTimer timer;
+    timer.start();
+    for (const QStringList &file : lines) {
+        CppLexer::State state;
+        for (const QString &line : file) {
+            tokens.clear();
+            CppLexer::lex(line.constData(), line.size(), state, tokens);
+        }
+    }
+    return Sample{timer.nsecsElapsed(), allocations.load() - before};
+}
+
+static Sample runHighlighter(const Case &benchCase)
+{
+    qint64 nanoseconds = 0;
+    quint64 allocated = 0;
+    for (const QString &text : benchCase.files) {
+        QPlainTextEdit editor;
+        editor.resize(800, 600);
+        editor.setPlainText(text);
+
+        quint64 before = allocations.load();
+        QElapsedTimer timer;
+        timer.start();
+        CppHighlighter *highlighter = new CppHighlighter(&editor);
+        while (highlighter->isPending()) {
+            QCoreApplication::processEvents();
+        }
+        nanoseconds += timer.nsecsElapsed();
+        allocated += allocations.load() - before;
+    }
+    return Sample{nanoseconds, allocated};
+}
+
+static QJsonObject report(const Case &benchCase, const QString &mode, QVector<Sample> samples)
+{
+    qint64 bytes = 0;
+    qint64 blocks = 0;
+    for (const QString &text : benchCase.files) {
+        bytes += text.toUtf8().size();
+        blocks += text.count(QLatin1Char('\n')) + 1;
+    }
+
+    std::sort(samples.begin(), samples.end(), [](const Sample &a, const Sample &b) {
+        return a.nanoseconds < b.nanoseconds;
+    });
+    const Sample &median = samples.at(samples.size() / 2);
+
+    QJsonObject result;
+    result["case"] = benchCase.name;
+    result["mode"] = mode;
+    result["files"] = benchCase.files.size();
+    result["bytes"] = bytes;
+    result["blocks"] = blocks;
+    result["median_ns"] = median.nanoseconds;
+    result["min_ns"] = samples.first().nanoseconds;
+    result["ns_per_byte"] = double(median.nanoseconds) / qMax<qint64>(1, bytes);
+    result["blocks_per_sec"] = blocks * 1e9 / qMax<qint64>(1, median.nanoseconds);
+    result["allocations"] = double(median.allocations);
+    result["allocations_per_kb"] = median.allocations * 1024.0 / qMax<qint64>(1, bytes);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    app.setApplicationName("highlighter_bench");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption iterationsOption("iterations", "Runs per case; the median is reported.", "n", "5");
+    QCommandLineOption corpusOption("corpus", "Also benchmark every file in <dir>.", "dir");
+    QCommandLineOption outputOption("output", "Write JSON to <file> instead of stdout.", "file");
+    parser.addOption(iterationsOption);
+    parser.addOption(corpusOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    QList<Case> cases = generatedCorpus();
+    if (parser.isSet(corpusOption)) {
+        cases += directoryCorpus(parser.value(corpusOption));
+    }
+
+    QJsonArray results;
+    for (const Case &benchCase : cases) {
+        QVector<Sample> lexer;
+        QVector<Sample> highlighter;
+        for (int i = 0; i < iterations; ++i) {
+            lexer.append(runLexer(benchCase));
+            highlighter.append(runHighlighter(benchCase));
+        }
+        results.append(report(benchCase, "lexer", lexer));
+        results.append(report(benchCase, "highlighter", highlighter));
+    }
+
+    QJsonObject root;
+    root["benchmark"] = "cpp_highlighter";
+    root["qt_version"] = QString(qVersion());
+    root["iterations"] = iterations;
+    root["results"] = results;
+    QByteArray json = QJsonDocument(root).toJson();
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QFile::WriteOnly)) {
+            QTextStream(stderr) << "Cannot write " << file.fileName() << ": " << file.errorString() << "\n";
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+QT += core gui widgets
+CONFIG += c++17 console
+CONFIG -= app_bundle
+TARGET = highlighter_bench
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    highlighter_bench.cpp \
+    ../cpplexer.cpp \
+    ../syntaxhighlighter.cpp \
+    ../cpphighlighter.cpp \
+    ../structureindex.cpp \
+    ../tracer.cpp
+
+HEADERS += \
+    ../cpplexer.h \
+    ../syntaxhighlighter.h \
+    ../cpphighlighter.h \
+    ../blockdata.h \
+    ../structureindex.h \
+    ../tracer.h
+
+QMAKE_CXXFLAGS += -std=c++17
@@ -0,0 +1,119 @@
+// Checks LineDiff against its own contract: random texts get random line
+// edits, and the hunks computed between the two versions, applied to the
+// old text, must give the new one. Hunks must be in ascending order, inside
+// the old text and not overlapping. Some rounds change more lines than
+// the algorithm's distance limit. Prints the failures and exits non-zero
+// if there are any.
+//
+//   linediff_check [--rounds N]
+
+#include "linediff.h"
+#include <QStringList>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <utility>
+
+namespace {
+
+QString randomLine(std::mt19937 &random)
+{
+    // Few distinct lines, so equal lines turn up away from their partners.
+    static const char *const words[] = {"{", "}", "return 0;", "int x = 1;", "// note", "", "x++;", "if (x)"};
+    QString line = QString::fromLatin1(words[random() % 8]);
+    if (random() % 4 == 0) line += QString::number(int(random() % 100));
+    return line;
+}
+
+QString randomText(std::mt19937 &random, int lines)
+{
+    QStringList text;
+    for (int i = 0; i < lines; ++i) {
+        text.append(randomLine(random));
+    }
+    QString joined = text.join('\n');
+    if (random() % 2) joined += '\n';
+    return joined;
+}
+
+QString edit(std::mt19937 &random, const QString &before, int edits, int maxSpan)
+{
+    QStringList lines = before.split('\n');
+    for (int i = 0; i < edits; ++i) {
+        int at = int(random() % (lines.size() + 1));
+        int span = 1 + int(random() % maxSpan);
+        switch (random() % 3) {
+        case 0:
+            for (int j = 0; j < span; ++j) {
+                lines.insert(at, randomLine(random));
+            }
+            break;
+        case 1:
+            for (int j = 0; j < span && at < lines.size(); ++j) {
+                lines.removeAt(at);
+            }
+            break;
+        default:
+            for (int j = 0; j < span && at + j < lines.size(); ++j) {
+                lines[at + j] = randomLine(random);
+            }
+            break;
+        }
+    }
+    return lines.join('\n');
+}
+
+bool check(const QString &before, const QString &after, QString *problem)
+{
+    QVector<LineDiff::Hunk> hunks = LineDiff::compute(before, after);
+    QString result;
+    int position = 0;
+    for (const LineDiff::Hunk &hunk : hunks) {
+        if (hunk.position < position || hunk.removed < 0 || hunk.position + hunk.removed > before.size()) {
+            *problem = QString("hunk at %1 removing %2 out of order or out of range").arg(hunk.position).arg(hunk.removed);
+            return false;
+        }
+        result += before.mid(position, hunk.position - position);
+        result += hunk.inserted;
+        position = hunk.position + hunk.removed;
+    }
+    result += before.mid(position);
+    if (result != after) {
+        *problem = QString("%1 hunks give %2 characters, expected %3").arg(hunks.size()).arg(result.size()).arg(after.size());
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 2000;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--rounds") == 0) rounds = std::atoi(argv[i + 1]);
+    }
+
+    std::mt19937 random(12345);
+    int failures = 0;
+    for (int round = 0; round < rounds; ++round) {
+        // Every tenth round rewrites well over a thousand lines, past the
+        // point where the changed middle becomes a single hunk.
+        bool large = round % 10 == 0;
+        int lines = large ? 4000 : int(random() % 200);
+        QString before = randomText(random, lines);
+        QString after = edit(random, before, large ? 400 : int(random() % 8), large ? 20 : 5);
+        if (round % 7 == 0) std::swap(before, after);
+
+        QString problem;
+        if (!check(before, after, &problem)) {
+            std::printf("round %d: %d -> %d characters: %s\n", round, int(before.size()), int(after.size()),
+                        problem.toUtf8().constData());
+            ++failures;
+        }
+    }
+
+    std::printf("%d rounds, %d failures\n", rounds, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,16 @@
+QT = core
+CONFIG += c++17 console
+CONFIG -= app_bundle
+TARGET = linediff_check
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    linediff_check.cpp \
+    ../linediff.cpp
+
+HEADERS += \
+    ../linediff.h
+
+QMAKE_CXXFLAGS += -std=c++17
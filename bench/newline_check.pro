@@ -0,0 +1,15 @@
+QT = core
+CONFIG += c++17 console
+CONFIG -= app_bundle
+TARGET = newline_check
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    newline_check.cpp
+
+HEADERS += \
+    ../newlinescanner.h
+
+QMAKE_CXXFLAGS += -std=c++17
@@ -0,0 +1,143 @@
+// Drives an UndoHistory well past its memory budget, so most records are
+// spilled to the temporary file, then undoes every edit and redoes them
+// all, comparing the text after each step with the one recorded when the
+// edit was made. A second pass undoes half way, edits on top, which drops
+// the spilled redo records, and undoes back to the clean state. Prints the
+// failures and exits non-zero if there are any.
+//
+//   undohistory_check [--edits N]
+
+#include "undohistory.h"
+#include <QApplication>
+#include <QPlainTextEdit>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QVector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace {
+
+const qint64 Budget = 1024 * 1024;
+
+int failures = 0;
+
+void fail(const char *what, int step)
+{
+    std::printf("%s at step %d\n", what, step);
+    ++failures;
+}
+
+QString randomText(std::mt19937 &random, int length)
+{
+    QString text(length, Qt::Uninitialized);
+    for (int i = 0; i < length; ++i) {
+        text[i] = random() % 40 == 0 ? QChar('\n') : QChar('a' + int(random() % 26));
+    }
+    return text;
+}
+
+// Replaces a random range with new text whose first and last characters
+// differ from the range's, so no edit shrinks to a pure insertion or
+// removal and none is merged into the one before: each edit is one step.
+void randomEdit(std::mt19937 &random, QTextDocument *document)
+{
+    int size = document->characterCount() - 1;
+    int removed = qMin(1 + int(random() % 4096), size / 2);
+    int position = int(random() % (size - removed + 1));
+    QString old = document->toPlainText().mid(position, removed);
+    QString inserted = randomText(random, 1 + int(random() % 4096));
+    inserted[0] = old.at(0) == 'Z' ? QChar('Y') : QChar('Z');
+    inserted[inserted.size() - 1] = old.at(old.size() - 1) == 'Z' ? QChar('Y') : QChar('Z');
+
+    QTextCursor cursor(document);
+    cursor.setPosition(position);
+    cursor.setPosition(position + removed, QTextCursor::KeepAnchor);
+    cursor.insertText(inserted);
+}
+
+void checkBudget(const UndoHistory &history, int step)
+{
+    if (history.memoryUsed() > Budget) fail("history over its budget", step);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    app.setApplicationName("undohistory_check");
+
+    int edits = 300;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--edits") == 0) edits = qMax(2, std::atoi(argv[i + 1]));
+    }
+
+    std::mt19937 random(12345);
+    QPlainTextEdit editor;
+    QTextDocument *document = editor.document();
+    editor.setPlainText(randomText(random, 64 * 1024));
+    document->setModified(false);
+    UndoHistory::setBudgets(Budget, Budget);
+    UndoHistory history(&editor);
+
+    // texts[i] is the text after i edits.
+    QVector<QString> texts{document->toPlainText()};
+    for (int i = 0; i < edits; ++i) {
+        randomEdit(random, document);
+        texts.append(document->toPlainText());
+        checkBudget(history, i + 1);
+    }
+
+    for (int step = edits; step > 0; --step) {
+        if (!history.undo()) {
+            fail("undo refused", step);
+            break;
+        }
+        if (document->toPlainText() != texts.at(step - 1)) fail("wrong text after undo", step - 1);
+        checkBudget(history, step - 1);
+    }
+    if (history.isUndoAvailable()) fail("undo still available", 0);
+    if (document->isModified()) fail("clean state reported modified", 0);
+
+    for (int step = 1; step <= edits; ++step) {
+        if (!history.redo()) {
+            fail("redo refused", step);
+            break;
+        }
+        if (document->toPlainText() != texts.at(step)) fail("wrong text after redo", step);
+        checkBudget(history, step);
+    }
+    if (history.isRedoAvailable()) fail("redo still available", edits);
+    if (!document->isModified()) fail("edited state reported clean", edits);
+
+    // Half way back, new edits replace everything above.
+    int half = edits / 2;
+    for (int step = edits; step > half; --step) {
+        history.undo();
+    }
+    texts.resize(half + 1);
+    for (int i = half; i < edits; ++i) {
+        randomEdit(random, document);
+        texts.append(document->toPlainText());
+        checkBudget(history, i + 1);
+    }
+    if (history.isRedoAvailable()) fail("redo available after a new edit", edits);
+    for (int step = edits; step > 0; --step) {
+        if (!history.undo()) {
+            fail("undo refused", step);
+            break;
+        }
+        if (document->toPlainText() != texts.at(step - 1)) fail("wrong text after undo", step - 1);
+    }
+    if (document->isModified()) fail("clean state reported modified", 0);
+
+    std::printf("%d edits, %lld bytes in memory at the end, %d failures\n", edits,
+                (long long)history.memoryUsed(), failures);
+    return failures ? 1 : 0;
+}
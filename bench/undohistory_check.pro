@@ -0,0 +1,16 @@
+QT += core gui widgets
+CONFIG += c++17 console
+CONFIG -= app_bundle
+TARGET = undohistory_check
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    undohistory_check.cpp \
+    ../undohistory.cpp
+
+HEADERS += \
+    ../undohistory.h
+
+QMAKE_CXXFLAGS += -std=c++17
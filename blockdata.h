@@ -0,0 +1,66 @@
+#ifndef BLOCKDATA_H
+#define BLOCKDATA_H
+
+#include "cpplexer.h"
+#include "structureindex.h"
+#include <QSet>
+#include <QString>
+#include <QTextBlock>
+#include <QTextBlockUserData>
+#include <QVector>
+
+// Per-block data shared by the highlighter and the decoration layer.
+class BlockData : public QTextBlockUserData
+{
+public:
+    // Span painted behind the text, in block-relative positions.
+    struct Decoration
+    {
+        int start;
+        int length;
+        int kind;
+
+        bool operator==(const Decoration &other) const
+        {
+            return start == other.start && length == other.length && kind == other.kind;
+        }
+        bool operator!=(const Decoration &other) const { return !(*this == other); }
+    };
+
+    ~BlockData() override
+    {
+        if (registry) registry->remove(this);
+        if (structureNode) StructureIndex::detach(structureNode);
+    }
+
+    static BlockData *of(QTextBlock block)
+    {
+        BlockData *data = static_cast<BlockData*>(block.userData());
+        if (!data) {
+            data = new BlockData;
+            block.setUserData(data);
+        }
+        return data;
+    }
+
+    // State the block was last highlighted from and the highlighter
+    // generation it belongs to; -1 means it has to be highlighted again.
+    int previousState = -1;
+    int generation = -1;
+    QString rawStringDelimiter;
+
+    // Brackets found by the last highlight and the block's node in the
+    // editor's StructureIndex, if it has joined it yet. folded marks a
+    // block whose fold is closed.
+    QVector<CppLexer::Bracket> brackets;
+    StructureIndex::Node *structureNode = nullptr;
+    bool folded = false;
+
+    // Decorations live with their block so edits elsewhere never touch
+    // them; the registry lets the layer find decorated blocks without
+    // walking the document, and forgets blocks as they are deleted.
+    QVector<Decoration> decorations;
+    QSet<BlockData*> *registry = nullptr;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "cpphighlighter.h"
+#include "blockdata.h"
+#include <QHash>
+
+CppHighlighter::CppHighlighter(QPlainTextEdit *editor) : SyntaxHighlighter(editor)
+{
+    setFormats(formats);
+}
+
+void CppHighlighter::setFormats(QTextCharFormat *formats)
+{
+    formats[CppLexer::Keyword].setForeground(QColor("#ff79c6"));
+    formats[CppLexer::Keyword].setFontWeight(QFont::Bold);
+    formats[CppLexer::Class].setForeground(QColor("#8be9fd"));
+    formats[CppLexer::Class].setFontWeight(QFont::Bold);
+    formats[CppLexer::Comment].setForeground(QColor("#6272a4"));
+    formats[CppLexer::String].setForeground(QColor("#f1fa8c"));
+    formats[CppLexer::Function].setForeground(QColor("#50fa7b"));
+    formats[CppLexer::Number].setForeground(QColor("#bd93f9"));
+    formats[CppLexer::Preprocessor].setForeground(QColor("#ffb86c"));
+}
+
+int CppHighlighter::highlightLine(const QString &text, const QTextBlock &block, int previousState,
+                                  QVector<QTextLayout::FormatRange> &ranges)
+{
+    CppLexer::State state;
+    state.kind = qMax(0, previousState) & 0xFF;
+    if (state.kind == CppLexer::RawString) {
+        BlockData *previous = static_cast<BlockData*>(block.previous().userData());
+        if (previous) state.delimiter = previous->rawStringDelimiter;
+    }
+
+    tokens.clear();
+    brackets.clear();
+    CppLexer::lex(text.constData(), text.size(), state, tokens, &brackets);
+    for (const CppLexer::Token &token : tokens) {
+        QTextLayout::FormatRange range;
+        range.start = token.start;
+        range.length = token.length;
+        range.format = formats[token.kind];
+        ranges.append(range);
+    }
+
+    BlockData *data = blockData(block);
+    if (data->brackets != brackets) data->brackets = brackets;
+
+    // The delimiter is folded into the block state so that changing it
+    // still makes the blocks that follow get highlighted again.
+    if (state.kind == CppLexer::RawString) {
+        data->rawStringDelimiter = state.delimiter;
+        return state.kind | int(qHash(state.delimiter) & 0x7FFFFF) << 8;
+    }
+    data->rawStringDelimiter.clear();
+    return state.kind;
+}
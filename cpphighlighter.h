@@ -0,0 +1,26 @@
+#ifndef CPPHIGHLIGHTER_H
+#define CPPHIGHLIGHTER_H
+
+#include "cpplexer.h"
+#include "syntaxhighlighter.h"
+#include <QTextCharFormat>
+
+// Colours C++ using CppLexer tokens.
+class CppHighlighter : public SyntaxHighlighter
+{
+    Q_OBJECT
+public:
+    CppHighlighter(QPlainTextEdit *editor);
+
+    // The colours of each token kind, shared with GrammarHighlighter.
+    static void setFormats(QTextCharFormat *formats);
+protected:
+    int highlightLine(const QString &text, const QTextBlock &block, int previousState,
+                      QVector<QTextLayout::FormatRange> &formats) override;
+private:
+    QTextCharFormat formats[CppLexer::TokenKindCount];
+    QVector<CppLexer::Token> tokens;
+    QVector<CppLexer::Bracket> brackets;
+};
+
+#endif
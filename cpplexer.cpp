@@ -0,0 +1,354 @@
+#include "cpplexer.h"
+
+namespace {
+
+// Perfect hash over the keyword set: FNV-1a of the identifier, the high
+// half picks a displacement and the low half plus displacement picks the
+// only slot the word can be in. Generated offline for exactly these words.
+const int KeywordBuckets = 32;
+const int KeywordSlots = 256;
+const int MaxKeywordLength = 16;
+const int MaxRawDelimiter = 16;
+
+const quint8 keywordDisplacement[KeywordBuckets] = {
+    0, 1, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1, 3, 0,
+    0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 0, 1, 3, 0
+};
+
+const char *const keywordSlots[KeywordSlots] = {
+    "enum", nullptr, "class", "constexpr", nullptr, nullptr, "if", nullptr,
+    "double", "bitand", "using", "template", "private", nullptr, "signals", "try",
+    nullptr, "new", nullptr, "concept", "do", nullptr, "signed", nullptr,
+    nullptr, nullptr, nullptr, nullptr, nullptr, "char", nullptr, "alignof",
+    "struct", nullptr, nullptr, "static_cast", nullptr, nullptr, "unsigned", "typedef",
+    nullptr, "slots", nullptr, nullptr, nullptr, nullptr, nullptr, "throw",
+    nullptr, nullptr, nullptr, nullptr, "inline", nullptr, nullptr, nullptr,
+    nullptr, nullptr, nullptr, "static", nullptr, "bool", "char8_t", nullptr,
+    nullptr, nullptr, nullptr, nullptr, "continue", nullptr, nullptr, nullptr,
+    nullptr, "co_yield", "delete", "explicit", "catch", nullptr, "typename", nullptr,
+    nullptr, nullptr, nullptr, "long", nullptr, "requires", nullptr, "noexcept",
+    "false", nullptr, nullptr, nullptr, nullptr, nullptr, "int", "void",
+    nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "or_eq",
+    nullptr, nullptr, nullptr, nullptr, nullptr, "bitor", "volatile", "char16_t",
+    nullptr, "switch", "consteval", nullptr, nullptr, nullptr, "constinit", nullptr,
+    "break", nullptr, "alignas", nullptr, nullptr, "protected", "xor", nullptr,
+    "public", "this", nullptr, nullptr, "or", "float", nullptr, nullptr,
+    nullptr, nullptr, nullptr, "not", nullptr, "friend", nullptr, nullptr,
+    "for", "and_eq", "co_await", "char32_t", nullptr, "reinterpret_cast", "auto", nullptr,
+    nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "nullptr",
+    "asm", "thread_local", nullptr, "namespace", nullptr, "decltype", "and", nullptr,
+    nullptr, "mutable", "xor_eq", nullptr, nullptr, nullptr, nullptr, nullptr,
+    nullptr, "case", nullptr, "export", nullptr, nullptr, nullptr, nullptr,
+    nullptr, "extern", nullptr, nullptr, "virtual", "not_eq", nullptr, nullptr,
+    "register", nullptr, "return", nullptr, nullptr, nullptr, nullptr, nullptr,
+    nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "while", nullptr,
+    nullptr, nullptr, nullptr, nullptr, "const", "short", nullptr, nullptr,
+    "typeid", nullptr, nullptr, nullptr, "dynamic_cast", nullptr, "static_assert", "co_return",
+    "default", nullptr, nullptr, nullptr, nullptr, "true", "goto", nullptr,
+    nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+    "else", "wchar_t", "const_cast", "compl", nullptr, nullptr, nullptr, "union",
+    nullptr, nullptr, nullptr, nullptr, nullptr, "operator", "sizeof", nullptr
+};
+
+inline bool isDigit(ushort c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool isIdentifierStart(ushort c)
+{
+    if (c < 128) return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    return QChar(c).isLetter();
+}
+
+inline bool isIdentifierChar(ushort c)
+{
+    if (c < 128) return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || isDigit(c);
+    return QChar(c).isLetterOrNumber();
+}
+
+bool equals(const QChar *text, int length, const char *word)
+{
+    for (int i = 0; i < length; ++i) {
+        if (text[i].unicode() != uchar(word[i])) return false;
+    }
+    return word[length] == '\0';
+}
+
+// Returns the index after the closing quote, or length if the line ends first.
+int scanQuoted(const QChar *text, int length, int from, ushort quote, bool &closed)
+{
+    closed = false;
+    int i = from;
+    while (i < length) {
+        ushort c = text[i].unicode();
+        if (c == '\\') {
+            i += 2;
+        } else if (c == quote) {
+            closed = true;
+            return i + 1;
+        } else {
+            ++i;
+        }
+    }
+    return length;
+}
+
+int findBlockCommentEnd(const QChar *text, int length, int from)
+{
+    for (int i = from; i + 1 < length; ++i) {
+        if (text[i].unicode() == '*' && text[i + 1].unicode() == '/') return i + 2;
+    }
+    return -1;
+}
+
+int findRawStringEnd(const QChar *text, int length, int from, const QString &delimiter)
+{
+    int size = delimiter.size();
+    for (int i = from; i + size + 1 < length; ++i) {
+        if (text[i].unicode() != ')' || text[i + size + 1].unicode() != '"') continue;
+        bool match = true;
+        for (int j = 0; j < size && match; ++j) {
+            match = text[i + 1 + j] == delimiter.at(j);
+        }
+        if (match) return i + size + 2;
+    }
+    return -1;
+}
+
+int scanNumber(const QChar *text, int length, int from)
+{
+    int i = from + 1;
+    while (i < length) {
+        ushort c = text[i].unicode();
+        ushort previous = text[i - 1].unicode();
+        if (c < 128 && (isIdentifierChar(c) || c == '.')) {
+            ++i;
+        } else if (c == '\'' && i + 1 < length && text[i + 1].unicode() < 128 && isIdentifierChar(text[i + 1].unicode())) {
+            i += 2;
+        } else if ((c == '+' || c == '-') && (previous == 'e' || previous == 'E' || previous == 'p' || previous == 'P')) {
+            ++i;
+        } else {
+            break;
+        }
+    }
+    return i;
+}
+
+inline void addToken(QVector<CppLexer::Token> &tokens, int start, int end, CppLexer::TokenKind kind)
+{
+    if (end > start) tokens.append(CppLexer::Token{start, end - start, kind});
+}
+
+inline bool endsWithBackslash(const QChar *text, int length)
+{
+    return length > 0 && text[length - 1].unicode() == '\\';
+}
+
+inline void addBracket(QVector<CppLexer::Bracket> *brackets, int position, ushort c)
+{
+    if (!brackets) return;
+    switch (c) {
+    case '{': brackets->append(CppLexer::Bracket{position, CppLexer::Brace, 1}); break;
+    case '}': brackets->append(CppLexer::Bracket{position, CppLexer::Brace, -1}); break;
+    case '(': brackets->append(CppLexer::Bracket{position, CppLexer::Paren, 1}); break;
+    case ')': brackets->append(CppLexer::Bracket{position, CppLexer::Paren, -1}); break;
+    case '[': brackets->append(CppLexer::Bracket{position, CppLexer::Square, 1}); break;
+    case ']': brackets->append(CppLexer::Bracket{position, CppLexer::Square, -1}); break;
+    default: break;
+    }
+}
+
+}
+
+bool CppLexer::isKeyword(const QChar *text, int length)
+{
+    if (length < 2 || length > MaxKeywordLength) return false;
+
+    quint32 hash = 2166136261u;
+    for (int i = 0; i < length; ++i) {
+        ushort c = text[i].unicode();
+        if (c > 127) return false;
+        hash = (hash ^ c) * 16777619u;
+    }
+    int slot = ((hash & 0xFFFF) + keywordDisplacement[(hash >> 16) % KeywordBuckets]) % KeywordSlots;
+    const char *keyword = keywordSlots[slot];
+    return keyword && equals(text, length, keyword);
+}
+
+void CppLexer::lex(const QChar *text, int length, State &state, QVector<Token> &tokens,
+                   QVector<Bracket> *brackets)
+{
+    int i = 0;
+    bool closed = false;
+
+    switch (state.kind) {
+    case BlockComment:
+        i = findBlockCommentEnd(text, length, 0);
+        if (i < 0) {
+            addToken(tokens, 0, length, Comment);
+            return;
+        }
+        addToken(tokens, 0, i, Comment);
+        break;
+    case RawString:
+        i = findRawStringEnd(text, length, 0, state.delimiter);
+        if (i < 0) {
+            addToken(tokens, 0, length, String);
+            return;
+        }
+        addToken(tokens, 0, i, String);
+        break;
+    case StringContinuation:
+        i = scanQuoted(text, length, 0, '"', closed);
+        addToken(tokens, 0, i, String);
+        if (!closed) {
+            if (!endsWithBackslash(text, length)) state.kind = Normal;
+            return;
+        }
+        break;
+    case CommentContinuation:
+        addToken(tokens, 0, length, Comment);
+        if (!endsWithBackslash(text, length)) state.kind = Normal;
+        return;
+    default:
+        break;
+    }
+    state.kind = Normal;
+    state.delimiter.clear();
+
+    bool lineStart = i == 0;
+    while (i < length) {
+        ushort c = text[i].unicode();
+        if (c == ' ' || c == '\t') {
+            ++i;
+            continue;
+        }
+
+        int start = i;
+        if (c == '#' && lineStart) {
+            lineStart = false;
+            ++i;
+            while (i < length && (text[i].unicode() == ' ' || text[i].unicode() == '\t')) ++i;
+            int word = i;
+            while (i < length && isIdentifierChar(text[i].unicode())) ++i;
+            addToken(tokens, start, i, Preprocessor);
+            if (brackets) {
+                int size = i - word;
+                if (equals(text + word, size, "if") || equals(text + word, size, "ifdef") || equals(text + word, size, "ifndef")) {
+                    brackets->append(Bracket{start, Region, 1});
+                } else if (equals(text + word, size, "endif")) {
+                    brackets->append(Bracket{start, Region, -1});
+                }
+            }
+            if (equals(text + word, i - word, "include")) {
+                while (i < length && (text[i].unicode() == ' ' || text[i].unicode() == '\t')) ++i;
+                if (i < length && text[i].unicode() == '<') {
+                    int end = i + 1;
+                    while (end < length && text[end].unicode() != '>') ++end;
+                    end = qMin(end + 1, length);
+                    addToken(tokens, i, end, String);
+                    i = end;
+                }
+            }
+            continue;
+        }
+        lineStart = false;
+
+        if (c == '/' && i + 1 < length) {
+            ushort next = text[i + 1].unicode();
+            if (next == '/') {
+                addToken(tokens, i, length, Comment);
+                if (endsWithBackslash(text, length)) state.kind = CommentContinuation;
+                return;
+            }
+            if (next == '*') {
+                int end = findBlockCommentEnd(text, length, i + 2);
+                if (end < 0) {
+                    addToken(tokens, i, length, Comment);
+                    state.kind = BlockComment;
+                    return;
+                }
+                addToken(tokens, i, end, Comment);
+                i = end;
+                continue;
+            }
+        }
+
+        if (c == '"' || c == '\'') {
+            i = scanQuoted(text, length, i + 1, c, closed);
+            addToken(tokens, start, i, String);
+            if (!closed && c == '"' && endsWithBackslash(text, length)) {
+                state.kind = StringContinuation;
+                return;
+            }
+            continue;
+        }
+
+        if (isDigit(c) || (c == '.' && i + 1 < length && isDigit(text[i + 1].unicode()))) {
+            i = scanNumber(text, length, i);
+            addToken(tokens, start, i, Number);
+            continue;
+        }
+
+        if (!isIdentifierStart(c)) {
+            addBracket(brackets, i, c);
+            ++i;
+            continue;
+        }
+
+        int end = i + 1;
+        while (end < length && isIdentifierChar(text[end].unicode())) ++end;
+        int size = end - i;
+        ushort after = end < length ? text[end].unicode() : 0;
+
+        if (after == '"' && text[end - 1].unicode() == 'R'
+            && (size == 1 || equals(text + i, size, "u8R") || equals(text + i, size, "uR")
+                || equals(text + i, size, "UR") || equals(text + i, size, "LR"))) {
+            int open = end + 1;
+            while (open < length && open - end - 1 <= MaxRawDelimiter && text[open].unicode() != '('
+                   && text[open].unicode() != ')' && text[open].unicode() != '\\' && text[open].unicode() != ' '
+                   && text[open].unicode() != '"') {
+                ++open;
+            }
+            if (open < length && text[open].unicode() == '(' && open - end - 1 <= MaxRawDelimiter) {
+                QString delimiter(text + end + 1, open - end - 1);
+                int close = findRawStringEnd(text, length, open + 1, delimiter);
+                if (close < 0) {
+                    addToken(tokens, start, length, String);
+                    state.kind = RawString;
+                    state.delimiter = delimiter;
+                    return;
+                }
+                addToken(tokens, start, close, String);
+                i = close;
+                continue;
+            }
+        }
+        if ((after == '"' || after == '\'')
+            && (equals(text + i, size, "u8") || equals(text + i, size, "u")
+                || equals(text + i, size, "U") || equals(text + i, size, "L"))) {
+            i = scanQuoted(text, length, end + 1, after, closed);
+            addToken(tokens, start, i, String);
+            if (!closed && after == '"' && endsWithBackslash(text, length)) {
+                state.kind = StringContinuation;
+                return;
+            }
+            continue;
+        }
+
+        if (isKeyword(text + i, size)) {
+            addToken(tokens, i, end, Keyword);
+        } else if (after == '(') {
+            addToken(tokens, i, end, Function);
+        } else if (c == 'Q' && size > 1) {
+            bool letters = true;
+            for (int j = i + 1; j < end && letters; ++j) {
+                ushort l = text[j].unicode();
+                letters = (l >= 'a' && l <= 'z') || (l >= 'A' && l <= 'Z');
+            }
+            if (letters) addToken(tokens, i, end, Class);
+        }
+        i = end;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef CPPLEXER_H
+#define CPPLEXER_H
+
+#include <QChar>
+#include <QString>
+#include <QVector>
+
+// Single-pass C++ tokenizer for highlighting. Each line is walked once and
+// only the spans that get a format are reported, plus, if asked for, the
+// brackets and #if/#endif lines outside strings and comments. State carries
+// what the next line starts inside: a block comment, a raw string (with its
+// delimiter) or a string or comment continued with a trailing backslash.
+class CppLexer
+{
+public:
+    enum TokenKind { Keyword, Class, Function, Number, String, Comment, Preprocessor, TokenKindCount };
+    enum StateKind { Normal = 0, BlockComment = 1, RawString = 2, StringContinuation = 3, CommentContinuation = 4 };
+    enum BracketKind { Brace, Paren, Square, Region, BracketKindCount };
+
+    struct Token
+    {
+        int start;
+        int length;
+        TokenKind kind;
+    };
+
+    // step is 1 for an opening bracket and -1 for a closing one.
+    struct Bracket
+    {
+        int position;
+        int kind;
+        int step;
+
+        bool operator==(const Bracket &other) const
+        {
+            return position == other.position && kind == other.kind && step == other.step;
+        }
+    };
+
+    struct State
+    {
+        int kind = Normal;
+        QString delimiter;
+    };
+
+    static void lex(const QChar *text, int length, State &state, QVector<Token> &tokens,
+                    QVector<Bracket> *brackets = nullptr);
+    static bool isKeyword(const QChar *text, int length);
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "decorationlayer.h"
+#include <QPainter>
+#include <QTextDocument>
+#include <QTextLayout>
+
+DecorationLayer::DecorationLayer(QTextDocument *document, QObject *parent)
+    : QObject(parent), document(document), blockCount(document->blockCount()), revision(document->revision())
+{
+    setIsDarkTheme(true);
+    connect(document, &QTextDocument::contentsChange, this, &DecorationLayer::onContentsChange);
+}
+
+DecorationLayer::~DecorationLayer()
+{
+    // The document may outlive the layer; its blocks must not report back.
+    for (BlockData *data : qAsConst(decorated)) {
+        data->registry = nullptr;
+        data->decorations.clear();
+    }
+}
+
+void DecorationLayer::setRanges(Kind kind, const QVector<Range> &ranges)
+{
+    for (auto it = decorated.begin(); it != decorated.end();) {
+        BlockData *data = *it;
+        for (int i = data->decorations.size() - 1; i >= 0; --i) {
+            if (data->decorations.at(i).kind == kind) data->decorations.remove(i);
+        }
+        if (data->decorations.isEmpty()) {
+            data->registry = nullptr;
+            it = decorated.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    QTextBlock block;
+    for (const Range &range : ranges) {
+        int position = range.position;
+        int end = range.position + range.length;
+        while (position < end) {
+            if (!block.isValid() || position < block.position() || position >= block.position() + block.length()) {
+                block = document->findBlock(position);
+                if (!block.isValid()) return;
+            }
+            int blockEnd = block.position() + block.length() - 1;
+            int length = qMin(end, blockEnd) - position;
+            if (length > 0) {
+                add(block, BlockData::Decoration{position - block.position(), length, kind});
+            }
+            position = blockEnd + 1;
+        }
+    }
+}
+
+int DecorationLayer::count(Kind kind) const
+{
+    int total = 0;
+    for (const BlockData *data : decorated) {
+        for (const BlockData::Decoration &decoration : data->decorations) {
+            if (decoration.kind == kind) ++total;
+        }
+    }
+    return total;
+}
+
+QVector<BlockData::Decoration> DecorationLayer::decorations(const QTextBlock &block) const
+{
+    BlockData *data = static_cast<BlockData*>(block.userData());
+    return data ? data->decorations : QVector<BlockData::Decoration>();
+}
+
+void DecorationLayer::setIsDarkTheme(bool dark)
+{
+    colors[SearchMatch] = dark ? QColor(0x61, 0x4d, 0x1a) : QColor(0xf8, 0xe1, 0x8f);
+    colors[BracketMatch] = dark ? QColor(0x26, 0x4f, 0x78) : QColor(0xc6, 0xdc, 0xf2);
+    colors[Diagnostic] = dark ? QColor(0xf1, 0x4c, 0x4c) : QColor(0xe5, 0x14, 0x00);
+}
+
+void DecorationLayer::paint(QPainter &painter, const QTextBlock &block, const QPointF &topLeft) const
+{
+    BlockData *data = static_cast<BlockData*>(block.userData());
+    if (!data || data->decorations.isEmpty()) return;
+
+    QTextLayout *layout = block.layout();
+    for (const BlockData::Decoration &decoration : qAsConst(data->decorations)) {
+        int end = decoration.start + decoration.length;
+        for (int i = layout->lineForTextPosition(decoration.start).lineNumber(); i >= 0 && i < layout->lineCount(); ++i) {
+            QTextLine line = layout->lineAt(i);
+            if (line.textStart() >= end) break;
+
+            qreal left = line.cursorToX(qMax(decoration.start, line.textStart()));
+            qreal right = line.cursorToX(qMin(end, line.textStart() + line.textLength()));
+            QRectF rect(topLeft.x() + left, topLeft.y() + line.y(), right - left, line.height());
+            if (decoration.kind == Diagnostic) {
+                painter.setPen(colors[Diagnostic]);
+                painter.drawLine(QLineF(rect.bottomLeft(), rect.bottomRight()).translated(0, -1));
+            } else {
+                painter.fillRect(rect, colors[decoration.kind]);
+            }
+        }
+    }
+}
+
+void DecorationLayer::onContentsChange(int position, int removed, int added)
+{
+    bool structural = document->blockCount() != blockCount;
+    bool edited = document->revision() != revision;
+    blockCount = document->blockCount();
+    revision = document->revision();
+    if (decorated.isEmpty() || (!edited && removed == added)) return;
+
+    QTextBlock first = document->findBlock(position);
+    QTextBlock last = document->findBlock(position + added);
+    if (!first.isValid()) return;
+    if (!last.isValid()) last = document->lastBlock();
+    BlockData *data = static_cast<BlockData*>(first.userData());
+    if (!data || !data->registry) return;
+
+    // Spans before the edit stay, spans it touched go, spans after it move
+    // by the size difference and may land in the block the edit ended in.
+    structural = structural || first != last;
+    int from = position - first.position();
+    int to = from + removed;
+    int delta = added - removed;
+    QVector<BlockData::Decoration> moved;
+    for (int i = data->decorations.size() - 1; i >= 0; --i) {
+        BlockData::Decoration &decoration = data->decorations[i];
+        if (decoration.start + decoration.length <= from) continue;
+        if (decoration.start >= to) {
+            if (!structural) {
+                decoration.start += delta;
+                continue;
+            }
+            BlockData::Decoration shifted = decoration;
+            shifted.start = first.position() + decoration.start + delta - last.position();
+            if (shifted.start >= 0) moved.prepend(shifted);
+        }
+        data->decorations.remove(i);
+    }
+    if (data->decorations.isEmpty()) {
+        data->registry = nullptr;
+        decorated.remove(data);
+    }
+    for (const BlockData::Decoration &decoration : qAsConst(moved)) {
+        add(last, decoration);
+    }
+}
+
+void DecorationLayer::add(QTextBlock block, const BlockData::Decoration &decoration)
+{
+    BlockData *data = BlockData::of(block);
+    data->decorations.append(decoration);
+    data->registry = &decorated;
+    decorated.insert(data);
+}
@@ -0,0 +1,56 @@
+#ifndef DECORATIONLAYER_H
+#define DECORATIONLAYER_H
+
+#include "blockdata.h"
+#include <QColor>
+#include <QObject>
+#include <QSet>
+#include <QTextBlock>
+#include <QVector>
+
+class QPainter;
+class QTextDocument;
+
+// Background spans (search hits, matching brackets, diagnostics) kept per
+// block instead of as ExtraSelections. Typing only adjusts the spans of the
+// edited block, and painting only looks at the blocks being painted, so the
+// number of decorations does not matter for either.
+class DecorationLayer : public QObject
+{
+    Q_OBJECT
+public:
+    enum Kind { SearchMatch, BracketMatch, Diagnostic, KindCount };
+
+    struct Range
+    {
+        int position;
+        int length;
+    };
+
+    DecorationLayer(QTextDocument *document, QObject *parent = nullptr);
+    ~DecorationLayer();
+
+    // Replaces every decoration of one kind. Ranges are document positions
+    // sorted by position; a range crossing a line is split per block.
+    void setRanges(Kind kind, const QVector<Range> &ranges);
+    void clear(Kind kind) { setRanges(kind, QVector<Range>()); }
+    int count(Kind kind) const;
+
+    QVector<BlockData::Decoration> decorations(const QTextBlock &block) const;
+    void setIsDarkTheme(bool dark);
+    void paint(QPainter &painter, const QTextBlock &block, const QPointF &topLeft) const;
+
+private slots:
+    void onContentsChange(int position, int removed, int added);
+
+private:
+    void add(QTextBlock block, const BlockData::Decoration &decoration);
+
+    QTextDocument *document;
+    QSet<BlockData*> decorated;
+    QColor colors[KindCount];
+    int blockCount;
+    int revision;
+};
+
+#endif
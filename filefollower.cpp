@@ -0,0 +1,149 @@
+#include "filefollower.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTimer>
+#include <QtConcurrent>
+
+FileFollower::FileFollower(const QString &fileName, qint64 offset, QPlainTextEdit *editor)
+    : QObject(editor), path(fileName), target(editor), busy(false), again(false), dropped(false),
+      offset(offset), truncated(false), more(false), runFinished(false), appendScheduled(false)
+{
+    // Change notifications are the fast path; the timer covers file systems
+    // that do not deliver them.
+    pollTimer = new QTimer(this);
+    pollTimer->setInterval(PollMsecs);
+    connect(pollTimer, &QTimer::timeout, this, &FileFollower::poll);
+    pollTimer->start();
+
+    target->setReadOnly(true);
+}
+
+FileFollower::~FileFollower()
+{
+    future.waitForFinished();
+}
+
+void FileFollower::poll()
+{
+    if (busy) {
+        again = true;
+        return;
+    }
+    if (QFileInfo(path).size() == offset) return;
+    busy = true;
+    again = false;
+    runFinished = false;
+    future = QtConcurrent::run([this]() { run(); });
+}
+
+void FileFollower::stop()
+{
+    pollTimer->stop();
+    future.waitForFinished();
+    target->document()->setMaximumBlockCount(0);
+    target->setReadOnly(false);
+    deleteLater();
+}
+
+void FileFollower::setMaxLines(int lines)
+{
+    target->document()->setMaximumBlockCount(qMax(0, lines));
+}
+
+void FileFollower::run()
+{
+    QFile file(path);
+    bool opened = file.open(QFile::ReadOnly);
+    if (opened && file.size() < offset) {
+        offset = 0;
+        decoder = ChunkDecoder();
+        QMutexLocker locker(&mutex);
+        truncated = true;
+    }
+
+    // One run reads a bounded slice, so a burst of output reaches the
+    // editor in steps instead of piling up here.
+    qint64 read = 0;
+    bool remaining = false;
+    if (opened && file.seek(offset)) {
+        while (read < MaxRunBytes) {
+            QByteArray bytes = file.read(ChunkBytes);
+            if (bytes.isEmpty()) break;
+            offset += bytes.size();
+            read += bytes.size();
+            QString text = decoder.decode(bytes);
+            QMutexLocker locker(&mutex);
+            pending.append(text);
+            scheduleAppend();
+        }
+        remaining = read >= MaxRunBytes && !file.atEnd();
+    }
+
+    QMutexLocker locker(&mutex);
+    more = remaining;
+    runFinished = true;
+    scheduleAppend();
+}
+
+void FileFollower::scheduleAppend()
+{
+    if (appendScheduled) return;
+    appendScheduled = true;
+    QMetaObject::invokeMethod(this, "appendPending", Qt::QueuedConnection);
+}
+
+void FileFollower::appendPending()
+{
+    QString batch;
+    bool reset = false;
+    bool finishedRun = false;
+    {
+        QMutexLocker locker(&mutex);
+        appendScheduled = false;
+        reset = truncated;
+        truncated = false;
+        while (!pending.isEmpty() && batch.size() < BatchChars) {
+            batch += pending.takeFirst();
+        }
+        if (!pending.isEmpty()) {
+            scheduleAppend();
+        } else if (runFinished) {
+            finishedRun = true;
+            if (more) again = true;
+        }
+    }
+
+    QTextDocument *document = target->document();
+    QScrollBar *scrollBar = target->verticalScrollBar();
+    bool atEnd = scrollBar->value() >= scrollBar->maximum();
+    if (reset) {
+        QTextCursor cursor(document);
+        cursor.select(QTextCursor::Document);
+        cursor.removeSelectedText();
+        dropped = false;
+    }
+    if (!batch.isEmpty()) {
+        int maxLines = document->maximumBlockCount();
+        if (maxLines > 0 && document->blockCount() + batch.count(QLatin1Char('\n')) > maxLines) {
+            dropped = true;
+        }
+        QTextCursor cursor(document);
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertText(batch);
+    }
+    if (reset || !batch.isEmpty()) {
+        document->setModified(false);
+        // Only a view left at the bottom keeps following; one scrolled up
+        // to read stays put.
+        if (atEnd) scrollBar->setValue(scrollBar->maximum());
+    }
+
+    if (finishedRun) {
+        busy = false;
+        if (again) poll();
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef FILEFOLLOWER_H
+#define FILEFOLLOWER_H
+
+#include "fileloader.h"
+#include <QFuture>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+
+class QPlainTextEdit;
+class QTimer;
+
+// Follows a growing file, like tail -f. Each poll reads only the bytes past
+// the last offset on a worker thread and appends the decoded text to the
+// end of the read-only editor in bounded batches. With a line limit the
+// document drops its first lines as new ones arrive, so a tab can follow a
+// busy log for hours in constant memory. A file that shrank was truncated
+// or rotated and is followed again from its start.
+class FileFollower : public QObject
+{
+    Q_OBJECT
+public:
+    FileFollower(const QString &fileName, qint64 offset, QPlainTextEdit *editor);
+    ~FileFollower();
+
+    void poll();
+    void stop();
+    void setMaxLines(int lines);
+    // Lines were dropped at the top, so the editor no longer holds the
+    // whole file.
+    bool droppedLines() const { return dropped; }
+
+private slots:
+    void appendPending();
+
+private:
+    static const int ChunkBytes = 1024 * 1024;
+    static const int BatchChars = 1024 * 1024;
+    static const qint64 MaxRunBytes = 8 * 1024 * 1024;
+    static const int PollMsecs = 1000;
+
+    void run();
+    void scheduleAppend();
+
+    QString path;
+    QPlainTextEdit *target;
+    QTimer *pollTimer;
+    bool busy;
+    bool again;
+    bool dropped;
+    QFuture<void> future;
+
+    // Owned by the worker while a run is active.
+    qint64 offset;
+    ChunkDecoder decoder;
+
+    QMutex mutex;
+    QStringList pending;
+    bool truncated;
+    bool more;
+    bool runFinished;
+    bool appendScheduled;
+};
+
+#endif
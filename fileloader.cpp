@@ -0,0 +1,197 @@
+#include "fileloader.h"
+#include "newlinescanner.h"
+#include "tracer.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QPlainTextEdit>
+#include <QTextCursor>
+#include <QtConcurrent>
+
+ChunkDecoder::ChunkDecoder(bool foldLineEndings) : atStart(true), fold(foldLineEndings), invalid(false)
+{
+}
+
+QString ChunkDecoder::decode(const QByteArray &bytes)
+{
+    QByteArray data = carry + bytes;
+    carry.clear();
+
+    if (atStart && data.size() >= 3) {
+        if (data.startsWith("\xEF\xBB\xBF")) data.remove(0, 3);
+        atStart = false;
+    }
+
+    int cut = data.size();
+    int lead = cut - 1;
+    while (lead >= 0 && cut - lead <= 3 && (uchar(data.at(lead)) & 0xC0) == 0x80) --lead;
+    if (lead >= 0) {
+        uchar byte = uchar(data.at(lead));
+        int needed = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : byte >= 0xC0 ? 2 : 1;
+        if (needed > cut - lead) cut = lead;
+    }
+    if (cut > 0 && data.at(cut - 1) == '\r') --cut;
+
+    carry = data.mid(cut);
+    data.truncate(cut);
+
+    QString text = QString::fromUtf8(data);
+    check(data, text);
+    if (fold) text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+    return text;
+}
+
+QString ChunkDecoder::flush()
+{
+    // A sequence cut short by the end of the data is malformed too.
+    QString text = QString::fromUtf8(carry);
+    check(carry, text);
+    carry.clear();
+    return text;
+}
+
+void ChunkDecoder::check(const QByteArray &data, const QString &text)
+{
+    // Every U+FFFD the bytes do not spell out themselves stands for a
+    // malformed sequence; the count is only taken when there is one at all.
+    if (invalid || !text.contains(QChar::ReplacementCharacter)) return;
+    invalid = text.count(QChar::ReplacementCharacter) != data.count("\xEF\xBF\xBD");
+}
+
+FileLoader::FileLoader(const QString &fileName, QPlainTextEdit *editor)
+    : QObject(editor), path(fileName), target(editor), totalBytes(QFileInfo(fileName).size()), percent(0),
+      pendingChars(0), loadedBytes(0), appendScheduled(false), done(false), failed(false), undoWasEnabled(false), cancelled(0)
+{
+}
+
+FileLoader::~FileLoader()
+{
+    stopWorker();
+}
+
+void FileLoader::start()
+{
+    target->setReadOnly(true);
+    undoWasEnabled = target->document()->isUndoRedoEnabled();
+    target->document()->setUndoRedoEnabled(false);
+    future = QtConcurrent::run([this]() { run(); });
+}
+
+void FileLoader::cancel()
+{
+    if (cancelled.loadAcquire()) return;
+    stopWorker();
+    emit finished(false, QString());
+    deleteLater();
+}
+
+void FileLoader::stopWorker()
+{
+    cancelled.storeRelease(1);
+    {
+        QMutexLocker locker(&mutex);
+        spaceAvailable.wakeAll();
+    }
+    future.waitForFinished();
+}
+
+void FileLoader::run()
+{
+    TRACE_SCOPE("FileLoader::run");
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        QMutexLocker locker(&mutex);
+        failed = true;
+        errorString = file.errorString();
+        done = true;
+        scheduleAppend();
+        return;
+    }
+
+    // Counting line feeds over the mapped file takes a few milliseconds even
+    // for large files and lets the editor size its gutter for the final
+    // line count before the text arrives.
+    if (uchar *mapped = file.map(0, file.size())) {
+        emit lineCountKnown(NewlineScanner::count(reinterpret_cast<const char *>(mapped), file.size()) + 1);
+        file.unmap(mapped);
+    }
+
+    ChunkDecoder decoder;
+    while (!cancelled.loadAcquire()) {
+        QByteArray bytes = file.read(ChunkBytes);
+        if (bytes.isEmpty()) break;
+        QString text = decoder.decode(bytes);
+
+        QMutexLocker locker(&mutex);
+        while (pendingChars > MaxPendingChars && !cancelled.loadAcquire()) {
+            spaceAvailable.wait(&mutex);
+        }
+        pending.append(text);
+        pendingChars += text.size();
+        loadedBytes += bytes.size();
+        scheduleAppend();
+    }
+
+    QMutexLocker locker(&mutex);
+    pending.append(decoder.flush());
+    // A read error also ends the loop; the text is then incomplete.
+    if (file.error() != QFile::NoError) {
+        failed = true;
+        errorString = file.errorString();
+    }
+    done = true;
+    scheduleAppend();
+}
+
+void FileLoader::scheduleAppend()
+{
+    if (appendScheduled) return;
+    appendScheduled = true;
+    QMetaObject::invokeMethod(this, "appendPending", Qt::QueuedConnection);
+}
+
+void FileLoader::appendPending()
+{
+    TRACE_SCOPE("FileLoader::appendPending");
+    if (cancelled.loadAcquire()) return;
+
+    QString batch;
+    bool finishedLoading = false;
+    bool completed = false;
+    QString error;
+    {
+        QMutexLocker locker(&mutex);
+        appendScheduled = false;
+        while (!pending.isEmpty() && batch.size() < BatchChars) {
+            batch += pending.takeFirst();
+        }
+        pendingChars -= batch.size();
+        spaceAvailable.wakeAll();
+
+        if (!pending.isEmpty()) {
+            scheduleAppend();
+        } else if (done) {
+            finishedLoading = true;
+            completed = !failed;
+            error = errorString;
+        }
+        if (totalBytes > 0) {
+            percent = int(loadedBytes * 100 / totalBytes);
+        }
+    }
+
+    if (!batch.isEmpty()) {
+        QTextCursor cursor(target->document());
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertText(batch);
+    }
+    emit progressChanged(percent);
+
+    if (finishedLoading) {
+        target->document()->setUndoRedoEnabled(undoWasEnabled);
+        target->document()->setModified(false);
+        target->setReadOnly(false);
+        target->moveCursor(QTextCursor::Start);
+        emit finished(completed, error);
+        deleteLater();
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <QFuture>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QWaitCondition>
+
+class QPlainTextEdit;
+
+// Incremental UTF-8 decoder for data arriving in arbitrary chunks. Keeps
+// split multi-byte sequences and a trailing '\r' for the next chunk and
+// turns "\r\n" into "\n" the way QIODevice::Text does, unless told to keep
+// line endings as they are. Malformed sequences decode to U+FFFD and are
+// remembered.
+class ChunkDecoder
+{
+public:
+    explicit ChunkDecoder(bool foldLineEndings = true);
+    QString decode(const QByteArray &bytes);
+    QString flush();
+    bool hasInvalidInput() const { return invalid; }
+
+private:
+    void check(const QByteArray &data, const QString &text);
+
+    QByteArray carry;
+    bool atStart;
+    bool fold;
+    bool invalid;
+};
+
+// Reads and decodes a file on a worker thread and appends the text to an
+// editor in bounded batches from the event loop, so the GUI stays live.
+class FileLoader : public QObject
+{
+    Q_OBJECT
+public:
+    FileLoader(const QString &fileName, QPlainTextEdit *editor);
+    ~FileLoader();
+
+    void start();
+    void cancel();
+    QString fileName() const { return path; }
+    int progress() const { return percent; }
+
+signals:
+    void progressChanged(int percent);
+    void lineCountKnown(qint64 lines);
+    // errorString is empty when the load was cancelled rather than failed.
+    void finished(bool completed, const QString &errorString);
+
+private slots:
+    void appendPending();
+
+private:
+    static const int ChunkBytes = 1024 * 1024;
+    static const int BatchChars = 2 * 1024 * 1024;
+    static const int MaxPendingChars = 8 * 1024 * 1024;
+
+    void run();
+    void scheduleAppend();
+    void stopWorker();
+
+    QString path;
+    QPlainTextEdit *target;
+    qint64 totalBytes;
+    int percent;
+
+    QMutex mutex;
+    QWaitCondition spaceAvailable;
+    QStringList pending;
+    qint64 pendingChars;
+    qint64 loadedBytes;
+    bool appendScheduled;
+    bool done;
+    bool failed;
+    QString errorString;
+    bool undoWasEnabled;
+
+    QAtomicInt cancelled;
+    QFuture<void> future;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "filereloader.h"
+#include "fileloader.h"
+#include <QFile>
+#include <QPlainTextEdit>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QtConcurrent>
+
+FileReloader::FileReloader(const QString &fileName, QPlainTextEdit *editor)
+    : QObject(editor), path(fileName), target(editor), revision(0), busy(false), rerun(false), failed(false)
+{
+}
+
+FileReloader::~FileReloader()
+{
+    future.waitForFinished();
+}
+
+void FileReloader::start()
+{
+    if (busy) {
+        rerun = true;
+        return;
+    }
+    busy = true;
+    rerun = false;
+    revision = target->document()->revision();
+    QString before = target->document()->toRawText();
+    future = QtConcurrent::run([this, before]() { run(before); });
+}
+
+void FileReloader::run(QString before)
+{
+    QFile file(path);
+    failed = !file.open(QFile::ReadOnly);
+    if (!failed) {
+        ChunkDecoder decoder;
+        QString after = decoder.decode(file.readAll());
+        after += decoder.flush();
+        before.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+        hunks = LineDiff::compute(before, after);
+    }
+    QMetaObject::invokeMethod(this, "apply", Qt::QueuedConnection);
+}
+
+void FileReloader::apply()
+{
+    busy = false;
+    QTextDocument *document = target->document();
+    if (failed || document->isModified() || target->isReadOnly()) {
+        // Local edits win over the file.
+        finish(false);
+        return;
+    }
+    if (rerun || document->revision() != revision) {
+        start();
+        return;
+    }
+
+    bool changed = !hunks.isEmpty();
+    if (changed) {
+        QTextCursor cursor(document);
+        cursor.beginEditBlock();
+        for (int i = int(hunks.size()) - 1; i >= 0; --i) {
+            const LineDiff::Hunk &hunk = hunks.at(i);
+            cursor.setPosition(hunk.position);
+            cursor.setPosition(hunk.position + hunk.removed, QTextCursor::KeepAnchor);
+            cursor.insertText(hunk.inserted);
+        }
+        cursor.endEditBlock();
+        document->setModified(false);
+    }
+    hunks.clear();
+    finish(changed);
+}
+
+void FileReloader::finish(bool changed)
+{
+    // Detached so a change reported from here on starts a new reloader
+    // instead of reusing this one.
+    setParent(nullptr);
+    emit finished(changed);
+    deleteLater();
+}
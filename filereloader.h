@@ -0,0 +1,44 @@
+#ifndef FILERELOADER_H
+#define FILERELOADER_H
+
+#include "linediff.h"
+#include <QFuture>
+#include <QObject>
+
+class QPlainTextEdit;
+
+// Brings an unmodified editor in line with its file after the file changed
+// on disk. The file is read and diffed against the editor's text on a
+// worker thread; only the changed lines are replaced, in one edit, so the
+// cursor, the undo history and the highlighting of the rest stay as they
+// are. A change arriving mid-reload triggers one more round.
+class FileReloader : public QObject
+{
+    Q_OBJECT
+public:
+    FileReloader(const QString &fileName, QPlainTextEdit *editor);
+    ~FileReloader();
+
+    void start();
+
+signals:
+    void finished(bool changed);
+
+private slots:
+    void apply();
+
+private:
+    void run(QString before);
+    void finish(bool changed);
+
+    QString path;
+    QPlainTextEdit *target;
+    int revision;
+    bool busy;
+    bool rerun;
+    bool failed;
+    QVector<LineDiff::Hunk> hunks;
+    QFuture<void> future;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "filesaver.h"
+#include "tracer.h"
+#include <QSaveFile>
+#include <QtConcurrent>
+
+FileSaver::FileSaver(const QString &fileName, const QString &rawText, QObject *parent)
+    : QObject(parent), path(fileName), text(rawText), fromSnapshot(false)
+{
+}
+
+FileSaver::FileSaver(const QString &fileName, const PieceTable::Snapshot &snapshot, QObject *parent)
+    : QObject(parent), path(fileName), bytes(snapshot), fromSnapshot(true)
+{
+}
+
+FileSaver::~FileSaver()
+{
+    // A save that is already running is allowed to finish, the temporary
+    // file is only renamed over the target once it has been written fully.
+    future.waitForFinished();
+}
+
+void FileSaver::start()
+{
+    future = QtConcurrent::run([this]() { run(); });
+}
+
+void FileSaver::run()
+{
+    TRACE_SCOPE("FileSaver::run");
+    QSaveFile output(path);
+    if (!output.open(QFile::WriteOnly)) {
+        emit finished(false, output.errorString());
+        return;
+    }
+
+    bool written = fromSnapshot ? bytes.writeTo(&output) : writeText(&output);
+    // A mapping blanked while it was copied would write zeros in place of
+    // text the file no longer has.
+    if (written && fromSnapshot && bytes.isDetached()) {
+        output.cancelWriting();
+        emit finished(false, "the file shrank on disk while it was open");
+        return;
+    }
+    if (!written) {
+        QString error = output.errorString();
+        output.cancelWriting();
+        emit finished(false, error);
+        return;
+    }
+
+    // commit() flushes and syncs the temporary file before renaming it.
+    if (!output.commit()) {
+        emit finished(false, output.errorString());
+        return;
+    }
+    emit finished(true, QString());
+}
+
+bool FileSaver::writeText(QIODevice *device) const
+{
+    // The text comes from QTextDocument::toRawText(), so block and line
+    // separators are converted here instead of on the GUI thread.
+    int pos = 0;
+    while (pos < text.size()) {
+        int length = qMin(EncodeChunkChars, int(text.size()) - pos);
+        if (pos + length < text.size() && text.at(pos + length - 1).isHighSurrogate()) --length;
+
+        QString chunk = text.mid(pos, length);
+        QChar *data = chunk.data();
+        for (int i = 0; i < chunk.size(); ++i) {
+            ushort c = data[i].unicode();
+            if (c == QChar::ParagraphSeparator || c == QChar::LineSeparator) {
+                data[i] = QLatin1Char('\n');
+            } else if (c == QChar::Nbsp) {
+                data[i] = QLatin1Char(' ');
+            }
+        }
+
+        QByteArray encoded = chunk.toUtf8();
+        if (device->write(encoded) != encoded.size()) return false;
+        pos += length;
+    }
+    return true;
+}
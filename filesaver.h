@@ -0,0 +1,39 @@
+#ifndef FILESAVER_H
+#define FILESAVER_H
+
+#include "piecetable.h"
+#include <QFuture>
+#include <QObject>
+#include <QString>
+
+// Writes a document snapshot on a worker thread. Text is encoded in chunks
+// into a temporary file next to the target, which QSaveFile syncs to disk
+// and renames over the target, so a crash never leaves a truncated file.
+class FileSaver : public QObject
+{
+    Q_OBJECT
+public:
+    FileSaver(const QString &fileName, const QString &rawText, QObject *parent = nullptr);
+    FileSaver(const QString &fileName, const PieceTable::Snapshot &snapshot, QObject *parent = nullptr);
+    ~FileSaver();
+
+    void start();
+    QString fileName() const { return path; }
+
+signals:
+    void finished(bool saved, const QString &errorString);
+
+private:
+    static const int EncodeChunkChars = 512 * 1024;
+
+    void run();
+    bool writeText(QIODevice *device) const;
+
+    QString path;
+    QString text;
+    PieceTable::Snapshot bytes;
+    bool fromSnapshot;
+    QFuture<void> future;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "filewatcher.h"
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+
+FileWatcher::FileWatcher(QObject *parent) : QObject(parent)
+{
+    watcher = new QFileSystemWatcher(this);
+    settleTimer = new QTimer(this);
+    settleTimer->setSingleShot(true);
+    settleTimer->setInterval(SettleMsecs);
+
+    connect(watcher, &QFileSystemWatcher::fileChanged, this, &FileWatcher::onChanged);
+    connect(settleTimer, &QTimer::timeout, this, &FileWatcher::flush);
+}
+
+void FileWatcher::setFiles(const QStringList &paths)
+{
+    QSet<QString> wanted;
+    for (const QString &path : paths) {
+        if (!path.isEmpty()) wanted.insert(QFileInfo(path).absoluteFilePath());
+    }
+
+    QStringList removed;
+    for (const QString &path : qAsConst(files)) {
+        if (!wanted.contains(path)) removed.append(path);
+    }
+    const QStringList watched = watcher->files();
+    for (const QString &path : qAsConst(removed)) {
+        if (watched.contains(path)) watcher->removePath(path);
+        changed.remove(path);
+    }
+    files = wanted;
+    rewatch();
+}
+
+void FileWatcher::onChanged(const QString &path)
+{
+    changed.insert(path);
+    // Not restarted by later writes, so a file written without pause, such
+    // as a busy log, is still reported every SettleMsecs.
+    if (!settleTimer->isActive()) settleTimer->start();
+}
+
+void FileWatcher::flush()
+{
+    // A file that is missing right now is being replaced or was deleted;
+    // it is reported once it is back.
+    rewatch();
+    const QSet<QString> paths = changed;
+    changed.clear();
+    for (const QString &path : paths) {
+        if (!files.contains(path)) continue;
+        if (QFileInfo::exists(path)) {
+            emit fileChanged(path);
+        } else {
+            changed.insert(path);
+        }
+    }
+    if (!changed.isEmpty()) settleTimer->start();
+}
+
+void FileWatcher::rewatch()
+{
+    const QStringList watched = watcher->files();
+    for (const QString &path : qAsConst(files)) {
+        if (!watched.contains(path) && QFileInfo::exists(path)) {
+            watcher->addPath(path);
+        }
+    }
+}
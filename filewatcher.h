@@ -0,0 +1,43 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+class QFileSystemWatcher;
+class QTimer;
+
+// Watches the files open in tabs. The first change opens a SettleMsecs
+// window and every file changed within it is reported once when it closes,
+// so a build rewriting a file costs one reload and a file written without
+// pause, such as a busy log, is reported every SettleMsecs. Files replaced
+// by a rename drop out of QFileSystemWatcher and are picked up again when
+// they reappear.
+class FileWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FileWatcher(QObject *parent = nullptr);
+
+    void setFiles(const QStringList &paths);
+
+signals:
+    void fileChanged(const QString &path);
+
+private slots:
+    void onChanged(const QString &path);
+    void flush();
+
+private:
+    static const int SettleMsecs = 300;
+
+    void rewatch();
+
+    QFileSystemWatcher *watcher;
+    QTimer *settleTimer;
+    QSet<QString> files;
+    QSet<QString> changed;
+};
+
+#endif
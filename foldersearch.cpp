@@ -0,0 +1,453 @@
+#include "foldersearch.h"
+#include "mapguard.h"
+#include "newlinescanner.h"
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+#include <QThread>
+#include <climits>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <sys/stat.h>
+#else
+#include <QDirIterator>
+#endif
+
+// Rules from one .gitignore file, chained to the rules of the folders
+// above it. The last matching rule of the deepest file wins, as in git.
+class IgnoreRules
+{
+public:
+    static QSharedPointer<const IgnoreRules> forDirectory(const QString &directory,
+                                                          const QSharedPointer<const IgnoreRules> &parent);
+    bool isIgnored(const QString &path, const QString &name, bool directory) const;
+
+private:
+    struct Rule
+    {
+        QRegularExpression pattern;
+        bool negated;
+        bool directoryOnly;
+        bool anchored;
+    };
+
+    static QString globToRegularExpression(const QString &glob);
+
+    QString base;
+    QVector<Rule> rules;
+    QSharedPointer<const IgnoreRules> parent;
+};
+
+QSharedPointer<const IgnoreRules> IgnoreRules::forDirectory(const QString &directory,
+                                                            const QSharedPointer<const IgnoreRules> &parent)
+{
+    QFile file(directory + "/.gitignore");
+    if (!file.open(QFile::ReadOnly)) return parent;
+
+    QSharedPointer<IgnoreRules> result(new IgnoreRules);
+    result->base = directory;
+    result->parent = parent;
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine());
+        while (line.endsWith(QLatin1Char('\n')) || line.endsWith(QLatin1Char('\r')) || line.endsWith(QLatin1Char(' '))) {
+            line.chop(1);
+        }
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) continue;
+
+        Rule rule;
+        rule.negated = line.startsWith(QLatin1Char('!'));
+        if (rule.negated) line.remove(0, 1);
+        rule.directoryOnly = line.endsWith(QLatin1Char('/'));
+        if (rule.directoryOnly) line.chop(1);
+        // A slash anywhere but at the end ties the pattern to this folder;
+        // otherwise it matches a name at any depth.
+        rule.anchored = line.contains(QLatin1Char('/'));
+        if (line.startsWith(QLatin1Char('/'))) line.remove(0, 1);
+        if (line.isEmpty()) continue;
+
+        rule.pattern = QRegularExpression(globToRegularExpression(line));
+        if (!rule.pattern.isValid()) continue;
+        rule.pattern.optimize();
+        result->rules.append(rule);
+    }
+    if (result->rules.isEmpty()) return parent;
+    return result;
+}
+
+bool IgnoreRules::isIgnored(const QString &path, const QString &name, bool directory) const
+{
+    QString relative = path.mid(base.endsWith(QLatin1Char('/')) ? base.size() : base.size() + 1);
+    for (int i = rules.size() - 1; i >= 0; --i) {
+        const Rule &rule = rules.at(i);
+        if (rule.directoryOnly && !directory) continue;
+        if (rule.pattern.match(rule.anchored ? relative : name).hasMatch()) return !rule.negated;
+    }
+    return parent && parent->isIgnored(path, name, directory);
+}
+
+QString IgnoreRules::globToRegularExpression(const QString &glob)
+{
+    QString result;
+    for (int i = 0; i < glob.size(); ++i) {
+        QChar c = glob.at(i);
+        if (c == QLatin1Char('*')) {
+            if (i + 1 < glob.size() && glob.at(i + 1) == QLatin1Char('*')) {
+                ++i;
+                if (i + 1 < glob.size() && glob.at(i + 1) == QLatin1Char('/')) {
+                    result += "(?:.*/)?";
+                    ++i;
+                } else {
+                    result += ".*";
+                }
+            } else {
+                result += "[^/]*";
+            }
+        } else if (c == QLatin1Char('?')) {
+            result += "[^/]";
+        } else if (c == QLatin1Char('[') && glob.indexOf(QLatin1Char(']'), i + 1) > i + 1) {
+            int close = glob.indexOf(QLatin1Char(']'), i + 1);
+            QString set = glob.mid(i + 1, close - i - 1);
+            if (set.startsWith(QLatin1Char('!'))) set[0] = QLatin1Char('^');
+            result += QLatin1Char('[') + set.replace(QLatin1Char('\\'), QLatin1String("\\\\")) + QLatin1Char(']');
+            i = close;
+        } else if (c == QLatin1Char('\\') && i + 1 < glob.size()) {
+            result += QRegularExpression::escape(QString(glob.at(++i)));
+        } else {
+            result += QRegularExpression::escape(QString(c));
+        }
+    }
+    return "^" + result + "$";
+}
+
+namespace {
+
+inline bool isWordByte(uchar c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+}
+
+inline char toLowerAscii(char c)
+{
+    return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+}
+
+inline char toUpperAscii(char c)
+{
+    return c >= 'a' && c <= 'z' ? char(c - 'a' + 'A') : c;
+}
+
+bool isAscii(const QString &text)
+{
+    for (QChar c : text) {
+        if (c.unicode() >= 0x80) return false;
+    }
+    return true;
+}
+
+}
+
+FolderSearch::FolderSearch(const QString &folder, const TextSearch::Options &options, QObject *parent)
+    : QObject(parent), root(QDir::cleanPath(folder)), searcher(options), options(options),
+      needle(options.pattern.toUtf8()), pending(0), active(0), searched(0), cancelled(0), notified(false)
+{
+    // Literal patterns are matched on the raw UTF-8 bytes, which needs no
+    // decoding; only regular expressions and case-insensitive non-ASCII
+    // patterns decode the file first.
+    byteSearch = !options.regularExpression && (options.caseSensitive || isAscii(options.pattern));
+}
+
+FolderSearch::~FolderSearch()
+{
+    cancel();
+    pool.waitForDone();
+    qDeleteAll(queues);
+}
+
+void FolderSearch::start()
+{
+    int workers = qMax(1, QThread::idealThreadCount());
+    pool.setMaxThreadCount(workers);
+    for (int i = 0; i < workers; ++i) {
+        queues.append(new Queue);
+    }
+
+    active.storeRelease(workers);
+    push(0, Task{root, QSharedPointer<const IgnoreRules>(), true});
+    for (int i = 0; i < workers; ++i) {
+        pool.start([this, i]() { run(i); });
+    }
+}
+
+void FolderSearch::cancel()
+{
+    cancelled.storeRelease(1);
+}
+
+QVector<FolderSearch::FileHits> FolderSearch::takeResults()
+{
+    QMutexLocker locker(&mutex);
+    QVector<FileHits> taken;
+    taken.swap(results);
+    notified = false;
+    return taken;
+}
+
+void FolderSearch::run(int worker)
+{
+    // pending counts queued and running tasks. Children are queued before
+    // their parent is counted down, so zero means the walk is complete.
+    int idle = 0;
+    QByteArray buffer;
+    while (!cancelled.loadAcquire()) {
+        Task task;
+        if (!takeTask(worker, task)) {
+            if (pending.loadAcquire() == 0) break;
+            if (++idle < 64) {
+                QThread::yieldCurrentThread();
+            } else {
+                QThread::usleep(200);
+            }
+            continue;
+        }
+        idle = 0;
+        if (task.directory) {
+            listDirectory(worker, task);
+        } else {
+            searchFile(task.path, buffer);
+        }
+        pending.deref();
+    }
+
+    if (!active.deref()) {
+        emit finished();
+    }
+}
+
+bool FolderSearch::takeTask(int worker, Task &task)
+{
+    // Own work is taken newest first, which keeps a worker inside the
+    // subtree it is walking; stolen work is the oldest, usually the largest.
+    Queue *own = queues.at(worker);
+    {
+        QMutexLocker locker(&own->mutex);
+        if (!own->tasks.empty()) {
+            task = own->tasks.back();
+            own->tasks.pop_back();
+            return true;
+        }
+    }
+    for (int i = 1; i < queues.size(); ++i) {
+        Queue *victim = queues.at((worker + i) % queues.size());
+        QMutexLocker locker(&victim->mutex);
+        if (!victim->tasks.empty()) {
+            task = victim->tasks.front();
+            victim->tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void FolderSearch::push(int worker, const Task &task)
+{
+    pending.ref();
+    Queue *queue = queues.at(worker);
+    QMutexLocker locker(&queue->mutex);
+    queue->tasks.push_back(task);
+}
+
+void FolderSearch::listDirectory(int worker, const Task &task)
+{
+    QSharedPointer<const IgnoreRules> rules = IgnoreRules::forDirectory(task.path, task.rules);
+    QString prefix = task.path.endsWith(QLatin1Char('/')) ? task.path : task.path + QLatin1Char('/');
+
+    // Hidden entries (including .git) and symbolic links are skipped.
+    auto visit = [&](const QString &name, bool directory) {
+        QString path = prefix + name;
+        if (rules && rules->isIgnored(path, name, directory)) return;
+        push(worker, Task{path, rules, directory});
+    };
+
+#ifdef Q_OS_UNIX
+    QByteArray encoded = QFile::encodeName(prefix);
+    DIR *dir = opendir(encoded.constData());
+    if (!dir) return;
+    while (dirent *entry = readdir(dir)) {
+        if (cancelled.loadAcquire()) break;
+        if (entry->d_name[0] == '.') continue;
+
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat status;
+            if (lstat((encoded + entry->d_name).constData(), &status) != 0) continue;
+            type = S_ISDIR(status.st_mode) ? DT_DIR : S_ISREG(status.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if (type != DT_DIR && type != DT_REG) continue;
+        visit(QFile::decodeName(entry->d_name), type == DT_DIR);
+    }
+    closedir(dir);
+#else
+    QDirIterator it(task.path, QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+    while (it.hasNext() && !cancelled.loadAcquire()) {
+        it.next();
+        visit(it.fileName(), it.fileInfo().isDir());
+    }
+#endif
+}
+
+void FolderSearch::searchFile(const QString &path, QByteArray &buffer)
+{
+    searched.ref();
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) return;
+    qint64 size = file.size();
+    if (size <= 0) return;
+
+    // A build or checkout may truncate a file while it is searched. Read
+    // past the new end, a mapping raises SIGBUS, so only files too large
+    // to copy cheaply are mapped, and only under a MapGuard.
+    const char *data = nullptr;
+    if (size >= MapBytes) {
+        data = reinterpret_cast<const char *>(file.map(0, size));
+        if (data && !MapGuard::add(data, size)) {
+            file.unmap(reinterpret_cast<uchar *>(const_cast<char *>(data)));
+            data = nullptr;
+        }
+    }
+    bool mapped = data != nullptr;
+    if (!mapped) {
+        if (size > buffer.size()) buffer.resize(int(qMin<qint64>(size, INT_MAX)));
+        size = file.read(buffer.data(), buffer.size());
+        if (size <= 0) return;
+        data = buffer.constData();
+    }
+
+    FileHits hits{path, QVector<Hit>()};
+    // Like git and grep, a NUL byte near the start means binary.
+    if (!std::memchr(data, 0, size_t(qMin<qint64>(size, BinaryProbe)))) {
+        if (byteSearch) {
+            searchBytes(data, size, hits.hits);
+        } else if (size < INT_MAX / 2) {
+            searchText(data, size, hits.hits);
+        }
+    }
+    // Hits in a file that shrank under the search may be past its end.
+    if (mapped) {
+        if (MapGuard::isDetached(data)) hits.hits.clear();
+        MapGuard::remove(data);
+    } else if (buffer.size() > MapBytes) {
+        // Only a file that could not be mapped gets here; its copy is not kept.
+        buffer = QByteArray();
+    }
+    if (!hits.hits.isEmpty()) publish(hits);
+}
+
+void FolderSearch::searchBytes(const char *data, qint64 length, QVector<Hit> &hits) const
+{
+    const int size = needle.size();
+    if (size == 0) return;
+    const char lower = options.caseSensitive ? needle.at(0) : toLowerAscii(needle.at(0));
+    const char upper = options.caseSensitive ? needle.at(0) : toUpperAscii(needle.at(0));
+    const qint64 last = length - size;
+
+    // Candidates come from memchr for each case of the first byte; each
+    // result is kept until passed, so every byte is scanned once per case.
+    qint64 nextLower = -1;
+    qint64 nextUpper = lower == upper ? length : -1;
+    qint64 line = 0;
+    qint64 lineStart = 0;
+    qint64 scanned = 0;
+    qint64 pos = 0;
+    while (pos <= last && hits.size() < MaxHitsPerFile && !cancelled.loadAcquire()) {
+        if (nextLower < pos) {
+            const void *found = std::memchr(data + pos, lower, size_t(last + 1 - pos));
+            nextLower = found ? static_cast<const char *>(found) - data : length;
+        }
+        if (nextUpper < pos) {
+            const void *found = std::memchr(data + pos, upper, size_t(last + 1 - pos));
+            nextUpper = found ? static_cast<const char *>(found) - data : length;
+        }
+        qint64 at = qMin(nextLower, nextUpper);
+        if (at > last) break;
+
+        const char *candidate = data + at;
+        bool equal = options.caseSensitive ? std::memcmp(candidate, needle.constData(), size_t(size)) == 0
+                                           : qstrnicmp(candidate, needle.constData(), uint(size)) == 0;
+        if (equal && options.wholeWords) {
+            equal = (at == 0 || !isWordByte(uchar(data[at - 1])))
+                    && (at + size >= length || !isWordByte(uchar(data[at + size])));
+        }
+        if (!equal) {
+            pos = at + 1;
+            continue;
+        }
+
+        qint64 newlines = NewlineScanner::count(data + scanned, at - scanned);
+        if (newlines > 0) {
+            line += newlines;
+            lineStart = at;
+            while (lineStart > scanned && data[lineStart - 1] != '\n') --lineStart;
+        }
+        scanned = at;
+
+        const void *newline = std::memchr(candidate, '\n', size_t(length - at));
+        qint64 lineEnd = newline ? static_cast<const char *>(newline) - data : length;
+        qint64 from = at - lineStart > MaxPreview / 2 ? at - MaxPreview / 4 : lineStart;
+        while (from < at && (uchar(data[from]) & 0xC0) == 0x80) ++from;
+
+        Hit hit;
+        hit.line = int(qMin<qint64>(line, INT_MAX));
+        hit.column = at - lineStart < 65536 ? int(QString::fromUtf8(data + lineStart, int(at - lineStart)).size())
+                                            : int(qMin<qint64>(at - lineStart, INT_MAX));
+        hit.preview = QString::fromUtf8(data + from, int(qMin<qint64>(lineEnd - from, MaxPreview)));
+        if (hit.preview.endsWith(QLatin1Char('\r'))) hit.preview.chop(1);
+        hits.append(hit);
+        pos = at + size;
+    }
+}
+
+void FolderSearch::searchText(const char *data, qint64 length, QVector<Hit> &hits) const
+{
+    QString text = QString::fromUtf8(data, int(length));
+    const QChar *characters = text.constData();
+    const int size = int(text.size());
+    int line = 0;
+    int lineStart = 0;
+    int scanned = 0;
+
+    searcher.findAll(text, [&](const TextSearch::Match &match) {
+        if (cancelled.loadAcquire()) return false;
+        while (scanned < match.position) {
+            int newline = TextSearch::indexOf(characters + scanned, match.position - scanned, QLatin1Char('\n'), QLatin1Char('\n'));
+            if (newline < 0) break;
+            ++line;
+            lineStart = scanned + newline + 1;
+            scanned = lineStart;
+        }
+        scanned = qMax(scanned, match.position);
+
+        int newline = TextSearch::indexOf(characters + match.position, size - match.position, QLatin1Char('\n'), QLatin1Char('\n'));
+        int lineEnd = newline < 0 ? size : match.position + newline;
+        int from = match.position - lineStart > MaxPreview / 2 ? match.position - MaxPreview / 4 : lineStart;
+
+        Hit hit;
+        hit.line = line;
+        hit.column = match.position - lineStart;
+        hit.preview = text.mid(from, qMin(lineEnd - from, int(MaxPreview)));
+        if (hit.preview.endsWith(QLatin1Char('\r'))) hit.preview.chop(1);
+        hits.append(hit);
+        return hits.size() < MaxHitsPerFile;
+    });
+}
+
+void FolderSearch::publish(const FileHits &file)
+{
+    QMutexLocker locker(&mutex);
+    results.append(file);
+    if (!notified) {
+        notified = true;
+        emit resultsReady();
+    }
+}
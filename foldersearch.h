@@ -0,0 +1,98 @@
+#ifndef FOLDERSEARCH_H
+#define FOLDERSEARCH_H
+
+#include "textsearch.h"
+#include <QAtomicInt>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+#include <deque>
+
+class IgnoreRules;
+
+// Searches every file below a folder on a pool of worker threads. Each
+// worker keeps its own queue of directories and files and steals from the
+// others when it runs dry, so one huge directory does not serialise the
+// walk. Small files are read into a buffer each worker reuses and large
+// ones are memory-mapped under a MapGuard; binaries, hidden entries and paths
+// excluded by .gitignore files are skipped. Results are collected per
+// file and handed to the GUI thread in batches.
+class FolderSearch : public QObject
+{
+    Q_OBJECT
+public:
+    struct Hit
+    {
+        int line;
+        int column;
+        QString preview;
+    };
+
+    struct FileHits
+    {
+        QString path;
+        QVector<Hit> hits;
+    };
+
+    FolderSearch(const QString &folder, const TextSearch::Options &options, QObject *parent = nullptr);
+    ~FolderSearch();
+
+    void start();
+    void cancel();
+    QVector<FileHits> takeResults();
+    int filesSearched() const { return searched.loadAcquire(); }
+    bool isFinished() const { return active.loadAcquire() == 0; }
+
+signals:
+    void resultsReady();
+    void finished();
+
+private:
+    static const int MaxHitsPerFile = 1000;
+    static const int MaxPreview = 200;
+    static const int BinaryProbe = 8192;
+    static const qint64 MapBytes = 1024 * 1024;
+
+    struct Task
+    {
+        QString path;
+        QSharedPointer<const IgnoreRules> rules;
+        bool directory;
+    };
+
+    struct Queue
+    {
+        QMutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(int worker);
+    bool takeTask(int worker, Task &task);
+    void push(int worker, const Task &task);
+    void listDirectory(int worker, const Task &task);
+    void searchFile(const QString &path, QByteArray &buffer);
+    void searchBytes(const char *data, qint64 length, QVector<Hit> &hits) const;
+    void searchText(const char *data, qint64 length, QVector<Hit> &hits) const;
+    void publish(const FileHits &file);
+
+    QString root;
+    TextSearch searcher;
+    TextSearch::Options options;
+    QByteArray needle;
+    bool byteSearch;
+
+    QThreadPool pool;
+    QVector<Queue*> queues;
+    QAtomicInt pending;
+    QAtomicInt active;
+    QAtomicInt searched;
+    QAtomicInt cancelled;
+
+    QMutex mutex;
+    QVector<FileHits> results;
+    bool notified;
+};
+
+#endif
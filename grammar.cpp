@@ -0,0 +1,312 @@
+#include "grammar.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace {
+
+inline bool isDigit(ushort c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool isIdentifierStart(ushort c)
+{
+    if (c < 128) return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    return QChar(c).isLetter();
+}
+
+inline bool isIdentifierChar(ushort c)
+{
+    if (c < 128) return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || isDigit(c);
+    return QChar(c).isLetterOrNumber();
+}
+
+inline ushort toLower(ushort c)
+{
+    return c >= 'A' && c <= 'Z' ? ushort(c + ('a' - 'A')) : c;
+}
+
+inline void addToken(QVector<CppLexer::Token> &tokens, int start, int end, CppLexer::TokenKind kind)
+{
+    if (end > start) tokens.append(CppLexer::Token{start, end - start, kind});
+}
+
+inline void addBracket(QVector<CppLexer::Bracket> *brackets, int position, ushort c)
+{
+    if (!brackets) return;
+    switch (c) {
+    case '{': brackets->append(CppLexer::Bracket{position, CppLexer::Brace, 1}); break;
+    case '}': brackets->append(CppLexer::Bracket{position, CppLexer::Brace, -1}); break;
+    case '(': brackets->append(CppLexer::Bracket{position, CppLexer::Paren, 1}); break;
+    case ')': brackets->append(CppLexer::Bracket{position, CppLexer::Paren, -1}); break;
+    case '[': brackets->append(CppLexer::Bracket{position, CppLexer::Square, 1}); break;
+    case ']': brackets->append(CppLexer::Bracket{position, CppLexer::Square, -1}); break;
+    default: break;
+    }
+}
+
+QStringList strings(const QJsonValue &value)
+{
+    QStringList result;
+    const QJsonArray array = value.toArray();
+    for (const QJsonValue &item : array) {
+        result.append(item.toString());
+    }
+    return result;
+}
+
+}
+
+Grammar Grammar::compile(const QByteArray &source, QString *error)
+{
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(source, &parseError);
+    if (!document.isObject()) {
+        if (error) *error = parseError.errorString();
+        return Grammar();
+    }
+
+    QJsonObject object = document.object();
+    Grammar grammar;
+    grammar.title = object.value("name").toString();
+    const QStringList extensions = strings(object.value("extensions"));
+    for (const QString &extension : extensions) {
+        grammar.suffixes.append(extension.toLower());
+    }
+    grammar.caseSensitive = object.value("caseSensitive").toBool(true);
+    QString escape = object.value("escape").toString("\\");
+    grammar.escape = escape.isEmpty() ? 0 : escape.at(0).unicode();
+
+    // State 0 is the root. No transition leads back to it, so a 0 in the
+    // table means there is none.
+    grammar.transitions.fill(0, Columns);
+    grammar.accepts.append(None);
+    grammar.indexes.append(0);
+
+    bool ok = true;
+    QString failed;
+    auto fail = [&ok, &failed](const QString &word) {
+        ok = false;
+        failed = word;
+    };
+    const QStringList keywords = strings(object.value("keywords"));
+    for (const QString &word : keywords) {
+        if (!grammar.add(word, Keyword, 0)) fail(word);
+    }
+    const QStringList types = strings(object.value("types"));
+    for (const QString &word : types) {
+        if (!grammar.add(word, Type, 0)) fail(word);
+    }
+    const QStringList lineComments = strings(object.value("lineComments"));
+    for (const QString &word : lineComments) {
+        if (!grammar.add(word, LineComment, 0)) fail(word);
+    }
+
+    // Block comments and strings are [open, close], strings with an
+    // optional third element saying they may span lines.
+    const Accept kinds[] = { CommentOpen, StringOpen };
+    const char *const keys[] = { "blockComments", "strings" };
+    for (int i = 0; i < 2; ++i) {
+        const QJsonArray pairs = object.value(keys[i]).toArray();
+        for (const QJsonValue &value : pairs) {
+            const QJsonArray pair = value.toArray();
+            QString open = pair.at(0).toString();
+            QString close = pair.at(1).toString();
+            if (close.isEmpty() || !grammar.add(open, kinds[i], int(grammar.closers.size()))) {
+                fail(open);
+                continue;
+            }
+            grammar.closers.append(close);
+            grammar.multiline.append(kinds[i] == CommentOpen || pair.at(2).toBool());
+        }
+    }
+
+    if (grammar.title.isEmpty() || !ok) {
+        if (error) *error = grammar.title.isEmpty() ? QString("Grammar has no name") : QString("Cannot use \"%1\"").arg(failed);
+        return Grammar();
+    }
+    return grammar;
+}
+
+bool Grammar::add(const QString &word, Accept accept, int index)
+{
+    if (word.isEmpty()) return false;
+
+    int state = 0;
+    for (QChar character : word) {
+        ushort c = character.unicode();
+        if (c >= Columns) return false;
+        if (!caseSensitive && (accept == Keyword || accept == Type)) c = toLower(c);
+        int target = transitions.at(state * Columns + c);
+        if (!target) {
+            if (accepts.size() >= MaxStates) return false;
+            target = int(accepts.size());
+            transitions[state * Columns + c] = quint16(target);
+            transitions.resize(transitions.size() + Columns);
+            accepts.append(None);
+            indexes.append(0);
+        }
+        state = target;
+    }
+    accepts[state] = quint8(accept);
+    indexes[state] = quint16(index);
+    return true;
+}
+
+inline int Grammar::next(int state, ushort c) const
+{
+    return c < Columns ? transitions.at(state * Columns + c) : 0;
+}
+
+int Grammar::wordAccept(const QChar *text, int length) const
+{
+    int state = 0;
+    for (int i = 0; i < length && (i == 0 || state); ++i) {
+        ushort c = text[i].unicode();
+        state = next(state, caseSensitive ? c : toLower(c));
+    }
+    int accept = state ? accepts.at(state) : None;
+    return accept == Keyword || accept == Type ? accept : None;
+}
+
+int Grammar::longestDelimiter(const QChar *text, int length, int from, int &end) const
+{
+    int found = -1;
+    int state = 0;
+    for (int i = from; i < length; ++i) {
+        state = next(state, text[i].unicode());
+        if (!state) break;
+        int accept = accepts.at(state);
+        if (accept == LineComment || accept == CommentOpen || accept == StringOpen) {
+            found = state;
+            end = i + 1;
+        }
+    }
+    return found;
+}
+
+int Grammar::findClose(const QChar *text, int length, int from, int index, bool string) const
+{
+    const QString &closer = closers.at(index);
+    int size = int(closer.size());
+    for (int i = from; i + size <= length; ++i) {
+        if (string && escape && text[i].unicode() == escape) {
+            ++i;
+            continue;
+        }
+        int j = 0;
+        while (j < size && text[i + j] == closer.at(j)) {
+            ++j;
+        }
+        if (j == size) return i + size;
+    }
+    return -1;
+}
+
+int Grammar::lex(const QChar *text, int length, int state, QVector<CppLexer::Token> &tokens,
+                 QVector<CppLexer::Bracket> *brackets) const
+{
+    int i = 0;
+    int kind = state & 0xFF;
+    if ((kind == BlockComment || kind == MultilineString) && (state >> 8) < closers.size()) {
+        bool string = kind == MultilineString;
+        CppLexer::TokenKind token = string ? CppLexer::String : CppLexer::Comment;
+        i = findClose(text, length, 0, state >> 8, string);
+        if (i < 0) {
+            addToken(tokens, 0, length, token);
+            return state;
+        }
+        addToken(tokens, 0, i, token);
+    }
+
+    while (i < length) {
+        ushort c = text[i].unicode();
+        if (c == ' ' || c == '\t') {
+            ++i;
+            continue;
+        }
+
+        int start = i;
+        if (isIdentifierStart(c)) {
+            int end = i + 1;
+            while (end < length && isIdentifierChar(text[end].unicode())) ++end;
+            int accept = wordAccept(text + i, end - i);
+            if (accept == Keyword) {
+                addToken(tokens, i, end, CppLexer::Keyword);
+            } else if (accept == Type) {
+                addToken(tokens, i, end, CppLexer::Class);
+            } else if (end < length && text[end].unicode() == '(') {
+                addToken(tokens, i, end, CppLexer::Function);
+            }
+            i = end;
+            continue;
+        }
+
+        if (isDigit(c) || (c == '.' && i + 1 < length && isDigit(text[i + 1].unicode()))) {
+            ++i;
+            while (i < length && text[i].unicode() < 128 && (isIdentifierChar(text[i].unicode()) || text[i].unicode() == '.')) ++i;
+            addToken(tokens, start, i, CppLexer::Number);
+            continue;
+        }
+
+        int end = i;
+        int matched = longestDelimiter(text, length, i, end);
+        if (matched < 0) {
+            addBracket(brackets, i, c);
+            ++i;
+            continue;
+        }
+
+        int accept = accepts.at(matched);
+        if (accept == LineComment) {
+            addToken(tokens, start, length, CppLexer::Comment);
+            return Normal;
+        }
+        int index = indexes.at(matched);
+        bool string = accept == StringOpen;
+        CppLexer::TokenKind token = string ? CppLexer::String : CppLexer::Comment;
+        int close = findClose(text, length, end, index, string);
+        if (close < 0) {
+            // An unclosed single-line string stops at the end of the line.
+            addToken(tokens, start, length, token);
+            if (!multiline.at(index)) return Normal;
+            return (string ? MultilineString : BlockComment) | index << 8;
+        }
+        addToken(tokens, start, close, token);
+        i = close;
+    }
+    return Normal;
+}
+
+QDataStream &operator<<(QDataStream &stream, const Grammar &grammar)
+{
+    return stream << grammar.title << grammar.suffixes << grammar.transitions << grammar.accepts << grammar.indexes
+                  << grammar.closers << grammar.multiline << grammar.escape << grammar.caseSensitive;
+}
+
+QDataStream &operator>>(QDataStream &stream, Grammar &grammar)
+{
+    stream >> grammar.title >> grammar.suffixes >> grammar.transitions >> grammar.accepts >> grammar.indexes
+           >> grammar.closers >> grammar.multiline >> grammar.escape >> grammar.caseSensitive;
+
+    // The tables are trusted by lex(), so one that does not add up is not
+    // used at all.
+    int states = int(grammar.accepts.size());
+    bool valid = stream.status() == QDataStream::Ok && states > 0
+        && grammar.transitions.size() == qint64(states) * Grammar::Columns && grammar.indexes.size() == states
+        && grammar.multiline.size() == grammar.closers.size();
+    for (int i = 0; valid && i < grammar.transitions.size(); ++i) {
+        valid = grammar.transitions.at(i) < states;
+    }
+    for (int i = 0; valid && i < states; ++i) {
+        int accept = grammar.accepts.at(i);
+        valid = accept <= Grammar::StringOpen
+            && (accept < Grammar::CommentOpen || grammar.indexes.at(i) < grammar.closers.size());
+    }
+    if (!valid) {
+        grammar = Grammar();
+        stream.setStatus(QDataStream::ReadCorruptData);
+    }
+    return stream;
+}
@@ -0,0 +1,57 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include "cpplexer.h"
+#include <QByteArray>
+#include <QDataStream>
+#include <QStringList>
+#include <QVector>
+
+// A language described in JSON (keywords, types, comment and string
+// delimiters) and compiled into a state machine: one trie over all of its
+// words and delimiters, walked a character at a time, with what each state
+// accepts. A compiled grammar streams to and from QDataStream, so it is
+// built once and then read back. Tokens and brackets are CppLexer's, so a
+// grammar feeds the same formats and the same StructureIndex.
+class Grammar
+{
+public:
+    enum StateKind { Normal = 0, BlockComment = 1, MultilineString = 2 };
+
+    static Grammar compile(const QByteArray &source, QString *error = nullptr);
+
+    bool isValid() const { return !accepts.isEmpty(); }
+    QString name() const { return title; }
+    QStringList extensions() const { return suffixes; }
+
+    // Takes the state the previous line ended in and returns this line's:
+    // a StateKind, with the delimiter's index above the low byte.
+    int lex(const QChar *text, int length, int state, QVector<CppLexer::Token> &tokens,
+            QVector<CppLexer::Bracket> *brackets = nullptr) const;
+
+    friend QDataStream &operator<<(QDataStream &stream, const Grammar &grammar);
+    friend QDataStream &operator>>(QDataStream &stream, Grammar &grammar);
+
+private:
+    enum Accept { None, Keyword, Type, LineComment, CommentOpen, StringOpen };
+    static const int Columns = 128;
+    static const int MaxStates = 65535;
+
+    bool add(const QString &word, Accept accept, int index);
+    int next(int state, ushort c) const;
+    int wordAccept(const QChar *text, int length) const;
+    int longestDelimiter(const QChar *text, int length, int from, int &end) const;
+    int findClose(const QChar *text, int length, int from, int index, bool string) const;
+
+    QString title;
+    QStringList suffixes;
+    QVector<quint16> transitions;
+    QVector<quint8> accepts;
+    QVector<quint16> indexes;
+    QStringList closers;
+    QVector<quint8> multiline;
+    quint16 escape = 0;
+    bool caseSensitive = true;
+};
+
+#endif
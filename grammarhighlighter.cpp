@@ -0,0 +1,28 @@
+#include "grammarhighlighter.h"
+#include "blockdata.h"
+#include "cpphighlighter.h"
+
+GrammarHighlighter::GrammarHighlighter(QSharedPointer<const Grammar> grammar, QPlainTextEdit *editor)
+    : SyntaxHighlighter(editor), grammar(grammar)
+{
+    CppHighlighter::setFormats(formats);
+}
+
+int GrammarHighlighter::highlightLine(const QString &text, const QTextBlock &block, int previousState,
+                                      QVector<QTextLayout::FormatRange> &ranges)
+{
+    tokens.clear();
+    brackets.clear();
+    int state = grammar->lex(text.constData(), int(text.size()), qMax(0, previousState), tokens, &brackets);
+    for (const CppLexer::Token &token : tokens) {
+        QTextLayout::FormatRange range;
+        range.start = token.start;
+        range.length = token.length;
+        range.format = formats[token.kind];
+        ranges.append(range);
+    }
+
+    BlockData *data = blockData(block);
+    if (data->brackets != brackets) data->brackets = brackets;
+    return state;
+}
@@ -0,0 +1,27 @@
+#ifndef GRAMMARHIGHLIGHTER_H
+#define GRAMMARHIGHLIGHTER_H
+
+#include "cpplexer.h"
+#include "grammar.h"
+#include "syntaxhighlighter.h"
+#include <QSharedPointer>
+#include <QTextCharFormat>
+
+// Colours a language using a compiled Grammar, in CppHighlighter's colours.
+class GrammarHighlighter : public SyntaxHighlighter
+{
+    Q_OBJECT
+public:
+    GrammarHighlighter(QSharedPointer<const Grammar> grammar, QPlainTextEdit *editor);
+
+protected:
+    int highlightLine(const QString &text, const QTextBlock &block, int previousState,
+                      QVector<QTextLayout::FormatRange> &formats) override;
+private:
+    QSharedPointer<const Grammar> grammar;
+    QTextCharFormat formats[CppLexer::TokenKindCount];
+    QVector<CppLexer::Token> tokens;
+    QVector<CppLexer::Bracket> brackets;
+};
+
+#endif
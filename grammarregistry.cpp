@@ -0,0 +1,159 @@
+#include "grammarregistry.h"
+#include "cpphighlighter.h"
+#include "grammarhighlighter.h"
+#include "symbolindex.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+
+const char *const builtinGrammars[] = {
+R"json({
+    "name": "Python",
+    "extensions": ["py", "pyw", "pyi"],
+    "keywords": ["and", "as", "assert", "async", "await", "break", "class", "continue", "def", "del", "elif",
+                 "else", "except", "finally", "for", "from", "global", "if", "import", "in", "is", "lambda",
+                 "nonlocal", "not", "or", "pass", "raise", "return", "try", "while", "with", "yield",
+                 "True", "False", "None", "self"],
+    "types": ["int", "float", "str", "bytes", "bool", "list", "dict", "set", "tuple", "object"],
+    "lineComments": ["#"],
+    "strings": [["\"\"\"", "\"\"\"", true], ["'''", "'''", true], ["\"", "\""], ["'", "'"]]
+})json",
+R"json({
+    "name": "JavaScript",
+    "extensions": ["js", "mjs", "cjs", "jsx"],
+    "keywords": ["async", "await", "break", "case", "catch", "class", "const", "continue", "debugger", "default",
+                 "delete", "do", "else", "export", "extends", "finally", "for", "function", "if", "import", "in",
+                 "instanceof", "let", "new", "of", "return", "static", "super", "switch", "this", "throw", "try",
+                 "typeof", "var", "void", "while", "with", "yield", "true", "false", "null", "undefined"],
+    "types": ["Array", "Object", "String", "Number", "Boolean", "Promise", "Map", "Set", "Error"],
+    "lineComments": ["//"],
+    "blockComments": [["/*", "*/"]],
+    "strings": [["\"", "\""], ["'", "'"], ["`", "`", true]]
+})json",
+R"json({
+    "name": "JSON",
+    "extensions": ["json"],
+    "keywords": ["true", "false", "null"],
+    "strings": [["\"", "\""]]
+})json",
+R"json({
+    "name": "Shell",
+    "extensions": ["sh", "bash", "zsh"],
+    "keywords": ["if", "then", "else", "elif", "fi", "for", "while", "until", "do", "done", "case", "esac", "in",
+                 "function", "return", "local", "export", "readonly", "source", "exit", "break", "continue"],
+    "lineComments": ["#"],
+    "strings": [["\"", "\"", true], ["'", "'", true]]
+})json",
+};
+
+}
+
+const char *const GrammarRegistry::CppLanguage = "C++";
+
+GrammarRegistry::GrammarRegistry(const QString &configDirectory, QObject *parent)
+    : QObject(parent), directory(configDirectory), loaded(false)
+{
+}
+
+QString GrammarRegistry::languageFor(const QString &fileName)
+{
+    // Untitled tabs keep the C++ colours they always had.
+    if (fileName.isEmpty() || SymbolIndex::isSource(fileName)) return QString(CppLanguage);
+    if (!loaded) load();
+    return languages.value(QFileInfo(fileName).suffix().toLower());
+}
+
+SyntaxHighlighter *GrammarRegistry::createHighlighter(const QString &language, QPlainTextEdit *editor)
+{
+    if (language == QLatin1String(CppLanguage)) return new CppHighlighter(editor);
+    QSharedPointer<const Grammar> found = grammar(language);
+    return found ? new GrammarHighlighter(found, editor) : nullptr;
+}
+
+QSharedPointer<const Grammar> GrammarRegistry::grammar(const QString &language)
+{
+    if (!loaded) load();
+    return grammars.value(language);
+}
+
+void GrammarRegistry::load()
+{
+    loaded = true;
+
+    QList<QByteArray> sources;
+    for (const char *source : builtinGrammars) {
+        sources.append(QByteArray(source));
+    }
+    // User grammars come last, so one named like a built-in replaces it.
+    QDir folder(directory + "/grammars");
+    const QStringList files = folder.entryList(QStringList() << "*.json", QDir::Files, QDir::Name);
+    for (const QString &name : files) {
+        QFile file(folder.filePath(name));
+        if (file.open(QFile::ReadOnly)) sources.append(file.readAll());
+    }
+
+    const QHash<QByteArray, Grammar> cached = readCache();
+    QHash<QByteArray, Grammar> cache;
+    bool changed = false;
+    for (const QByteArray &source : qAsConst(sources)) {
+        QByteArray key = QCryptographicHash::hash(source, QCryptographicHash::Md5);
+        Grammar grammar = cached.value(key);
+        if (!grammar.isValid()) {
+            grammar = Grammar::compile(source);
+            changed = true;
+            // A grammar that does not compile is left out until it is fixed.
+            if (!grammar.isValid()) continue;
+        }
+        cache.insert(key, grammar);
+
+        QSharedPointer<const Grammar> shared(new Grammar(grammar));
+        grammars.insert(grammar.name(), shared);
+        const QStringList extensions = grammar.extensions();
+        for (const QString &extension : extensions) {
+            languages.insert(extension, grammar.name());
+        }
+    }
+
+    // Dropped or edited grammars leave stale entries behind; they go too.
+    if (changed || cache.size() != cached.size()) writeCache(cache);
+}
+
+QHash<QByteArray, Grammar> GrammarRegistry::readCache() const
+{
+    QHash<QByteArray, Grammar> result;
+    QFile file(directory + "/grammars.cache");
+    if (!file.open(QFile::ReadOnly)) return result;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != Magic || version != Version) return result;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QByteArray key;
+        Grammar grammar;
+        stream >> key >> grammar;
+        if (stream.status() == QDataStream::Ok) result.insert(key, grammar);
+    }
+    return result;
+}
+
+bool GrammarRegistry::writeCache(const QHash<QByteArray, Grammar> &cache) const
+{
+    QDir().mkpath(directory);
+    QSaveFile output(directory + "/grammars.cache");
+    if (!output.open(QFile::WriteOnly)) return false;
+    QDataStream stream(&output);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << Magic << Version << quint32(cache.size());
+    for (auto it = cache.cbegin(); it != cache.cend(); ++it) {
+        stream << it.key() << it.value();
+    }
+    return stream.status() == QDataStream::Ok && output.commit();
+}
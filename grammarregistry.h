@@ -0,0 +1,47 @@
+#ifndef GRAMMARREGISTRY_H
+#define GRAMMARREGISTRY_H
+
+#include "grammar.h"
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+
+class QPlainTextEdit;
+class SyntaxHighlighter;
+
+// Picks a language by file extension and makes its highlighter. C++ keeps
+// CppHighlighter; everything else comes from grammars: the built-in ones
+// and any *.json in the "grammars" folder of the config directory. Compiled
+// grammars are kept in one cache file next to that folder, keyed by a hash
+// of their source, so a grammar is compiled again only when it changes.
+// Nothing is read before the first file asks for its language.
+class GrammarRegistry : public QObject
+{
+    Q_OBJECT
+public:
+    GrammarRegistry(const QString &configDirectory, QObject *parent = nullptr);
+
+    // "C++", the name of a grammar, or an empty string for plain text.
+    QString languageFor(const QString &fileName);
+    SyntaxHighlighter *createHighlighter(const QString &language, QPlainTextEdit *editor);
+    // Null for C++ and plain text. The grammar itself may be used from any
+    // thread; the registry may not.
+    QSharedPointer<const Grammar> grammar(const QString &language);
+
+    static const char *const CppLanguage;
+
+private:
+    static const quint32 Magic = 0x4E565347;
+    static const quint32 Version = 1;
+
+    void load();
+    QHash<QByteArray, Grammar> readCache() const;
+    bool writeCache(const QHash<QByteArray, Grammar> &cache) const;
+
+    QString directory;
+    bool loaded;
+    QHash<QString, QSharedPointer<const Grammar>> grammars;
+    QHash<QString, QString> languages;
+};
+
+#endif
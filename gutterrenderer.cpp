@@ -0,0 +1,89 @@
+#include "gutterrenderer.h"
+#include <QFontMetrics>
+#include <QPainter>
+#include <QPolygonF>
+
+static const int GutterPointSize = 10;
+
+GutterRenderer::GutterRenderer() : prepared(false), active(-1)
+{
+}
+
+void GutterRenderer::setStyle(const QFont &font, const QColor &normal, const QColor &current)
+{
+    if (prepared && font == baseFont && normal == colors[0] && current == colors[1]) return;
+
+    baseFont = font;
+    colors[0] = normal;
+    colors[1] = current;
+    prepared = false;
+}
+
+void GutterRenderer::prepare()
+{
+    fonts[0] = baseFont;
+    fonts[0].setPointSize(GutterPointSize);
+    fonts[1] = fonts[0];
+    fonts[1].setBold(true);
+
+    for (int weight = 0; weight < 2; ++weight) {
+        QFontMetrics metrics(fonts[weight]);
+        for (int digit = 0; digit < 10; ++digit) {
+            QChar character(QLatin1Char(char('0' + digit)));
+            digits[weight][digit].setText(QString(character));
+            digits[weight][digit].setTextFormat(Qt::PlainText);
+            digits[weight][digit].setPerformanceHint(QStaticText::AggressiveCaching);
+            digits[weight][digit].prepare(QTransform(), fonts[weight]);
+            advances[weight][digit] = metrics.horizontalAdvance(character);
+        }
+    }
+    prepared = true;
+}
+
+void GutterRenderer::begin(QPainter &painter)
+{
+    if (!prepared) prepare();
+    active = 0;
+    painter.setFont(fonts[0]);
+    painter.setPen(colors[0]);
+}
+
+void GutterRenderer::drawNumber(QPainter &painter, qint64 number, int right, int top, bool current)
+{
+    // QStaticText is laid out for the painter's font, so switch weights only
+    // when the line's state differs from the last one drawn.
+    int weight = current ? 1 : 0;
+    if (weight != active) {
+        active = weight;
+        painter.setFont(fonts[weight]);
+        painter.setPen(colors[weight]);
+    }
+
+    int x = right;
+    do {
+        int digit = int(number % 10);
+        x -= advances[weight][digit];
+        painter.drawStaticText(x, top, digits[weight][digit]);
+        number /= 10;
+    } while (number > 0);
+}
+
+void GutterRenderer::drawFoldMarker(QPainter &painter, const QRect &rect, bool folded)
+{
+    // Pointing right when folded and down when open.
+    qreal size = qMin(rect.width(), rect.height()) * 0.4;
+    QPointF center = QRectF(rect).center();
+    QPolygonF triangle;
+    if (folded) {
+        triangle << center + QPointF(-size / 2, -size) << center + QPointF(size / 2 + 1, 0) << center + QPointF(-size / 2, size);
+    } else {
+        triangle << center + QPointF(-size, -size / 2) << center + QPointF(size, -size / 2) << center + QPointF(0, size / 2 + 1);
+    }
+
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(colors[0]);
+    painter.drawPolygon(triangle);
+    painter.restore();
+}
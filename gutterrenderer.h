@@ -0,0 +1,37 @@
+#ifndef GUTTERRENDERER_H
+#define GUTTERRENDERER_H
+
+#include <QColor>
+#include <QFont>
+#include <QStaticText>
+
+class QPainter;
+class QRect;
+
+// Draws line numbers from ten pre-shaped digits per weight, so painting a
+// number costs no text layout and no allocation. The digits are shaped
+// again only when the font or colours change. Fold markers are drawn as
+// small triangles in the numbers' colour.
+class GutterRenderer
+{
+public:
+    GutterRenderer();
+
+    void setStyle(const QFont &font, const QColor &normal, const QColor &current);
+    void begin(QPainter &painter);
+    void drawNumber(QPainter &painter, qint64 number, int right, int top, bool current);
+    void drawFoldMarker(QPainter &painter, const QRect &rect, bool folded);
+
+private:
+    void prepare();
+
+    QFont baseFont;
+    QFont fonts[2];
+    QColor colors[2];
+    QStaticText digits[2][10];
+    int advances[2][10];
+    bool prepared;
+    int active;
+};
+
+#endif
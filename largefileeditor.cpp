@@ -0,0 +1,785 @@
+#include "largefileeditor.h"
+#include "performancehud.h"
+#include "tracer.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QFontInfo>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <algorithm>
+#include <climits>
+
+static const int TextMargin = 4;
+static const int TabColumns = 4;
+static const qint64 MaxWidth = INT_MAX / 2;
+
+static int utf8SequenceLength(uchar lead)
+{
+    if (lead >= 0xF0) return 4;
+    if (lead >= 0xE0) return 3;
+    if (lead >= 0xC0) return 2;
+    return 1;
+}
+
+// Display columns of a stretch of UTF-8: one per character, TabColumns
+// per tab.
+static qint64 columnsIn(const char *data, qint64 length)
+{
+    qint64 columns = 0;
+    for (qint64 i = 0; i < length; ++i) {
+        if (data[i] == '\t') columns += TabColumns;
+        else if ((uchar(data[i]) & 0xC0) != 0x80) ++columns;
+    }
+    return columns;
+}
+
+LargeFileGutter::LargeFileGutter(LargeFileEditor *editor) : QWidget(editor), largeFileEditor(editor)
+{
+}
+
+QSize LargeFileGutter::sizeHint() const
+{
+    return QSize(largeFileEditor->gutterWidth(), 0);
+}
+
+void LargeFileGutter::paintEvent(QPaintEvent *event)
+{
+    largeFileEditor->gutterPaintEvent(event);
+}
+
+LargeFileEditor::LargeFileEditor(QWidget *parent)
+    : QAbstractScrollArea(parent), table(new PieceTable), indexer(nullptr), decodedPages(64), columnCheckpoints(16),
+      cursorPos(0), anchorPos(0), preferredX(-1), maxLineWidth(0), charWidth(1), fixedPitch(false), modified(false),
+      isDarkTheme(true)
+{
+    gutter = new LargeFileGutter(this);
+
+    QFont font("Monospace");
+    font.setStyleHint(QFont::TypeWriter);
+    font.setPointSize(12);
+    this->setFont(font);
+    updateCharWidth();
+
+    this->setFocusPolicy(Qt::StrongFocus);
+    this->viewport()->setCursor(Qt::IBeamCursor);
+
+    updateGutterGeometry();
+    updateScrollBars();
+}
+
+LargeFileEditor::~LargeFileEditor()
+{
+    delete indexer;
+    delete table;
+}
+
+bool LargeFileEditor::loadFile(const QString &fileName, QString *errorString)
+{
+    delete indexer;
+    indexer = nullptr;
+
+    if (table->map(fileName)) {
+        indexer = new LineIndexer(table->originalData(), table->originalSize(), this);
+        connect(indexer, &LineIndexer::progress, this, &LargeFileEditor::onIndexProgress);
+        connect(indexer, &LineIndexer::finished, this, &LargeFileEditor::onIndexFinished);
+        indexer->start();
+    } else if (!table->load(fileName, errorString)) {
+        return false;
+    }
+
+    clearCaches();
+    path = fileName;
+    cursorPos = 0;
+    anchorPos = 0;
+    preferredX = -1;
+    maxLineWidth = 0;
+    setModified(false);
+
+    updateGutterGeometry();
+    updateScrollBars();
+    this->viewport()->update();
+    return true;
+}
+
+bool LargeFileEditor::writeTo(QIODevice *device) const
+{
+    return table->writeTo(device);
+}
+
+void LargeFileEditor::setModified(bool value)
+{
+    if (!value) table->markClean();
+    if (modified == value) return;
+    modified = value;
+    emit modificationChanged(modified);
+}
+
+void LargeFileEditor::setIsDarkTheme(bool dark)
+{
+    isDarkTheme = dark;
+    this->viewport()->update();
+    gutter->update();
+}
+
+void LargeFileEditor::setCursorPosition(qint64 pos, bool keepAnchor)
+{
+    qint64 oldLine = table->lineAt(cursorPos);
+    cursorPos = qBound<qint64>(0, pos, table->size());
+    if (!keepAnchor) anchorPos = cursorPos;
+    preferredX = -1;
+
+    // Scrolling repaints the whole gutter; otherwise only the two lines
+    // whose highlight changed need it.
+    ensureCursorVisible();
+    this->viewport()->update();
+    qint64 newLine = table->lineAt(cursorPos);
+    if (newLine != oldLine) {
+        updateGutterLine(oldLine);
+        updateGutterLine(newLine);
+    }
+    emit cursorPositionChanged();
+}
+
+qint64 LargeFileEditor::cursorColumn() const
+{
+    // Columns count characters, so UTF-8 continuation bytes are skipped;
+    // on absurdly long lines the byte offset is close enough.
+    qint64 start = table->lineStart(cursorLine());
+    qint64 length = cursorPos - start;
+    if (length > MaxColumnScan) return length;
+    QByteArray bytes = table->text(start, length);
+    qint64 column = 0;
+    for (char c : bytes) {
+        if ((uchar(c) & 0xC0) != 0x80) ++column;
+    }
+    return column;
+}
+
+void LargeFileEditor::goToLine(qint64 line)
+{
+    line = qBound<qint64>(0, line, table->lineCount() - 1);
+    setCursorPosition(table->lineStart(line));
+    qint64 top = qMax<qint64>(0, line - visibleLineCount() / 2);
+    this->verticalScrollBar()->setValue(int(qMin<qint64>(top, INT_MAX)));
+}
+
+QByteArray LargeFileEditor::selectedBytes() const
+{
+    qint64 from = qMin(anchorPos, cursorPos);
+    return table->text(from, qAbs(cursorPos - anchorPos));
+}
+
+int LargeFileEditor::gutterWidth() const
+{
+    int digits = 1;
+    qint64 max = qMax<qint64>(1, table->lineCount());
+    while (max >= 10) {
+        max /= 10;
+        ++digits;
+    }
+
+    return 15 + this->fontMetrics().horizontalAdvance(QLatin1Char('9')) * digits;
+}
+
+void LargeFileEditor::gutterPaintEvent(QPaintEvent *event)
+{
+    QPainter painter(gutter);
+    painter.fillRect(event->rect(), isDarkTheme ? QColor(0x1e, 0x1e, 0x1e) : QColor(0xf3, 0xf3, 0xf3));
+
+    if (isDarkTheme) {
+        gutterRenderer.setStyle(this->font(), QColor(0x85, 0x85, 0x85), QColor(0x56, 0x9c, 0xd6));
+    } else {
+        gutterRenderer.setStyle(this->font(), QColor(0x96, 0x96, 0x96), QColor(0x00, 0x7a, 0xcc));
+    }
+    gutterRenderer.begin(painter);
+
+    int height = lineHeight();
+    qint64 top = firstVisibleLine();
+    qint64 first = top + event->rect().top() / height;
+    qint64 last = qMin(table->lineCount() - 1, top + event->rect().bottom() / height);
+    qint64 cursorLine = table->lineAt(cursorPos);
+    int right = gutter->width() - 5;
+
+    for (qint64 line = first; line <= last; ++line) {
+        gutterRenderer.drawNumber(painter, line + 1, right, int(line - top) * height, line == cursorLine);
+    }
+}
+
+void LargeFileEditor::updateGutterLine(qint64 line)
+{
+    qint64 row = line - firstVisibleLine();
+    if (row < 0 || row > visibleLineCount()) return;
+    gutter->update(0, int(row) * lineHeight(), gutter->width(), lineHeight());
+}
+
+void LargeFileEditor::onIndexProgress()
+{
+    // A reload replaces the indexer; signals the old one queued are stale.
+    if (!indexer || sender() != indexer) return;
+    table->appendIndexedChunks(indexer->takeChunks());
+    clearCaches();
+
+    updateGutterGeometry();
+    updateScrollBars();
+    this->viewport()->update();
+    gutter->update();
+
+    qint64 total = qMax<qint64>(1, table->originalSize());
+    emit indexingProgress(int(table->indexedSize() * 100 / total));
+}
+
+void LargeFileEditor::onIndexFinished()
+{
+    if (!indexer || sender() != indexer) return;
+    onIndexProgress();
+    table->finishIndexing();
+    indexer->deleteLater();
+    indexer = nullptr;
+    clearCaches();
+
+    updateGutterGeometry();
+    updateScrollBars();
+    this->viewport()->update();
+    gutter->update();
+    emit indexingFinished();
+}
+
+QString LargeFileEditor::displayLine(qint64 line)
+{
+    qint64 page = line / PageLines;
+    QVector<QString> *lines = decodedPages.object(page);
+    if (!lines) {
+        qint64 first = page * PageLines;
+        qint64 last = qMin(table->lineCount() - 1, first + PageLines - 1);
+
+        // With a fixed-pitch font long lines are painted a slice at a time
+        // and never decoded whole.
+        lines = new QVector<QString>;
+        lines->reserve(int(last - first + 1));
+        for (qint64 i = first; i <= last; ++i) {
+            qint64 start = table->lineStart(i);
+            qint64 end = lineContentEnd(i);
+            if (fixedPitch && end - start > LongLineBytes) {
+                lines->append(QString());
+            } else {
+                lines->append(displayText(table->text(start, end - start)));
+            }
+        }
+        decodedPages.insert(page, lines);
+    }
+    return lines->value(int(line - page * PageLines));
+}
+
+void LargeFileEditor::paintEvent(QPaintEvent *event)
+{
+    TRACE_SCOPE(PerformanceHud::FrameSpan);
+    QPainter painter(this->viewport());
+    painter.fillRect(event->rect(), isDarkTheme ? QColor("#1e1e1e") : QColor("white"));
+
+    const QFontMetrics metrics = this->fontMetrics();
+    int height = lineHeight();
+    int viewportWidth = this->viewport()->width();
+    int xOffset = TextMargin - this->horizontalScrollBar()->value();
+    qint64 firstColumn = this->horizontalScrollBar()->value() / charWidth;
+    qint64 visibleColumns = viewportWidth / charWidth + 2;
+    qint64 first = firstVisibleLine();
+    qint64 last = qMin(table->lineCount() - 1, first + visibleLineCount());
+    qint64 cursorLine = table->lineAt(cursorPos);
+    qint64 selectionStart = qMin(anchorPos, cursorPos);
+    qint64 selectionEnd = qMax(anchorPos, cursorPos);
+    QColor textColor = isDarkTheme ? QColor("#f8f8f2") : QColor("black");
+    QColor selectionColor = isDarkTheme ? QColor(42, 130, 218) : this->palette().highlight().color();
+
+    for (qint64 line = first; line <= last; ++line) {
+        int top = int(line - first) * height;
+        qint64 start = table->lineStart(line);
+        qint64 end = lineContentEnd(line);
+
+        if (line == cursorLine && !hasSelection()) {
+            painter.fillRect(QRect(0, top, viewportWidth, height),
+                             isDarkTheme ? QColor("#2d2d30") : QColor("#f6f6f6"));
+        }
+
+        if (hasSelection() && selectionStart <= end && selectionEnd >= start) {
+            qint64 from = qMax(selectionStart, start);
+            qint64 to = qMin(selectionEnd, end);
+            qint64 left = 0;
+            qint64 right = 0;
+            if (fixedPitch) {
+                left = columnAt(from) * charWidth;
+                right = columnAt(to) * charWidth;
+            } else {
+                QByteArray bytes = table->text(start, end - start);
+                left = metrics.horizontalAdvance(displayText(bytes.left(int(from - start))));
+                right = metrics.horizontalAdvance(displayText(bytes.left(int(to - start))));
+            }
+            if (selectionEnd > end) right += metrics.horizontalAdvance(QLatin1Char(' '));
+            left = qBound<qint64>(-1, xOffset + left, viewportWidth + 1);
+            right = qBound<qint64>(-1, xOffset + right, viewportWidth + 1);
+            painter.fillRect(QRect(int(left), top, int(right - left), height), selectionColor);
+        }
+
+        painter.setPen(textColor);
+        qint64 width = 0;
+        if (fixedPitch && end - start > LongLineBytes) {
+            qint64 from = positionAtColumn(line, firstColumn);
+            qint64 to = positionAtColumn(line, firstColumn + visibleColumns);
+            int x = int(xOffset + columnAt(from) * charWidth);
+            painter.drawText(x, top + metrics.ascent(), displayText(table->text(from, to - from)));
+            width = columnAt(end) * charWidth;
+        } else {
+            QString text = displayLine(line);
+            painter.drawText(xOffset, top + metrics.ascent(), text);
+            width = metrics.horizontalAdvance(text);
+        }
+
+        width = qMin(width, MaxWidth);
+        if (width > maxLineWidth) {
+            maxLineWidth = int(width);
+            updateScrollBars();
+        }
+    }
+
+    if (this->hasFocus()) {
+        int top = int(cursorLine - first) * height;
+        painter.fillRect(QRect(xOffset + xForPosition(cursorPos), top, 2, height), textColor);
+    }
+}
+
+void LargeFileEditor::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateGutterGeometry();
+    updateScrollBars();
+}
+
+void LargeFileEditor::keyPressEvent(QKeyEvent *event)
+{
+    bool shift = event->modifiers().testFlag(Qt::ShiftModifier);
+    bool control = event->modifiers().testFlag(Qt::ControlModifier);
+
+    if (event->matches(QKeySequence::Copy)) {
+        copy();
+        return;
+    }
+    if (event->matches(QKeySequence::Cut)) {
+        if (isEditable() && copy()) removeSelection();
+        return;
+    }
+    if (event->matches(QKeySequence::Undo)) {
+        undo();
+        return;
+    }
+    if (event->matches(QKeySequence::Redo)) {
+        redo();
+        return;
+    }
+    if (event->matches(QKeySequence::Paste)) {
+        paste();
+        return;
+    }
+    if (event->matches(QKeySequence::SelectAll)) {
+        anchorPos = 0;
+        setCursorPosition(table->size(), true);
+        return;
+    }
+
+    qint64 line = table->lineAt(cursorPos);
+    switch (event->key()) {
+    case Qt::Key_Left:
+        if (hasSelection() && !shift) {
+            setCursorPosition(qMin(anchorPos, cursorPos));
+        } else {
+            setCursorPosition(previousCharacter(cursorPos), shift);
+        }
+        return;
+    case Qt::Key_Right:
+        if (hasSelection() && !shift) {
+            setCursorPosition(qMax(anchorPos, cursorPos));
+        } else {
+            setCursorPosition(nextCharacter(cursorPos), shift);
+        }
+        return;
+    case Qt::Key_Up:
+        moveVertically(-1, shift);
+        return;
+    case Qt::Key_Down:
+        moveVertically(1, shift);
+        return;
+    case Qt::Key_PageUp:
+        moveVertically(-visibleLineCount(), shift);
+        return;
+    case Qt::Key_PageDown:
+        moveVertically(visibleLineCount(), shift);
+        return;
+    case Qt::Key_Home:
+        setCursorPosition(control ? 0 : table->lineStart(line), shift);
+        return;
+    case Qt::Key_End:
+        setCursorPosition(control ? table->size() : lineContentEnd(line), shift);
+        return;
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        insertBytes("\n");
+        return;
+    case Qt::Key_Tab:
+        insertBytes("\t");
+        return;
+    case Qt::Key_Backspace:
+        if (!removeSelection()) removeRange(previousCharacter(cursorPos), cursorPos);
+        return;
+    case Qt::Key_Delete:
+        if (!removeSelection()) removeRange(cursorPos, nextCharacter(cursorPos));
+        return;
+    default:
+        break;
+    }
+
+    QString text = event->text();
+    if (!text.isEmpty() && !control && text.at(0).isPrint()) {
+        insertBytes(text.toUtf8());
+        return;
+    }
+
+    QAbstractScrollArea::keyPressEvent(event);
+}
+
+void LargeFileEditor::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton) return;
+    this->setFocus();
+    table->sealUndoStep();
+    setCursorPosition(positionAt(event->pos()), event->modifiers().testFlag(Qt::ShiftModifier));
+}
+
+void LargeFileEditor::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton) {
+        setCursorPosition(positionAt(event->pos()), true);
+    }
+}
+
+void LargeFileEditor::changeEvent(QEvent *event)
+{
+    QAbstractScrollArea::changeEvent(event);
+    if (event->type() == QEvent::FontChange) {
+        updateCharWidth();
+        clearCaches();
+        maxLineWidth = 0;
+        updateGutterGeometry();
+        updateScrollBars();
+        this->viewport()->update();
+    }
+}
+
+void LargeFileEditor::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+    this->viewport()->update();
+    gutter->update();
+}
+
+int LargeFileEditor::lineHeight() const
+{
+    return qMax(1, this->fontMetrics().height());
+}
+
+int LargeFileEditor::visibleLineCount() const
+{
+    return qMax(1, this->viewport()->height() / lineHeight());
+}
+
+qint64 LargeFileEditor::firstVisibleLine() const
+{
+    return this->verticalScrollBar()->value();
+}
+
+QString LargeFileEditor::displayText(const QByteArray &bytes) const
+{
+    QString text = QString::fromUtf8(bytes);
+    text.replace(QLatin1Char('\t'), QString(TabColumns, QLatin1Char(' ')));
+    return text;
+}
+
+void LargeFileEditor::clearCaches()
+{
+    decodedPages.clear();
+    columnCheckpoints.clear();
+}
+
+void LargeFileEditor::updateCharWidth()
+{
+    fixedPitch = QFontInfo(this->font()).fixedPitch();
+    charWidth = qMax(1, this->fontMetrics().horizontalAdvance(QLatin1Char('M')));
+}
+
+const QVector<qint64> &LargeFileEditor::checkpoints(qint64 line) const
+{
+    // The column at every CheckpointBytes of a line, so mapping between
+    // offsets and columns scans one stretch at most. Built once per line
+    // and dropped on edits.
+    QVector<qint64> *columns = columnCheckpoints.object(line);
+    if (columns) return *columns;
+
+    qint64 start = table->lineStart(line);
+    qint64 end = lineContentEnd(line);
+    columns = new QVector<qint64>;
+    columns->reserve(int((end - start) / CheckpointBytes + 1));
+    qint64 column = 0;
+    const qint64 readBytes = 256 * CheckpointBytes;
+    for (qint64 from = start; from < end; from += readBytes) {
+        QByteArray bytes = table->text(from, qMin(readBytes, end - from));
+        for (qint64 offset = 0; offset < bytes.size(); offset += CheckpointBytes) {
+            columns->append(column);
+            column += columnsIn(bytes.constData() + offset, qMin<qint64>(CheckpointBytes, bytes.size() - offset));
+        }
+    }
+    if (columns->isEmpty()) columns->append(0);
+    columnCheckpoints.insert(line, columns);
+    return *columns;
+}
+
+qint64 LargeFileEditor::columnAt(qint64 pos) const
+{
+    qint64 line = table->lineAt(pos);
+    qint64 start = table->lineStart(line);
+    qint64 from = start;
+    qint64 column = 0;
+    if (pos - start > CheckpointBytes) {
+        const QVector<qint64> &columns = checkpoints(line);
+        qint64 index = qMin<qint64>((pos - start) / CheckpointBytes, columns.size() - 1);
+        column = columns.at(int(index));
+        from = start + index * CheckpointBytes;
+    }
+    QByteArray bytes = table->text(from, pos - from);
+    return column + columnsIn(bytes.constData(), bytes.size());
+}
+
+qint64 LargeFileEditor::positionAtColumn(qint64 line, qint64 column) const
+{
+    qint64 start = table->lineStart(line);
+    qint64 end = lineContentEnd(line);
+    qint64 from = start;
+    qint64 current = 0;
+    if (end - start > CheckpointBytes) {
+        const QVector<qint64> &columns = checkpoints(line);
+        int index = int(std::upper_bound(columns.constBegin(), columns.constEnd(), column) - columns.constBegin());
+        index = qMax(0, index - 1);
+        current = columns.at(index);
+        from = start + qint64(index) * CheckpointBytes;
+    }
+
+    // The column lies within this stretch; a character straddling its end
+    // needs up to three more bytes.
+    QByteArray bytes = table->text(from, qMin(end - from, CheckpointBytes + 3));
+    int i = 0;
+    while (i < bytes.size() && (uchar(bytes.at(i)) & 0xC0) == 0x80) ++i;
+    while (i < bytes.size() && current < column) {
+        uchar c = uchar(bytes.at(i));
+        current += c == '\t' ? TabColumns : 1;
+        i += utf8SequenceLength(c);
+    }
+    return qMin(end, from + i);
+}
+
+int LargeFileEditor::xForPosition(qint64 pos) const
+{
+    if (fixedPitch) return int(qMin(columnAt(pos) * charWidth, MaxWidth));
+
+    qint64 start = table->lineStart(table->lineAt(pos));
+    return this->fontMetrics().horizontalAdvance(displayText(table->text(start, pos - start)));
+}
+
+qint64 LargeFileEditor::positionForX(qint64 line, int x) const
+{
+    if (fixedPitch) return positionAtColumn(line, (qMax(0, x) + charWidth / 2) / charWidth);
+
+    const QFontMetrics metrics = this->fontMetrics();
+    qint64 start = table->lineStart(line);
+    QByteArray bytes = table->text(start, lineContentEnd(line) - start);
+
+    int advance = 0;
+    int i = 0;
+    while (i < bytes.size()) {
+        int length = qMin(utf8SequenceLength(uchar(bytes.at(i))), int(bytes.size()) - i);
+        int width = metrics.horizontalAdvance(displayText(bytes.mid(i, length)));
+        if (advance + width / 2 > x) break;
+        advance += width;
+        i += length;
+    }
+    return start + i;
+}
+
+qint64 LargeFileEditor::positionAt(const QPoint &point) const
+{
+    qint64 line = firstVisibleLine() + qMax(0, point.y()) / lineHeight();
+    line = qMin(line, table->lineCount() - 1);
+    return positionForX(line, point.x() - TextMargin + this->horizontalScrollBar()->value());
+}
+
+qint64 LargeFileEditor::lineContentEnd(qint64 line) const
+{
+    qint64 start = table->lineStart(line);
+    qint64 end = table->lineEnd(line);
+    if (end > start && table->text(end - 1, 1) == "\r") --end;
+    return end;
+}
+
+qint64 LargeFileEditor::previousCharacter(qint64 pos) const
+{
+    if (pos <= 0) return 0;
+
+    qint64 from = qMax<qint64>(0, pos - 4);
+    QByteArray bytes = table->text(from, pos - from);
+    int i = int(bytes.size()) - 1;
+    if (bytes.at(i) == '\n' && i > 0 && bytes.at(i - 1) == '\r') return pos - 2;
+    while (i > 0 && (uchar(bytes.at(i)) & 0xC0) == 0x80) --i;
+    return from + i;
+}
+
+qint64 LargeFileEditor::nextCharacter(qint64 pos) const
+{
+    QByteArray bytes = table->text(pos, 4);
+    if (bytes.isEmpty()) return pos;
+    if (bytes.startsWith("\r\n")) return pos + 2;
+    return pos + qMin(utf8SequenceLength(uchar(bytes.at(0))), int(bytes.size()));
+}
+
+void LargeFileEditor::moveVertically(qint64 lines, bool keepAnchor)
+{
+    int x = preferredX >= 0 ? preferredX : xForPosition(cursorPos);
+    qint64 target = qBound<qint64>(0, table->lineAt(cursorPos) + lines, table->lineCount() - 1);
+    setCursorPosition(positionForX(target, x), keepAnchor);
+    preferredX = x;
+}
+
+bool LargeFileEditor::isEditable()
+{
+    if (!table->isIndexing()) return true;
+    emit statusMessage("Still indexing; the file can be edited once indexing is done");
+    return false;
+}
+
+void LargeFileEditor::insertBytes(const QByteArray &bytes)
+{
+    if (!isEditable()) return;
+    if (sinceEdit.isValid() && sinceEdit.elapsed() > MergeMsecs) table->sealUndoStep();
+    removeSelection();
+    table->insert(cursorPos, bytes);
+    sinceEdit.start();
+    afterEdit(cursorPos + bytes.size());
+}
+
+bool LargeFileEditor::removeSelection()
+{
+    if (!hasSelection()) return false;
+    removeRange(qMin(anchorPos, cursorPos), qMax(anchorPos, cursorPos));
+    return true;
+}
+
+void LargeFileEditor::removeRange(qint64 from, qint64 to)
+{
+    if (to <= from || !isEditable()) return;
+    if (sinceEdit.isValid() && sinceEdit.elapsed() > MergeMsecs) table->sealUndoStep();
+    table->remove(from, to - from);
+    sinceEdit.start();
+    afterEdit(from);
+}
+
+void LargeFileEditor::undo()
+{
+    qint64 pos = 0;
+    if (!isEditable() || !table->undo(&pos)) return;
+    afterEdit(pos);
+}
+
+void LargeFileEditor::redo()
+{
+    qint64 pos = 0;
+    if (!isEditable() || !table->redo(&pos)) return;
+    afterEdit(pos);
+}
+
+void LargeFileEditor::afterEdit(qint64 pos)
+{
+    clearCaches();
+    setModified(!table->isClean());
+    updateGutterGeometry();
+    updateScrollBars();
+    gutter->update();
+    setCursorPosition(pos);
+}
+
+bool LargeFileEditor::copy()
+{
+    if (!hasSelection()) return false;
+    if (qAbs(cursorPos - anchorPos) > MaxCopyBytes) {
+        emit statusMessage(QString("Selection too large to copy (over %1 MB)").arg(MaxCopyBytes / (1024 * 1024)));
+        return false;
+    }
+    QApplication::clipboard()->setText(QString::fromUtf8(selectedBytes()));
+    return true;
+}
+
+void LargeFileEditor::paste()
+{
+    // A paste is an undo step of its own.
+    QString text = QApplication::clipboard()->text();
+    if (text.isEmpty()) return;
+    table->sealUndoStep();
+    insertBytes(text.toUtf8());
+    table->sealUndoStep();
+}
+
+void LargeFileEditor::ensureCursorVisible()
+{
+    updateScrollBars();
+
+    qint64 line = table->lineAt(cursorPos);
+    qint64 first = firstVisibleLine();
+    int visible = visibleLineCount();
+    QScrollBar *vertical = this->verticalScrollBar();
+    if (line < first) {
+        vertical->setValue(int(qMin<qint64>(line, INT_MAX)));
+    } else if (line >= first + visible) {
+        vertical->setValue(int(qMin<qint64>(line - visible + 1, INT_MAX)));
+    }
+
+    int x = xForPosition(cursorPos);
+    int width = this->viewport()->width() - 2 * TextMargin;
+    QScrollBar *horizontal = this->horizontalScrollBar();
+    if (x > maxLineWidth) {
+        maxLineWidth = x;
+        updateScrollBars();
+    }
+    if (x < horizontal->value()) {
+        horizontal->setValue(x);
+    } else if (x > horizontal->value() + width) {
+        horizontal->setValue(x - width);
+    }
+}
+
+void LargeFileEditor::updateScrollBars()
+{
+    int visible = visibleLineCount();
+    qint64 maximum = qMax<qint64>(0, table->lineCount() - visible);
+    this->verticalScrollBar()->setRange(0, int(qMin<qint64>(maximum, INT_MAX)));
+    this->verticalScrollBar()->setPageStep(visible);
+    this->verticalScrollBar()->setSingleStep(1);
+
+    int width = this->viewport()->width();
+    this->horizontalScrollBar()->setRange(0, qMax(0, maxLineWidth + 2 * TextMargin - width));
+    this->horizontalScrollBar()->setPageStep(width);
+    this->horizontalScrollBar()->setSingleStep(this->fontMetrics().horizontalAdvance(QLatin1Char(' ')));
+}
+
+void LargeFileEditor::updateGutterGeometry()
+{
+    int width = gutterWidth();
+    this->setViewportMargins(width, 0, 0, 0);
+    QRect cr = this->contentsRect();
+    gutter->setGeometry(QRect(cr.left(), cr.top(), width, cr.height()));
+}
@@ -0,0 +1,140 @@
+#ifndef LARGEFILEEDITOR_H
+#define LARGEFILEEDITOR_H
+
+#include "gutterrenderer.h"
+#include "piecetable.h"
+#include <QAbstractScrollArea>
+#include <QCache>
+#include <QElapsedTimer>
+#include <QWidget>
+
+class LargeFileEditor;
+
+class LargeFileGutter : public QWidget
+{
+public:
+    LargeFileGutter(LargeFileEditor *editor);
+    QSize sizeHint() const override;
+protected:
+    void paintEvent(QPaintEvent *event) override;
+private:
+    LargeFileEditor *largeFileEditor;
+};
+
+// Editor view for files too big for QTextDocument, or with lines too long
+// for it. Text lives in a PieceTable over a memory-mapped file and only the
+// lines inside the viewport are decoded and painted; line offsets are
+// indexed in the background. With a fixed-pitch font, x positions are
+// columns times the character width, and of a long line only the columns
+// inside the viewport are read and drawn. The text is read-only until
+// indexing finishes; undo steps are kept as pieces by the table.
+class LargeFileEditor : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    LargeFileEditor(QWidget *parent = nullptr);
+    ~LargeFileEditor();
+
+    bool loadFile(const QString &fileName, QString *errorString = nullptr);
+    bool writeTo(QIODevice *device) const;
+    PieceTable *buffer() const { return table; }
+    bool isIndexing() const { return table->isIndexing(); }
+
+    QString filePath() const { return path; }
+    void setFilePath(const QString &fileName) { path = fileName; }
+    bool isModified() const { return modified; }
+    void setModified(bool value);
+    bool getIsDarkTheme() const { return isDarkTheme; }
+    void setIsDarkTheme(bool dark);
+
+    qint64 cursorPosition() const { return cursorPos; }
+    void setCursorPosition(qint64 pos, bool keepAnchor = false);
+    qint64 cursorLine() const { return table->lineAt(cursorPos); }
+    qint64 cursorColumn() const;
+    void goToLine(qint64 line);
+    bool hasSelection() const { return anchorPos != cursorPos; }
+    QByteArray selectedBytes() const;
+
+    int gutterWidth() const;
+    void gutterPaintEvent(QPaintEvent *event);
+
+signals:
+    void modificationChanged(bool changed);
+    void cursorPositionChanged();
+    void indexingProgress(int percent);
+    void indexingFinished();
+    void statusMessage(const QString &message);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void changeEvent(QEvent *event) override;
+
+private slots:
+    void onIndexProgress();
+    void onIndexFinished();
+
+private:
+    static const int PageLines = 256;
+    static const qint64 MaxColumnScan = 1024 * 1024;
+    static const qint64 LongLineBytes = 4096;
+    static const qint64 CheckpointBytes = 4096;
+    // The clipboard takes a QByteArray and a QString of the selection.
+    static const qint64 MaxCopyBytes = 256 * 1024 * 1024;
+    // Edits closer together than this share an undo step.
+    static const int MergeMsecs = 1000;
+
+    QString displayLine(qint64 line);
+    int lineHeight() const;
+    int visibleLineCount() const;
+    qint64 firstVisibleLine() const;
+    QString displayText(const QByteArray &bytes) const;
+    void clearCaches();
+    void updateCharWidth();
+    qint64 columnAt(qint64 pos) const;
+    qint64 positionAtColumn(qint64 line, qint64 column) const;
+    const QVector<qint64> &checkpoints(qint64 line) const;
+    int xForPosition(qint64 pos) const;
+    qint64 positionForX(qint64 line, int x) const;
+    qint64 positionAt(const QPoint &point) const;
+    qint64 lineContentEnd(qint64 line) const;
+    qint64 previousCharacter(qint64 pos) const;
+    qint64 nextCharacter(qint64 pos) const;
+    void moveVertically(qint64 lines, bool keepAnchor);
+    bool isEditable();
+    void insertBytes(const QByteArray &bytes);
+    bool removeSelection();
+    void removeRange(qint64 from, qint64 to);
+    bool copy();
+    void paste();
+    void undo();
+    void redo();
+    void afterEdit(qint64 pos);
+    void ensureCursorVisible();
+    void updateScrollBars();
+    void updateGutterGeometry();
+    void updateGutterLine(qint64 line);
+
+    PieceTable *table;
+    LineIndexer *indexer;
+    QCache<qint64, QVector<QString>> decodedPages;
+    mutable QCache<qint64, QVector<qint64>> columnCheckpoints;
+    LargeFileGutter *gutter;
+    GutterRenderer gutterRenderer;
+    QElapsedTimer sinceEdit;
+    QString path;
+    qint64 cursorPos;
+    qint64 anchorPos;
+    int preferredX;
+    int maxLineWidth;
+    int charWidth;
+    bool fixedPitch;
+    bool modified;
+    bool isDarkTheme;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "linediff.h"
+#include <algorithm>
+#include <cstring>
+
+QVector<LineDiff::Line> LineDiff::split(const QString &text)
+{
+    // Each line keeps its '\n', so the lines add up to the whole text.
+    QVector<Line> lines;
+    const QChar *data = text.constData();
+    int size = int(text.size());
+    int start = 0;
+    while (start < size) {
+        uint hash = 2166136261u;
+        int end = start;
+        while (end < size) {
+            ushort c = data[end++].unicode();
+            hash = (hash ^ c) * 16777619u;
+            if (c == '\n') break;
+        }
+        lines.append(Line{start, end - start, hash});
+        start = end;
+    }
+    return lines;
+}
+
+bool LineDiff::equal(const QString &before, const Line &a, const QString &after, const Line &b)
+{
+    return a.hash == b.hash && a.length == b.length
+        && memcmp(before.constData() + a.start, after.constData() + b.start, a.length * sizeof(QChar)) == 0;
+}
+
+QVector<LineDiff::Hunk> LineDiff::compute(const QString &before, const QString &after)
+{
+    QVector<Hunk> hunks;
+    if (before == after) return hunks;
+
+    const QVector<Line> a = split(before);
+    const QVector<Line> b = split(after);
+    auto same = [&](int i, int j) { return equal(before, a.at(i), after, b.at(j)); };
+
+    int prefix = 0;
+    while (prefix < a.size() && prefix < b.size() && same(prefix, prefix)) {
+        ++prefix;
+    }
+    int suffix = 0;
+    while (suffix < a.size() - prefix && suffix < b.size() - prefix
+           && same(int(a.size()) - 1 - suffix, int(b.size()) - 1 - suffix)) {
+        ++suffix;
+    }
+    int n = int(a.size()) - prefix - suffix;
+    int m = int(b.size()) - prefix - suffix;
+
+    auto oldOffset = [&](int line) { return line < a.size() ? a.at(line).start : int(before.size()); };
+    auto newOffset = [&](int line) { return line < b.size() ? b.at(line).start : int(after.size()); };
+    auto addHunk = [&](int oldFirst, int oldLast, int newFirst, int newLast) {
+        int position = oldOffset(prefix + oldFirst);
+        int from = newOffset(prefix + newFirst);
+        hunks.append(Hunk{position, oldOffset(prefix + oldLast) - position,
+                          after.mid(from, newOffset(prefix + newLast) - from)});
+    };
+
+    // Forward Myers search over the trimmed middle. trace[d] holds the
+    // furthest x of every diagonal k in [-d, d] before step d.
+    int distance = -1;
+    int limit = qMin(n + m, MaxDistance);
+    QVector<int> v(2 * limit + 3, 0);
+    int offset = limit + 1;
+    QVector<QVector<int>> trace;
+    for (int d = 0; d <= limit && distance < 0; ++d) {
+        trace.append(QVector<int>(v.constBegin() + offset - d, v.constBegin() + offset + d + 1));
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? v[offset + k + 1] : v[offset + k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && same(prefix + x, prefix + y)) {
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+            if (x >= n && y >= m) {
+                distance = d;
+                break;
+            }
+        }
+    }
+    if (distance < 0) {
+        addHunk(0, n, 0, m);
+        return hunks;
+    }
+
+    // Walk back from the end collecting the matched lines.
+    QVector<QPair<int, int>> matches;
+    int x = n;
+    int y = m;
+    for (int d = distance; d > 0; --d) {
+        const QVector<int> &previous = trace.at(d);
+        int k = x - y;
+        bool down = k == -d || (k != d && previous.at(k - 1 + d) < previous.at(k + 1 + d));
+        int previousK = down ? k + 1 : k - 1;
+        int previousX = previous.at(previousK + d);
+        int snakeStart = down ? previousX : previousX + 1;
+        while (x > snakeStart) {
+            --x;
+            --y;
+            matches.append(qMakePair(x, y));
+        }
+        x = previousX;
+        y = previousX - previousK;
+    }
+    while (x > 0 && y > 0) {
+        --x;
+        --y;
+        matches.append(qMakePair(x, y));
+    }
+    std::reverse(matches.begin(), matches.end());
+
+    int oldLine = 0;
+    int newLine = 0;
+    for (const QPair<int, int> &match : matches) {
+        if (match.first > oldLine || match.second > newLine) {
+            addHunk(oldLine, match.first, newLine, match.second);
+        }
+        oldLine = match.first + 1;
+        newLine = match.second + 1;
+    }
+    if (oldLine < n || newLine < m) {
+        addHunk(oldLine, n, newLine, m);
+    }
+    return hunks;
+}
@@ -0,0 +1,39 @@
+#ifndef LINEDIFF_H
+#define LINEDIFF_H
+
+#include <QString>
+#include <QVector>
+
+// Line-based diff of two texts with Myers' algorithm. Common leading and
+// trailing lines are trimmed first, so a file that only grew at the end
+// costs one pass over its lines. The result is a list of replacements in
+// the old text's character offsets, in ascending order.
+class LineDiff
+{
+public:
+    struct Hunk
+    {
+        int position;
+        int removed;
+        QString inserted;
+    };
+
+    static QVector<Hunk> compute(const QString &before, const QString &after);
+
+private:
+    // Past this many differing lines the changed middle is replaced as one
+    // hunk; the trace the algorithm keeps grows with its square.
+    static const int MaxDistance = 1024;
+
+    struct Line
+    {
+        int start;
+        int length;
+        uint hash;
+    };
+
+    static QVector<Line> split(const QString &text);
+    static bool equal(const QString &before, const Line &a, const QString &after, const Line &b);
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "lineindex.h"
+#include "newlinescanner.h"
+#include <QtConcurrent>
+#include <algorithm>
+
+LineIndex::LineIndex() : indexedSize(0), totalLineFeeds(0)
+{
+    checkpoints.append(0);
+}
+
+void LineIndex::clear()
+{
+    checkpoints.clear();
+    checkpoints.append(0);
+    indexedSize = 0;
+    totalLineFeeds = 0;
+}
+
+void LineIndex::build(const char *data, qint64 size)
+{
+    clear();
+    checkpoints.reserve(int(size / ChunkSize) + 1);
+    extend(data, size);
+}
+
+void LineIndex::extend(const char *data, qint64 newSize)
+{
+    qint64 pos = indexedSize;
+    qint64 count = totalLineFeeds;
+    while (pos < newSize) {
+        qint64 boundary = (pos / ChunkSize + 1) * ChunkSize;
+        qint64 end = qMin(boundary, newSize);
+        count += scanLineFeeds(data + pos, end - pos);
+        pos = end;
+        if (pos == boundary) {
+            checkpoints.append(count);
+        }
+    }
+    indexedSize = qMax(indexedSize, newSize);
+    totalLineFeeds = count;
+}
+
+void LineIndex::appendChunks(const QVector<qint64> &chunkLineFeeds)
+{
+    Q_ASSERT(indexedSize % ChunkSize == 0);
+    for (qint64 count : chunkLineFeeds) {
+        totalLineFeeds += count;
+        indexedSize += ChunkSize;
+        checkpoints.append(totalLineFeeds);
+    }
+}
+
+qint64 LineIndex::lineFeedsBefore(const char *data, qint64 pos) const
+{
+    pos = qBound<qint64>(0, pos, indexedSize);
+    qint64 chunk = pos / ChunkSize;
+    qint64 chunkStart = chunk * ChunkSize;
+    return checkpoints.at(int(chunk)) + scanLineFeeds(data + chunkStart, pos - chunkStart);
+}
+
+qint64 LineIndex::countLineFeeds(const char *data, qint64 from, qint64 to) const
+{
+    if (to <= from) return 0;
+    if (to - from < ChunkSize) {
+        return scanLineFeeds(data + from, to - from);
+    }
+    return lineFeedsBefore(data, to) - lineFeedsBefore(data, from);
+}
+
+qint64 LineIndex::findLineFeed(const char *data, qint64 from, qint64 n) const
+{
+    if (n <= 0) return -1;
+
+    qint64 before = lineFeedsBefore(data, from);
+    qint64 target = before + n;
+    if (target > totalLineFeeds) return -1;
+
+    QVector<qint64>::const_iterator it = std::lower_bound(checkpoints.constBegin(), checkpoints.constEnd(), target);
+    qint64 chunk = (it - checkpoints.constBegin()) - 1;
+
+    qint64 pos = from;
+    qint64 count = before;
+    if (chunk * ChunkSize > from) {
+        pos = chunk * ChunkSize;
+        count = checkpoints.at(int(chunk));
+    }
+
+    qint64 remaining = target - count;
+    qint64 found = NewlineScanner::find(data + pos, indexedSize - pos, remaining);
+    return found < 0 ? -1 : pos + found;
+}
+
+qint64 LineIndex::scanLineFeeds(const char *data, qint64 length)
+{
+    return NewlineScanner::count(data, length);
+}
+
+LineIndexer::LineIndexer(const char *data, qint64 size, QObject *parent)
+    : QObject(parent), data(data), size(size), cancelled(0)
+{
+}
+
+LineIndexer::~LineIndexer()
+{
+    cancel();
+    future.waitForFinished();
+}
+
+void LineIndexer::start()
+{
+    future = QtConcurrent::run([this]() { run(); });
+}
+
+void LineIndexer::cancel()
+{
+    cancelled.storeRelease(1);
+}
+
+QVector<qint64> LineIndexer::takeChunks()
+{
+    QMutexLocker locker(&mutex);
+    QVector<qint64> chunks;
+    chunks.swap(pending);
+    return chunks;
+}
+
+void LineIndexer::run()
+{
+    QVector<qint64> batch;
+    int publishAfter = 16;
+    qint64 pos = 0;
+    while (pos + LineIndex::ChunkSize <= size) {
+        if (cancelled.loadAcquire()) return;
+
+        batch.append(LineIndex::scanLineFeeds(data + pos, LineIndex::ChunkSize));
+        pos += LineIndex::ChunkSize;
+
+        if (batch.size() >= publishAfter) {
+            {
+                QMutexLocker locker(&mutex);
+                pending += batch;
+            }
+            batch.clear();
+            publishAfter = 1024;
+            emit progress();
+        }
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        pending += batch;
+    }
+    emit finished();
+}
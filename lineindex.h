@@ -0,0 +1,68 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <QFuture>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+#include <QtGlobal>
+
+// Sparse newline index over a byte buffer: the number of line feeds before
+// every ChunkSize boundary is stored, anything finer is found by scanning at
+// most one chunk.
+class LineIndex
+{
+public:
+    static const qint64 ChunkSize = 64 * 1024;
+
+    LineIndex();
+
+    void clear();
+    void build(const char *data, qint64 size);
+    void extend(const char *data, qint64 newSize);
+    void appendChunks(const QVector<qint64> &chunkLineFeeds);
+
+    qint64 size() const { return indexedSize; }
+    qint64 lineFeeds() const { return totalLineFeeds; }
+    qint64 lineFeedsBefore(const char *data, qint64 pos) const;
+    qint64 countLineFeeds(const char *data, qint64 from, qint64 to) const;
+    qint64 findLineFeed(const char *data, qint64 from, qint64 n) const;
+
+    static qint64 scanLineFeeds(const char *data, qint64 length);
+
+private:
+    QVector<qint64> checkpoints;
+    qint64 indexedSize;
+    qint64 totalLineFeeds;
+};
+
+// Counts line feeds per chunk of a mapped file on a worker thread. Results
+// are handed over in batches through progress() so the LineIndex itself is
+// only ever touched from the GUI thread.
+class LineIndexer : public QObject
+{
+    Q_OBJECT
+public:
+    LineIndexer(const char *data, qint64 size, QObject *parent = nullptr);
+    ~LineIndexer();
+
+    void start();
+    void cancel();
+    QVector<qint64> takeChunks();
+
+signals:
+    void progress();
+    void finished();
+
+private:
+    void run();
+
+    const char *data;
+    qint64 size;
+    QMutex mutex;
+    QVector<qint64> pending;
+    QAtomicInt cancelled;
+    QFuture<void> future;
+};
+
+#endif
@@ -1,14 +1,46 @@
 #include "mainwindow.h"
+#include "batchrunner.h"
+#include "singleinstance.h"
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
+    // Batch mode must run without a display, so it is picked before any
+    // GUI object exists.
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--batch") == 0) {
+            QCoreApplication app(argc, argv);
+            app.setApplicationName("NOVA Editor");
+            app.setApplicationVersion("1.0");
+            return BatchRunner::exec(app.arguments());
+        }
+    }
+
     QApplication app(argc, argv);
     app.setApplicationName("NOVA Editor");
     app.setApplicationVersion("1.0");
     
+    // A running editor opens the files instead; this launch is done before
+    // any window or session is created. --new-instance opts out, and a
+    // launch without files opens a window of its own.
+    SingleInstance instance;
+    QStringList files = SingleInstance::filesFromArguments(app.arguments());
+    bool separate = app.arguments().contains("--new-instance");
+    if (!separate && !files.isEmpty()) {
+        SingleInstance::Outcome outcome = instance.forward(files);
+        if (outcome == SingleInstance::Taken) return 0;
+        // A running instance that did not answer in time keeps the name;
+        // this launch opens the files itself without listening.
+        if (outcome == SingleInstance::NoInstance) instance.listen();
+    } else if (!separate) {
+        // Becomes the instance only if none is running.
+        instance.listen();
+    }
+    
     MainWindow window;
+    QObject::connect(&instance, &SingleInstance::filesReceived, &window, &MainWindow::openFiles);
     window.show();
+    if (!files.isEmpty()) window.openFiles(files);
     
     return app.exec();
 }
\ No newline at end of file
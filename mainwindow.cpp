@@ -1,6 +1,22 @@
 #include "mainwindow.h"
+#include "largefileeditor.h"
+#include "fileloader.h"
+#include "filesaver.h"
+#include "syntaxhighlighter.h"
+#include "grammarregistry.h"
+#include "searchpanel.h"
+#include "symbolindex.h"
+#include "outlinepanel.h"
+#include "undohistory.h"
+#include "filewatcher.h"
+#include "filereloader.h"
+#include "filefollower.h"
+#include "structureindex.h"
+#include "performancehud.h"
+#include "tracer.h"
 #include <QApplication>
 #include <QFile>
+#include <QPointer>
 #include <QTextStream>
 #include <QFileDialog>
 #include <QMessageBox>
@@ -12,17 +28,67 @@
 #include <QFileInfo>
 #include <QCloseEvent>
 #include <QTextBlock>
+#include <QMouseEvent>
 #include <QScrollBar>
+#include <QProgressBar>
+#include <QToolButton>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QInputDialog>
+#include <QSaveFile>
+#include <QMenu>
+#include <QDateTime>
+#include <QtConcurrent>
+#include <algorithm>
+#include <climits>
 
+static const qint64 DefaultLargeFileThreshold = 64 * 1024 * 1024;
+static const qint64 DefaultLongLineThreshold = 16 * 1024;
+static const qint64 LongLineProbeBytes = 1024 * 1024;
+static const qint64 DefaultTabMemoryBudget = 512 * 1024 * 1024;
+static const int DefaultHibernateMinutes = 10;
+static const int DefaultFollowMaxLines = 100000;
+static const int FoldMarkerWidth = 14;
 
-CodeEditor::CodeEditor(QWidget *parent) : QPlainTextEdit(parent), isDarkTheme(true)
+// QTextLayout shapes a whole line at once, so a file whose head has a line
+// this long (minified code, single-line logs) is not given to CodeEditor.
+static bool hasLongLine(const QString &fileName, qint64 threshold)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) return false;
+    QByteArray head = file.read(LongLineProbeBytes);
+    int from = 0;
+    while (from < head.size()) {
+        int to = head.indexOf('\n', from);
+        if (to < 0) to = int(head.size());
+        if (to - from >= threshold) return true;
+        from = to + 1;
+    }
+    return false;
+}
+
+// Size and modification time of a file, to tell a real change on disk from
+// the echo of our own save.
+static QString fileStamp(const QString &fileName)
+{
+    QFileInfo info(fileName);
+    return QString("%1:%2").arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+}
+
+CodeEditor::CodeEditor(QWidget *parent)
+    : QPlainTextEdit(parent), expectedLines(0), currentBlock(-1), revision(0), bracketsMatched(false), isDarkTheme(true)
 {
     lineNumberArea = new LineNumberArea(this);
+    decorations = new DecorationLayer(this->document(), this);
+    history = new UndoHistory(this);
+    structure = new StructureIndex(this->document(), this);
+    revision = this->document()->revision();
     
     connect(this->document(), &QTextDocument::blockCountChanged, this, &CodeEditor::updateLineNumberAreaWidth);
-    connect(this->verticalScrollBar(), &QScrollBar::valueChanged, this, [this](int){ lineNumberArea->update(); });
-    connect(this, &QPlainTextEdit::textChanged, this, &CodeEditor::highlightCurrentLine);
+    connect(this->document(), &QTextDocument::contentsChange, this, &CodeEditor::onContentsChange);
+    connect(this, &QPlainTextEdit::cursorPositionChanged, this, &CodeEditor::revealCursor);
     connect(this, &QPlainTextEdit::cursorPositionChanged, this, &CodeEditor::highlightCurrentLine);
+    connect(this, &QPlainTextEdit::cursorPositionChanged, this, &CodeEditor::matchBrackets);
     connect(this, &QPlainTextEdit::updateRequest, this, &CodeEditor::onUpdateRequest);
     
     updateLineNumberAreaWidth(0);
@@ -36,38 +102,37 @@ CodeEditor::CodeEditor(QWidget *parent) : QPlainTextEdit(parent), isDarkTheme(tr
 
 void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
 {
+    TRACE_SCOPE("CodeEditor::lineNumberAreaPaintEvent");
     QPainter painter(lineNumberArea);
     
     if (isDarkTheme) {
-        painter.fillRect(event->rect(), QColor("#1e1e1e"));
+        painter.fillRect(event->rect(), QColor(0x1e, 0x1e, 0x1e));
     } else {
-        painter.fillRect(event->rect(), QColor("#f3f3f3"));
+        painter.fillRect(event->rect(), QColor(0xf3, 0xf3, 0xf3));
     }
     
     QTextBlock block = this->firstVisibleBlock();
     int blockNumber = block.blockNumber();
     int top = (int) this->blockBoundingGeometry(block).translated(this->contentOffset()).top();
     int bottom = top + (int) this->blockBoundingRect(block).height();
+    int current = this->textCursor().blockNumber();
+    int right = lineNumberArea->width() - 5 - FoldMarkerWidth;
+    int rowHeight = this->fontMetrics().height();
     
-    QFont font = this->font();
-    font.setPointSize(10);
-    painter.setFont(font);
+    if (isDarkTheme) {
+        gutterRenderer.setStyle(this->font(), QColor(0x85, 0x85, 0x85), QColor(0x56, 0x9c, 0xd6));
+    } else {
+        gutterRenderer.setStyle(this->font(), QColor(0x96, 0x96, 0x96), QColor(0x00, 0x7a, 0xcc));
+    }
+    gutterRenderer.begin(painter);
     
     while (block.isValid() && top <= event->rect().bottom()) {
         if (block.isVisible() && bottom >= event->rect().top()) {
-            QString number = QString::number(blockNumber + 1);
-            
-            QTextCursor cursor = this->textCursor();
-            if (cursor.blockNumber() == blockNumber) {
-                painter.setPen(isDarkTheme ? QColor("#569cd6") : QColor("#007acc"));
-                painter.setFont(QFont(font.family(), font.pointSize(), QFont::Bold));
-            } else {
-                painter.setPen(isDarkTheme ? QColor("#858585") : QColor("#969696"));
-                painter.setFont(font);
+            gutterRenderer.drawNumber(painter, blockNumber + 1, right, top, blockNumber == current);
+            if (structure->isFoldable(block)) {
+                BlockData *data = static_cast<BlockData*>(block.userData());
+                gutterRenderer.drawFoldMarker(painter, QRect(right + 5, top, FoldMarkerWidth, rowHeight), data->folded);
             }
-            
-            painter.drawText(0, top, lineNumberArea->width() - 5, this->fontMetrics().height(),
-                           Qt::AlignRight, number);
         }
         
         block = block.next();
@@ -80,16 +145,147 @@ void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
 int CodeEditor::lineNumberAreaWidth()
 {
     int digits = 1;
-    int max = qMax(1, this->document()->blockCount());
+    int max = qMax(1, lineCount());
     while (max >= 10) {
         max /= 10;
         ++digits;
     }
     
-    int space = 15 + this->fontMetrics().horizontalAdvance(QLatin1Char('9')) * digits;
+    int space = 15 + this->fontMetrics().horizontalAdvance(QLatin1Char('9')) * digits + FoldMarkerWidth;
     return space;
 }
 
+void CodeEditor::lineNumberAreaMousePressEvent(QMouseEvent *event)
+{
+    if (event->pos().x() < lineNumberArea->width() - FoldMarkerWidth) return;
+    
+    QTextBlock block = this->firstVisibleBlock();
+    int top = (int) this->blockBoundingGeometry(block).translated(this->contentOffset()).top();
+    while (block.isValid() && top <= event->pos().y()) {
+        int bottom = top + (int) this->blockBoundingRect(block).height();
+        if (block.isVisible() && event->pos().y() < bottom) {
+            if (structure->isFoldable(block)) toggleFold(block);
+            return;
+        }
+        block = block.next();
+        top = bottom;
+    }
+}
+
+void CodeEditor::toggleFold(const QTextBlock &block)
+{
+    BlockData *data = static_cast<BlockData*>(block.userData());
+    if (!data) return;
+    if (data->folded) {
+        unfold(block);
+        return;
+    }
+    
+    // The closing line stays visible like the opening one, so a fold hides
+    // at least one line or is not made.
+    QTextBlock end = structure->foldEnd(block);
+    if (!end.isValid() || end.blockNumber() <= block.blockNumber() + 1) return;
+    int from = block.next().position();
+    int cursor = this->textCursor().position();
+    if (cursor >= from && cursor < end.position()) {
+        QTextCursor moved = this->textCursor();
+        moved.setPosition(from - 1);
+        this->setTextCursor(moved);
+    }
+    for (QTextBlock hidden = block.next(); hidden != end; hidden = hidden.next()) {
+        hidden.setVisible(false);
+    }
+    data->folded = true;
+    relayout(from, end.position());
+}
+
+void CodeEditor::unfold(const QTextBlock &block)
+{
+    // Everything hidden below the line comes back, folds nested inside
+    // included.
+    BlockData *data = static_cast<BlockData*>(block.userData());
+    if (data) data->folded = false;
+    QTextBlock shown = block.next();
+    while (shown.isValid() && !shown.isVisible()) {
+        shown.setVisible(true);
+        BlockData *inner = static_cast<BlockData*>(shown.userData());
+        if (inner) inner->folded = false;
+        shown = shown.next();
+    }
+    int from = block.next().isValid() ? block.next().position() : block.position();
+    int to = shown.isValid() ? shown.position() : this->document()->characterCount() - 1;
+    if (to > from) relayout(from, to);
+}
+
+void CodeEditor::reveal(const QTextBlock &block)
+{
+    if (!block.isValid() || block.isVisible()) return;
+    QTextBlock header = block.previous();
+    while (header.isValid() && !header.isVisible()) {
+        header = header.previous();
+    }
+    if (header.isValid()) unfold(header);
+}
+
+void CodeEditor::relayout(int from, int to)
+{
+    // Hidden blocks take no lines once they are laid out again.
+    this->document()->markContentsDirty(from, to - from);
+    this->viewport()->update();
+    lineNumberArea->update();
+}
+
+void CodeEditor::onContentsChange(int position, int removed, int added)
+{
+    Q_UNUSED(removed);
+    if (this->document()->revision() == revision) return;
+    revision = this->document()->revision();
+    
+    // An edit on a folded line, or one that ends inside a fold, opens it.
+    // The relayout cannot happen inside the edit's own notification, so it
+    // follows right after.
+    int end = position + added;
+    QTimer::singleShot(0, this, [this, position, end]() {
+        QTextBlock first = this->document()->findBlock(position);
+        BlockData *data = first.isValid() ? static_cast<BlockData*>(first.userData()) : nullptr;
+        if (data && data->folded) unfold(first);
+        reveal(first);
+        reveal(this->document()->findBlock(end));
+    });
+}
+
+void CodeEditor::revealCursor()
+{
+    reveal(this->textCursor().block());
+}
+
+void CodeEditor::matchBrackets()
+{
+    // The bracket after the cursor, or else the one before it.
+    int position = this->textCursor().position();
+    int at = position;
+    int match = structure->match(at);
+    if (match < 0 && position > 0) {
+        at = position - 1;
+        match = structure->match(at);
+    }
+    
+    QVector<DecorationLayer::Range> ranges;
+    if (match >= 0) {
+        ranges.append(DecorationLayer::Range{qMin(at, match), 1});
+        ranges.append(DecorationLayer::Range{qMax(at, match), 1});
+    }
+    if (ranges.isEmpty() && !bracketsMatched) return;
+    bracketsMatched = !ranges.isEmpty();
+    setDecorations(DecorationLayer::BracketMatch, ranges);
+}
+
+void CodeEditor::setExpectedLineCount(qint64 lines)
+{
+    expectedLines = int(qMin<qint64>(lines, INT_MAX));
+    updateLineNumberAreaWidth(0);
+}
+
 void CodeEditor::resizeEvent(QResizeEvent *event)
 {
     QPlainTextEdit::resizeEvent(event);
@@ -106,21 +302,126 @@ void CodeEditor::updateLineNumberAreaWidth(int newBlockCount)
 
 void CodeEditor::highlightCurrentLine()
 {
-    QList<QTextEdit::ExtraSelection> extraSelections;
+    TRACE_SCOPE("CodeEditor::highlightCurrentLine");
+    // The current line is painted by paintEvent; a cursor move only
+    // repaints the row losing the highlight and the row gaining it.
+    int block = this->textCursor().blockNumber();
+    if (block != currentBlock) {
+        updateBlockRow(currentBlock);
+        updateBlockRow(block);
+        currentBlock = block;
+    }
+}
+
+void CodeEditor::setIsDarkTheme(bool dark)
+{
+    isDarkTheme = dark;
+    decorations->setIsDarkTheme(dark);
+    this->viewport()->update();
+}
+
+void CodeEditor::setDecorations(DecorationLayer::Kind kind, const QVector<DecorationLayer::Range> &ranges)
+{
+    // Only rows on screen can need a repaint, so compare just those.
+    QVector<QTextBlock> blocks;
+    QVector<QVector<BlockData::Decoration>> before;
+    QPointF offset = this->contentOffset();
+    for (QTextBlock block = this->firstVisibleBlock(); block.isValid() && offset.y() <= this->viewport()->height(); block = block.next()) {
+        blocks.append(block);
+        before.append(decorations->decorations(block));
+        offset.ry() += this->blockBoundingRect(block).height();
+    }
     
-    if (!this->isReadOnly()) {
-        QTextEdit::ExtraSelection selection;
-        
-        QColor lineColor = isDarkTheme ? QColor("#2d2d30") : QColor("#f6f6f6");
-        selection.format.setBackground(lineColor);
-        selection.format.setProperty(QTextFormat::FullWidthSelection, true);
-        selection.cursor = this->textCursor();
-        selection.cursor.clearSelection();
-        extraSelections.append(selection);
+    decorations->setRanges(kind, ranges);
+    
+    for (int i = 0; i < blocks.size(); ++i) {
+        if (decorations->decorations(blocks.at(i)) != before.at(i)) {
+            updateBlockRow(blocks.at(i).blockNumber());
+        }
     }
+}
+
+void CodeEditor::paintEvent(QPaintEvent *event)
+{
+    TRACE_SCOPE(PerformanceHud::FrameSpan);
+    QPainter painter(this->viewport());
+    QTextBlock block = this->firstVisibleBlock();
+    int blockNumber = block.blockNumber();
+    QPointF offset = this->contentOffset();
+    QRect area = event->rect();
+    QColor lineColor = isDarkTheme ? QColor(0x2d, 0x2d, 0x30) : QColor(0xf6, 0xf6, 0xf6);
     
-    this->setExtraSelections(extraSelections);
-    lineNumberArea->update();
+    while (block.isValid() && offset.y() <= area.bottom()) {
+        QRectF rect = this->blockBoundingRect(block).translated(offset);
+        if (block.isVisible() && rect.bottom() >= area.top()) {
+            if (blockNumber == currentBlock && !this->isReadOnly()) {
+                painter.fillRect(QRectF(0, rect.top(), this->viewport()->width(), rect.height()), lineColor);
+            }
+            decorations->paint(painter, block, rect.topLeft());
+        }
+        offset.ry() += rect.height();
+        block = block.next();
+        ++blockNumber;
+    }
+    painter.end();
+    
+    QPlainTextEdit::paintEvent(event);
+}
+
+qint64 CodeEditor::memoryEstimate() const
+{
+    // The text is held by the document and by the undo copy; each line adds
+    // a layout, highlight formats and block bookkeeping.
+    const QTextDocument *document = this->document();
+    return qint64(document->characterCount()) * 4 + qint64(document->blockCount()) * 256 + history->memoryUsed();
+}
+
+void CodeEditor::keyPressEvent(QKeyEvent *event)
+{
+    if (event == QKeySequence::Undo || event == QKeySequence::Redo) {
+        if (!this->isReadOnly()) {
+            if (event == QKeySequence::Undo) history->undo();
+            else history->redo();
+        }
+        event->accept();
+        return;
+    }
+    QPlainTextEdit::keyPressEvent(event);
+}
+
+void CodeEditor::contextMenuEvent(QContextMenuEvent *event)
+{
+    // The standard Undo and Redo entries drive the document's own stack,
+    // which is off; swap in ones that drive the history.
+    QMenu *menu = this->createStandardContextMenu(event->pos());
+    const QList<QAction*> actions = menu->actions();
+    for (QAction *action : actions) {
+        bool undo = action->objectName() == "edit-undo";
+        if (!undo && action->objectName() != "edit-redo") continue;
+        QAction *replacement = new QAction(action->text(), menu);
+        replacement->setEnabled(!this->isReadOnly() && (undo ? history->isUndoAvailable() : history->isRedoAvailable()));
+        connect(replacement, &QAction::triggered, this, [this, undo]() {
+            if (undo) history->undo();
+            else history->redo();
+        });
+        menu->insertAction(action, replacement);
+        menu->removeAction(action);
+    }
+    menu->exec(event->globalPos());
+    delete menu;
+}
+
+void CodeEditor::updateBlockRow(int blockNumber)
+{
+    QTextBlock block = this->document()->findBlockByNumber(blockNumber);
+    if (!block.isValid() || !block.isVisible()) return;
+    
+    QRectF rect = this->blockBoundingGeometry(block).translated(this->contentOffset());
+    if (rect.bottom() < 0 || rect.top() > this->viewport()->height()) return;
+    int top = int(rect.top());
+    int height = int(rect.height()) + 1;
+    this->viewport()->update(0, top, this->viewport()->width(), height);
+    lineNumberArea->update(0, top, lineNumberArea->width(), height);
 }
 
 void CodeEditor::onUpdateRequest(const QRect &rect, int dy)
@@ -141,100 +442,57 @@ void CodeEditor::updateLineNumberArea()
     lineNumberArea->update();
 }
 
-CppHighlighter::CppHighlighter(QTextDocument *parent) : QSyntaxHighlighter(parent)
-{
-    keywordFormat.setForeground(QColor("#ff79c6"));
-    keywordFormat.setFontWeight(QFont::Bold);
-    QStringList keywordPatterns;
-    keywordPatterns << "\\bchar\\b" << "\\bclass\\b" << "\\bconst\\b" << "\\bdouble\\b" << "\\benum\\b"
-                    << "\\bexplicit\\b" << "\\bfriend\\b" << "\\binline\\b" << "\\bint\\b" << "\\blong\\b"
-                    << "\\bnamespace\\b" << "\\boperator\\b" << "\\bprivate\\b" << "\\bprotected\\b"
-                    << "\\bpublic\\b" << "\\bshort\\b" << "\\bsignals\\b" << "\\bsigned\\b" << "\\bslots\\b"
-                    << "\\bstatic\\b" << "\\bstruct\\b" << "\\btemplate\\b" << "\\btypedef\\b" << "\\btypename\\b"
-                    << "\\bunion\\b" << "\\bunsigned\\b" << "\\bvirtual\\b" << "\\bvoid\\b" << "\\bvolatile\\b"
-                    << "\\bbool\\b" << "\\breturn\\b" << "\\bif\\b" << "\\belse\\b" << "\\bfor\\b" << "\\bwhile\\b"
-                    << "\\bdo\\b" << "\\bswitch\\b" << "\\bcase\\b" << "\\bbreak\\b" << "\\bcontinue\\b"
-                    << "\\bgoto\\b" << "\\bdefault\\b" << "\\btry\\b" << "\\bcatch\\b" << "\\bthrow\\b"
-                    << "\\bnew\\b" << "\\bdelete\\b" << "\\bthis\\b" << "\\btrue\\b" << "\\bfalse\\b" << "\\bnullptr\\b";
-    for (const QString &pattern : keywordPatterns) {
-        HighlightingRule rule;
-        rule.pattern = QRegularExpression(pattern);
-        rule.format = keywordFormat;
-        highlightingRules.append(rule);
-    }
-    classFormat.setForeground(QColor("#8be9fd"));
-    classFormat.setFontWeight(QFont::Bold);
-    HighlightingRule classRule;
-    classRule.pattern = QRegularExpression("\\bQ[A-Za-z]+\\b");
-    classRule.format = classFormat;
-    highlightingRules.append(classRule);
-    singleLineCommentFormat.setForeground(QColor("#6272a4"));
-    HighlightingRule singleLineCommentRule;
-    singleLineCommentRule.pattern = QRegularExpression("//[^\n]*");
-    singleLineCommentRule.format = singleLineCommentFormat;
-    highlightingRules.append(singleLineCommentRule);
-    multiLineCommentFormat.setForeground(QColor("#6272a4"));
-    quotationFormat.setForeground(QColor("#f1fa8c"));
-    HighlightingRule quotationRule;
-    quotationRule.pattern = QRegularExpression("\".*\"");
-    quotationRule.format = quotationFormat;
-    highlightingRules.append(quotationRule);
-    functionFormat.setForeground(QColor("#50fa7b"));
-    HighlightingRule functionRule;
-    functionRule.pattern = QRegularExpression("\\b[A-Za-z0-9_]+(?=\\()");
-    functionRule.format = functionFormat;
-    highlightingRules.append(functionRule);
-    numberFormat.setForeground(QColor("#bd93f9"));
-    HighlightingRule numberRule;
-    numberRule.pattern = QRegularExpression("\\b[0-9]+\\b");
-    numberRule.format = numberFormat;
-    highlightingRules.append(numberRule);
-    commentStartExpression = QRegularExpression("/\\*");
-    commentEndExpression = QRegularExpression("\\*/");
-}
-
-void CppHighlighter::highlightBlock(const QString &text)
-{
-    for (const HighlightingRule &rule : highlightingRules) {
-        QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
-        while (matchIterator.hasNext()) {
-            QRegularExpressionMatch match = matchIterator.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
-        }
-    }
-    setCurrentBlockState(0);
-    int startIndex = 0;
-    if (previousBlockState() != 1)
-        startIndex = text.indexOf(commentStartExpression);
-    while (startIndex >= 0) {
-        QRegularExpressionMatch match = commentEndExpression.match(text, startIndex);
-        int endIndex = match.capturedStart();
-        int commentLength = 0;
-        if (endIndex == -1) {
-            setCurrentBlockState(1);
-            commentLength = text.length() - startIndex;
-        } else {
-            commentLength = endIndex - startIndex + match.capturedLength();
-        }
-        setFormat(startIndex, commentLength, multiLineCommentFormat);
-        startIndex = text.indexOf(commentStartExpression, startIndex + commentLength);
-    }
+void TabPlaceholder::pack(const QString &text)
+{
+    packed = true;
+    packedText = QtConcurrent::run([text]() { return qCompress(text.toUtf8(), 1); });
+}
+
+QString TabPlaceholder::text() const
+{
+    return packed ? QString::fromUtf8(qUncompress(packedText.result())) : QString();
 }
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), isDarkTheme(true)
 {
     settings = new QSettings("NOVA Editor", "NOVA Editor", this);
     translator = new QTranslator(this);
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    QDir().mkpath(dataDir);
+    sessionStore = new SessionStore(dataDir + "/session.dat");
+    materializing = false;
+    prefetchTimer = new QTimer(this);
+    prefetchTimer->setSingleShot(true);
+    prefetchTimer->setInterval(500);
+    connect(prefetchTimer, &QTimer::timeout, this, &MainWindow::prefetchTabs);
+    hibernateTimer = new QTimer(this);
+    hibernateTimer->setInterval(60000);
+    connect(hibernateTimer, &QTimer::timeout, this, &MainWindow::hibernateTabs);
+    hibernateTimer->start();
+    symbolIndex = new SymbolIndex(dataDir, this);
+    fileWatcher = new FileWatcher(this);
+    grammarRegistry = new GrammarRegistry(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation), this);
+    connect(fileWatcher, &FileWatcher::fileChanged, this, &MainWindow::reloadFile);
+    symbolTimer = new QTimer(this);
+    symbolTimer->setSingleShot(true);
+    symbolTimer->setInterval(300);
+    connect(symbolTimer, &QTimer::timeout, this, &MainWindow::updateSymbols);
+    UndoHistory::setBudgets(settings->value("undoTabBudget", UndoHistory::DefaultTabBudget).toLongLong(),
+                           settings->value("undoTotalBudget", UndoHistory::DefaultTotalBudget).toLongLong());
     
     setupUI();
     setupToolbar();
     loadLanguage();
+    // Startup itself is only traced when asked for before launch.
+    if (qEnvironmentVariableIsSet("NOVA_TRACE")) Tracer::setEnabled(true);
+    symbolIndex->setRoot(settings->value("projectFolder").toString());
     loadSession();
 }
 
 MainWindow::~MainWindow()
 {
     saveSession();
+    delete sessionStore;
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -256,6 +514,31 @@ void MainWindow::setupUI()
     
     menuBar()->setVisible(false);
     
+    loadProgress = new QProgressBar(this);
+    loadProgress->setRange(0, 100);
+    loadProgress->setMaximumWidth(200);
+    loadProgress->setVisible(false);
+    cancelLoadButton = new QToolButton(this);
+    cancelLoadButton->setText("Cancel");
+    cancelLoadButton->setVisible(false);
+    positionLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(positionLabel);
+    statusBar()->addPermanentWidget(loadProgress);
+    statusBar()->addPermanentWidget(cancelLoadButton);
+    connect(cancelLoadButton, &QToolButton::clicked, this, &MainWindow::cancelLoading);
+    
+    searchPanel = new SearchPanel(tabWidget, this);
+    addDockWidget(Qt::BottomDockWidgetArea, searchPanel);
+    connect(searchPanel, &SearchPanel::locationRequested, this, &MainWindow::openLocation);
+    searchPanel->hide();
+    
+    outlinePanel = new OutlinePanel(symbolIndex, this);
+    addDockWidget(Qt::RightDockWidgetArea, outlinePanel);
+    connect(outlinePanel, &OutlinePanel::locationRequested, this, &MainWindow::openLocation);
+    outlinePanel->hide();
+    
+    hud = new PerformanceHud(tabWidget);
+    
     setupSettingsTab();
 }
 
@@ -280,10 +563,62 @@ void MainWindow::setupToolbar()
     saveAsAct->setShortcut(QKeySequence::SaveAs);
     connect(saveAsAct, &QAction::triggered, this, &MainWindow::saveAsFile);
     
+    goToLineAct = new QAction("Go to Line", this);
+    goToLineAct->setShortcut(QKeySequence("Ctrl+G"));
+    connect(goToLineAct, &QAction::triggered, this, &MainWindow::goToLine);
+    addAction(goToLineAct);
+    
+    findAct = new QAction("Find", this);
+    findAct->setShortcut(QKeySequence::Find);
+    connect(findAct, &QAction::triggered, searchPanel, &SearchPanel::showFind);
+    addAction(findAct);
+    
+    replaceAct = new QAction("Replace", this);
+    replaceAct->setShortcut(QKeySequence::Replace);
+    connect(replaceAct, &QAction::triggered, searchPanel, &SearchPanel::showReplace);
+    addAction(replaceAct);
+    
+    openFolderAct = new QAction("Open Folder", this);
+    connect(openFolderAct, &QAction::triggered, this, &MainWindow::openFolder);
+    
+    goToDefinitionAct = new QAction("Go to Definition", this);
+    goToDefinitionAct->setShortcut(QKeySequence("F12"));
+    connect(goToDefinitionAct, &QAction::triggered, this, &MainWindow::goToDefinition);
+    addAction(goToDefinitionAct);
+    
+    outlineAct = new QAction("Outline", this);
+    outlineAct->setShortcut(QKeySequence("Ctrl+Shift+O"));
+    connect(outlineAct, &QAction::triggered, this, [this]() {
+        outlinePanel->show();
+        outlinePanel->raise();
+    });
+    addAction(outlineAct);
+    
+    followAct = new QAction("Follow", this);
+    followAct->setShortcut(QKeySequence("Ctrl+Shift+L"));
+    followAct->setCheckable(true);
+    followAct->setEnabled(false);
+    connect(followAct, &QAction::triggered, this, &MainWindow::toggleFollow);
+    
+    traceAct = new QAction("Performance HUD", this);
+    traceAct->setShortcut(QKeySequence("Ctrl+Alt+P"));
+    traceAct->setCheckable(true);
+    connect(traceAct, &QAction::toggled, this, &MainWindow::toggleTracing);
+    addAction(traceAct);
+    traceButton->setDefaultAction(traceAct);
+    
+    exportTraceAct = new QAction("Export Trace", this);
+    exportTraceAct->setShortcut(QKeySequence("Ctrl+Alt+E"));
+    connect(exportTraceAct, &QAction::triggered, this, &MainWindow::exportTrace);
+    addAction(exportTraceAct);
+    exportTraceButton->setDefaultAction(exportTraceAct);
+    
     mainToolBar->addAction(newAct);
     mainToolBar->addAction(openAct);
+    mainToolBar->addAction(openFolderAct);
     mainToolBar->addAction(saveAct);
     mainToolBar->addAction(saveAsAct);
+    mainToolBar->addAction(followAct);
 }
 
 void MainWindow::setupSettingsTab()
@@ -309,6 +644,16 @@ void MainWindow::setupSettingsTab()
     themeLayout->addWidget(themeCombo);
     layout->addWidget(themeGroup);
     
+    // The buttons get their actions in setupToolbar().
+    QGroupBox *performanceGroup = new QGroupBox("Performance");
+    QHBoxLayout *performanceLayout = new QHBoxLayout(performanceGroup);
+    traceButton = new QToolButton();
+    exportTraceButton = new QToolButton();
+    performanceLayout->addWidget(traceButton);
+    performanceLayout->addWidget(exportTraceButton);
+    performanceLayout->addStretch();
+    layout->addWidget(performanceGroup);
+    
     layout->addStretch();
     
     tabWidget->addTab(settingsWidget, "Settings");
@@ -369,6 +714,10 @@ void MainWindow::applyTheme(bool dark)
             editor->highlightCurrentLine();
             editor->getLineNumberArea()->update();
         }
+        LargeFileEditor *largeFileEditor = qobject_cast<LargeFileEditor*>(tabWidget->widget(i));
+        if (largeFileEditor) {
+            largeFileEditor->setIsDarkTheme(dark);
+        }
     }
 }
 
@@ -381,6 +730,22 @@ void MainWindow::loadLanguage()
         openAct->setText("Открыть");
         saveAct->setText("Сохранить");
         saveAsAct->setText("Сохранить как");
+        cancelLoadButton->setText("Отмена");
+        goToLineAct->setText("Перейти к строке");
+        findAct->setText("Найти");
+        replaceAct->setText("Заменить");
+        openFolderAct->setText("Открыть папку");
+        goToDefinitionAct->setText("Перейти к определению");
+        outlineAct->setText("Структура");
+        followAct->setText("Следить");
+        traceAct->setText("Панель производительности");
+        exportTraceAct->setText("Экспорт трассировки");
+        positionFormat = "Стр %1, Стлб %2";
+        noDefinitionFormat = "Определение %1 не найдено";
+        changedOnDiskFormat = "%1 изменён на диске; в редакторе есть несохранённые правки";
+        shrankOnDiskFormat = "%1 укорочен на диске; часть текста вкладки потеряна, сохранить её нельзя";
+        unsavedEditsFormat = "В %1 есть несохранённые правки";
+        goToLineFormat = "Строка (1 - %1):";
         
         if (tabWidget->count() > 0) {
             tabWidget->setTabText(0, "Настройки");
@@ -395,6 +760,7 @@ void MainWindow::loadLanguage()
         for (QGroupBox *group : groups) {
             if (group->title() == "Language") group->setTitle("Язык");
             if (group->title() == "Theme") group->setTitle("Тема");
+            if (group->title() == "Performance") group->setTitle("Производительность");
         }
         
         QList<QLabel*> labels = findChildren<QLabel*>();
@@ -407,6 +773,22 @@ void MainWindow::loadLanguage()
         openAct->setText("Open");
         saveAct->setText("Save");
         saveAsAct->setText("Save As");
+        cancelLoadButton->setText("Cancel");
+        goToLineAct->setText("Go to Line");
+        findAct->setText("Find");
+        replaceAct->setText("Replace");
+        openFolderAct->setText("Open Folder");
+        goToDefinitionAct->setText("Go to Definition");
+        outlineAct->setText("Outline");
+        followAct->setText("Follow");
+        traceAct->setText("Performance HUD");
+        exportTraceAct->setText("Export Trace");
+        positionFormat = "Ln %1, Col %2";
+        noDefinitionFormat = "No definition found for %1";
+        changedOnDiskFormat = "%1 changed on disk; the editor has unsaved edits";
+        shrankOnDiskFormat = "%1 shrank on disk; part of the tab's text is lost and it cannot be saved";
+        unsavedEditsFormat = "%1 has unsaved edits";
+        goToLineFormat = "Line (1 - %1):";
         
         if (tabWidget->count() > 0) {
             tabWidget->setTabText(0, "Settings");
@@ -421,6 +803,7 @@ void MainWindow::loadLanguage()
         for (QGroupBox *group : groups) {
             if (group->title() == "Язык") group->setTitle("Language");
             if (group->title() == "Тема") group->setTitle("Theme");
+            if (group->title() == "Производительность") group->setTitle("Performance");
         }
         
         QList<QLabel*> labels = findChildren<QLabel*>();
@@ -429,6 +812,10 @@ void MainWindow::loadLanguage()
             if (label->text() == "Цветовая тема:") label->setText("Color Theme:");
         }
     }
+    
+    searchPanel->setLanguage(lang);
+    outlinePanel->setLanguage(lang);
+    updateCursorPosition();
 }
 
 void MainWindow::changeLanguage(int index)
@@ -446,6 +833,186 @@ void MainWindow::changeTheme(int index)
 }
 
 void MainWindow::loadSession()
+{
+    TRACE_SCOPE("MainWindow::loadSession");
+    if (!sessionStore->exists()) {
+        loadLegacySession();
+        return;
+    }
+    
+    // Restored tabs start as placeholders; the editor is built, the file
+    // read and the text highlighted when the tab is first activated.
+    QVector<SessionStore::Tab> tabs = sessionStore->load();
+    for (const SessionStore::Tab &tab : tabs) {
+        QString title = tab.filePath.isEmpty() ? QString("Untitled") : QFileInfo(tab.filePath).fileName();
+        if (tab.hasText && !tab.filePath.isEmpty()) {
+            title += "*";
+        }
+        tabWidget->addTab(new TabPlaceholder(tab), title);
+    }
+    
+    if (tabWidget->count() == 0) {
+        newFile();
+    }
+}
+
+bool MainWindow::materializeTab(int index)
+{
+    TabPlaceholder *placeholder = qobject_cast<TabPlaceholder*>(tabWidget->widget(index));
+    if (!placeholder) return false;
+    
+    const SessionStore::Tab tab = placeholder->tab();
+    QWidget *editor = nullptr;
+    bool sameFile = !tab.filePath.isEmpty()
+        && QFileInfo(tab.filePath).lastModified().toMSecsSinceEpoch() == tab.modifiedTime;
+    
+    if (tab.hasText) {
+        CodeEditor *codeEditor = createEditor(tab.filePath);
+        codeEditor->setPlainText(placeholder->hasText() ? placeholder->text() : sessionStore->loadText(tab));
+        queueSymbols(codeEditor);
+        QTextCursor cursor = codeEditor->textCursor();
+        cursor.setPosition(qBound<qint64>(0, tab.cursor, codeEditor->document()->characterCount() - 1));
+        codeEditor->setTextCursor(cursor);
+        // Only text read back from the session file matches its entry; a
+        // packed tab holds newer edits, which the next save has to write.
+        if (!placeholder->hasText()) {
+            sessionStore->adopt(tab.id, codeEditor->document()->revision());
+        }
+        if (!tab.filePath.isEmpty()) {
+            codeEditor->document()->setModified(true);
+        }
+        codeEditor->undoHistory()->clear();
+        editor = codeEditor;
+    } else {
+        editor = createFileEditor(tab.filePath);
+        LargeFileEditor *largeFileEditor = qobject_cast<LargeFileEditor*>(editor);
+        if (sameFile && largeFileEditor) {
+            largeFileEditor->setCursorPosition(tab.cursor);
+        } else if (sameFile && editor) {
+            editor->setProperty("sessionCursor", tab.cursor);
+            if (placeholder->scrollValue() >= 0) {
+                editor->setProperty("sessionScroll", placeholder->scrollValue());
+            }
+        }
+    }
+    
+    materializing = true;
+    bool current = tabWidget->currentIndex() == index;
+    QString title = tabWidget->tabText(index);
+    tabWidget->removeTab(index);
+    if (editor) {
+        editor->setProperty("sessionId", tab.id);
+        tabWidget->insertTab(index, editor, title);
+        if (current) {
+            tabWidget->setCurrentIndex(index);
+        }
+        CodeEditor *codeEditor = qobject_cast<CodeEditor*>(editor);
+        int scroll = placeholder->scrollValue();
+        if (codeEditor && tab.hasText && scroll >= 0) {
+            // The scroll range is only right once the editor is laid out.
+            QTimer::singleShot(0, codeEditor, [codeEditor, scroll]() {
+                codeEditor->verticalScrollBar()->setValue(scroll);
+            });
+        }
+    } else {
+        statusBar()->showMessage(QString("Cannot open %1").arg(tab.filePath), 5000);
+    }
+    placeholder->deleteLater();
+    materializing = false;
+    updateWatchedFiles();
+    return editor != nullptr;
+}
+
+void MainWindow::prefetchTabs()
+{
+    if (!settings->value("prefetchNeighbourTabs", true).toBool()) return;
+    
+    int index = tabWidget->currentIndex();
+    if (index <= 0) return;
+    for (int neighbour : {index + 1, index - 1}) {
+        TabPlaceholder *placeholder = neighbour > 0 && neighbour < tabWidget->count()
+            ? qobject_cast<TabPlaceholder*>(tabWidget->widget(neighbour)) : nullptr;
+        // Hibernated tabs were put to sleep on purpose; only restored ones
+        // are woken ahead of time.
+        if (placeholder && !placeholder->isHibernated()) {
+            materializeTab(neighbour);
+            // One tab per idle period, so input is never held up for long.
+            prefetchTimer->start();
+            return;
+        }
+    }
+}
+
+void MainWindow::hibernateTabs()
+{
+    qint64 budget = settings->value("tabMemoryBudget", DefaultTabMemoryBudget).toLongLong();
+    qint64 idle = settings->value("hibernateMinutes", DefaultHibernateMinutes).toLongLong() * 60000;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QWidget *current = tabWidget->currentWidget();
+    if (current) {
+        current->setProperty("lastActive", now);
+    }
+    
+    qint64 total = 0;
+    QVector<QPair<qint64, CodeEditor*>> idleEditors;
+    for (int i = 1; i < tabWidget->count(); ++i) {
+        CodeEditor *editor = qobject_cast<CodeEditor*>(tabWidget->widget(i));
+        if (!editor) continue;
+        total += editor->memoryEstimate();
+        qint64 lastActive = editor->property("lastActive").toLongLong();
+        // A placeholder keeps text but no undo history, so edited tabs stay.
+        UndoHistory *history = editor->undoHistory();
+        if (editor != current && now - lastActive >= idle && !fileLoader(editor) && !fileFollower(editor)
+            && !savingEditors.contains(editor) && !history->isUndoAvailable() && !history->isRedoAvailable()) {
+            idleEditors.append(qMakePair(lastActive, editor));
+        }
+    }
+    if (total <= budget) return;
+    
+    // Least recently used first, until the open tabs fit again.
+    std::sort(idleEditors.begin(), idleEditors.end(), [](const QPair<qint64, CodeEditor*> &a, const QPair<qint64, CodeEditor*> &b) {
+        return a.first < b.first;
+    });
+    for (const QPair<qint64, CodeEditor*> &idleEditor : idleEditors) {
+        if (total <= budget) break;
+        total -= idleEditor.second->memoryEstimate();
+        hibernateTab(tabWidget->indexOf(idleEditor.second));
+    }
+}
+
+void MainWindow::hibernateTab(int index)
+{
+    CodeEditor *editor = qobject_cast<CodeEditor*>(tabWidget->widget(index));
+    if (!editor || (editor->filePath().isEmpty() && editor->document()->isEmpty())) return;
+    
+    // A clean file tab keeps only its path and position; one with unsaved
+    // text keeps the text, unless the session file already has this
+    // revision of it.
+    SessionStore::Tab tab;
+    tab.id = sessionId(editor);
+    tab.filePath = editor->filePath();
+    tab.revision = editor->document()->revision();
+    tab.cursor = editor->textCursor().position();
+    tab.hasText = tab.filePath.isEmpty() || editor->document()->isModified();
+    if (!tab.filePath.isEmpty()) {
+        tab.modifiedTime = QFileInfo(tab.filePath).lastModified().toMSecsSinceEpoch();
+    }
+    TabPlaceholder *placeholder = new TabPlaceholder(tab);
+    placeholder->hibernate(editor->verticalScrollBar()->value());
+    if (tab.hasText && sessionStore->needsText(tab)) {
+        placeholder->pack(editor->toPlainText());
+    }
+    
+    materializing = true;
+    QString title = tabWidget->tabText(index);
+    tabWidget->removeTab(index);
+    tabWidget->insertTab(index, placeholder, title);
+    materializing = false;
+    editor->deleteLater();
+    updateWatchedFiles();
+}
+
+void MainWindow::loadLegacySession()
 {
     int tabCount = settings->beginReadArray("tabs");
     for (int i = 0; i < tabCount; ++i) {
@@ -454,70 +1021,290 @@ void MainWindow::loadSession()
         QString content = settings->value("content").toString();
         
         if (!filePath.isEmpty()) {
-            QFile file(filePath);
-            if (file.open(QFile::ReadOnly | QFile::Text)) {
-                CodeEditor *editor = createEditor();
-                editor->setPlainText(QTextStream(&file).readAll());
+            QWidget *editor = createFileEditor(filePath);
+            if (editor) {
                 tabWidget->addTab(editor, QFileInfo(filePath).fileName());
-                file.close();
             }
         } else if (!content.isEmpty()) {
             CodeEditor *editor = createEditor();
             editor->setPlainText(content);
+            editor->undoHistory()->clear();
             tabWidget->addTab(editor, "Untitled");
         }
     }
     settings->endArray();
+    updateWatchedFiles();
     
     if (tabWidget->count() == 0) {
         newFile();
     }
 }
 
+quint64 MainWindow::sessionId(QWidget *editor)
+{
+    QVariant id = editor->property("sessionId");
+    if (!id.isValid()) {
+        id = sessionStore->createId();
+        editor->setProperty("sessionId", id);
+    }
+    return id.toULongLong();
+}
+
 void MainWindow::saveSession()
 {
-    settings->beginWriteArray("tabs");
-    int saveIndex = 0;
-    
+    TRACE_SCOPE("MainWindow::saveSession");
+    // Only untitled and modified tabs carry text, and only the ones whose
+    // revision moved since the last save are re-encoded. Tabs backed by an
+    // unmodified file are stored as path, mtime and cursor.
+    QVector<SessionStore::Tab> tabs;
     for (int i = 1; i < tabWidget->count(); ++i) {
-        CodeEditor *editor = qobject_cast<CodeEditor*>(tabWidget->widget(i));
+        QWidget *widget = tabWidget->widget(i);
+        TabPlaceholder *placeholder = qobject_cast<TabPlaceholder*>(widget);
+        if (placeholder) {
+            SessionStore::Tab tab = placeholder->tab();
+            if (placeholder->hasText() && sessionStore->needsText(tab)) {
+                tab.text = placeholder->text();
+            }
+            tabs.append(tab);
+            continue;
+        }
+        SessionStore::Tab tab;
+        
+        CodeEditor *editor = qobject_cast<CodeEditor*>(widget);
         if (editor) {
-            settings->setArrayIndex(saveIndex++);
-            QString filePath = "";
-            if (!currentFile.isEmpty() && tabWidget->currentIndex() == i) {
-                filePath = currentFile;
+            tab.filePath = editor->filePath();
+            tab.revision = editor->document()->revision();
+            if (fileLoader(editor)) {
+                tab.cursor = editor->property("sessionCursor").toLongLong();
+            } else {
+                tab.cursor = editor->textCursor().position();
+                tab.hasText = tab.filePath.isEmpty() || editor->document()->isModified();
             }
-            settings->setValue("filePath", filePath);
-            settings->setValue("content", editor->toPlainText());
+            if (tab.filePath.isEmpty() && editor->document()->isEmpty()) continue;
         }
+        LargeFileEditor *largeFileEditor = qobject_cast<LargeFileEditor*>(widget);
+        if (largeFileEditor) {
+            tab.filePath = largeFileEditor->filePath();
+            tab.cursor = largeFileEditor->cursorPosition();
+        }
+        if (!editor && !largeFileEditor) continue;
+        if (!tab.hasText && tab.filePath.isEmpty()) continue;
+        
+        tab.id = sessionId(widget);
+        if (!tab.filePath.isEmpty()) {
+            tab.modifiedTime = QFileInfo(tab.filePath).lastModified().toMSecsSinceEpoch();
+        }
+        if (tab.hasText && sessionStore->needsText(tab)) {
+            tab.text = editor->toPlainText();
+        }
+        tabs.append(tab);
+    }
+    
+    if (sessionStore->save(tabs)) {
+        settings->remove("tabs");
     }
-    settings->endArray();
 }
 
-CodeEditor* MainWindow::createEditor()
+CodeEditor* MainWindow::createEditor(const QString &fileName)
 {
     CodeEditor *editor = new CodeEditor();
     QFont font("Monospace");
     font.setPointSize(12);
     editor->setFont(font);
-    new CppHighlighter(editor->document());
+    setEditorPath(editor, fileName);
     
     editor->setIsDarkTheme(isDarkTheme);
+    editor->setProperty("lastActive", QDateTime::currentMSecsSinceEpoch());
     
     connect(editor->document(), &QTextDocument::modificationChanged, this, &MainWindow::documentModified);
+    connect(editor, &QPlainTextEdit::cursorPositionChanged, this, &MainWindow::updateCursorPosition);
+    connect(editor->document(), &QTextDocument::contentsChanged, this, [this, editor]() {
+        queueSymbols(editor);
+    });
+    
+    return editor;
+}
+
+void MainWindow::setEditorPath(CodeEditor *editor, const QString &fileName)
+{
+    editor->setFilePath(fileName);
+    QString language = grammarRegistry->languageFor(fileName);
+    SyntaxHighlighter *highlighter = editor->findChild<SyntaxHighlighter*>(QString(), Qt::FindDirectChildrenOnly);
+    if (highlighter && editor->property("language").toString() == language) return;
+    
+    // Save As can change the language; the old highlighter goes first.
+    bool highlighted = highlighter;
+    editor->setProperty("language", language);
+    delete highlighter;
+    if (grammarRegistry->createHighlighter(language, editor) || !highlighted) return;
+    
+    // Now plain text: nothing will recolour the blocks, so they are cleared.
+    QTextDocument *document = editor->document();
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) {
+        block.layout()->clearFormats();
+        BlockData *data = static_cast<BlockData*>(block.userData());
+        if (data && !data->brackets.isEmpty()) {
+            data->brackets.clear();
+            editor->structureIndex()->update(block);
+        }
+    }
+    document->markContentsDirty(0, document->characterCount());
+}
+
+LargeFileEditor* MainWindow::createLargeFileEditor()
+{
+    LargeFileEditor *editor = new LargeFileEditor();
+    editor->setIsDarkTheme(isDarkTheme);
+    
+    connect(editor, &LargeFileEditor::modificationChanged, this, &MainWindow::documentModified);
+    connect(editor, &LargeFileEditor::cursorPositionChanged, this, &MainWindow::updateCursorPosition);
+    connect(editor, &LargeFileEditor::indexingProgress, this, [this](int percent) {
+        statusBar()->showMessage(QString("Indexing lines... %1%").arg(percent));
+    });
+    connect(editor, &LargeFileEditor::statusMessage, this, [this](const QString &message) {
+        statusBar()->showMessage(message, 5000);
+    });
+    connect(editor, &LargeFileEditor::indexingFinished, this, [this]() {
+        statusBar()->showMessage("Indexing finished", 2000);
+    });
     
     return editor;
 }
 
-CodeEditor* MainWindow::currentEditor()
+QWidget* MainWindow::createFileEditor(const QString &fileName)
+{
+    qint64 threshold = settings->value("largeFileThreshold", DefaultLargeFileThreshold).toLongLong();
+    qint64 longLine = settings->value("longLineThreshold", DefaultLongLineThreshold).toLongLong();
+    if (QFileInfo(fileName).size() >= threshold || hasLongLine(fileName, longLine)) {
+        LargeFileEditor *editor = createLargeFileEditor();
+        if (!editor->loadFile(fileName)) {
+            delete editor;
+            return nullptr;
+        }
+        editor->setProperty("fileStamp", fileStamp(fileName));
+        return editor;
+    }
+    
+    if (!QFileInfo(fileName).isReadable()) {
+        return nullptr;
+    }
+    CodeEditor *editor = createEditor(fileName);
+    
+    FileLoader *loader = new FileLoader(fileName, editor);
+    connect(loader, &FileLoader::progressChanged, this, [this, editor](int percent) {
+        int index = tabWidget->indexOf(editor);
+        if (index > 0) {
+            tabWidget->setTabText(index, QString("%1 (%2%)").arg(QFileInfo(editor->filePath()).fileName()).arg(percent));
+        }
+        if (tabWidget->currentWidget() == editor) {
+            updateLoadProgress();
+        }
+    });
+    connect(loader, &FileLoader::lineCountKnown, editor, &CodeEditor::setExpectedLineCount);
+    connect(loader, &FileLoader::finished, this, [this, editor](bool completed, const QString &errorString) {
+        loadFinished(editor, completed, errorString);
+    });
+    loader->start();
+    return editor;
+}
+
+FileLoader* MainWindow::fileLoader(QWidget *editor) const
+{
+    if (!editor) return nullptr;
+    return editor->findChild<FileLoader*>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+FileFollower* MainWindow::fileFollower(QWidget *editor) const
+{
+    if (!editor) return nullptr;
+    return editor->findChild<FileFollower*>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+void MainWindow::updateLoadProgress()
+{
+    FileLoader *loader = fileLoader(tabWidget->currentWidget());
+    loadProgress->setVisible(loader != nullptr);
+    cancelLoadButton->setVisible(loader != nullptr);
+    if (loader) {
+        loadProgress->setValue(loader->progress());
+    }
+}
+
+void MainWindow::cancelLoading()
+{
+    FileLoader *loader = fileLoader(tabWidget->currentWidget());
+    if (loader) {
+        loader->cancel();
+    }
+}
+
+void MainWindow::loadFinished(CodeEditor *editor, bool completed, const QString &errorString)
+{
+    int index = tabWidget->indexOf(editor);
+    editor->setExpectedLineCount(0);
+    if (completed) {
+        if (index > 0) {
+            tabWidget->setTabText(index, QFileInfo(editor->filePath()).fileName());
+        }
+        QVariant position = editor->property("sessionCursor");
+        if (position.isValid()) {
+            QTextCursor cursor = editor->textCursor();
+            cursor.setPosition(qBound<qint64>(0, position.toLongLong(), editor->document()->characterCount() - 1));
+            editor->setTextCursor(cursor);
+            editor->setProperty("sessionCursor", QVariant());
+        }
+        QVariant scroll = editor->property("sessionScroll");
+        if (scroll.isValid()) {
+            editor->verticalScrollBar()->setValue(scroll.toInt());
+            editor->setProperty("sessionScroll", QVariant());
+        }
+        editor->setProperty("fileStamp", fileStamp(editor->filePath()));
+        QVariant line = editor->property("pendingLine");
+        if (line.isValid()) {
+            showLocation(editor, line.toInt(), editor->property("pendingColumn").toInt());
+            editor->setProperty("pendingLine", QVariant());
+            editor->setProperty("pendingColumn", QVariant());
+        }
+        queueSymbols(editor);
+    } else {
+        if (errorString.isEmpty()) {
+            statusBar()->showMessage("Loading cancelled", 2000);
+        } else {
+            statusBar()->showMessage(QString("Cannot open %1: %2").arg(editor->filePath(), errorString), 5000);
+        }
+        if (index > 0) {
+            closeTab(index);
+        }
+    }
+    updateLoadProgress();
+    updateTitle();
+}
+
+QWidget* MainWindow::currentEditor()
 {
     int currentIndex = tabWidget->currentIndex();
     if (currentIndex > 0) {
-        return qobject_cast<CodeEditor*>(tabWidget->widget(currentIndex));
+        QWidget *widget = tabWidget->widget(currentIndex);
+        if (qobject_cast<CodeEditor*>(widget) || qobject_cast<LargeFileEditor*>(widget)) {
+            return widget;
+        }
     }
     return nullptr;
 }
 
+QString MainWindow::editorFilePath(QWidget *editor) const
+{
+    CodeEditor *codeEditor = qobject_cast<CodeEditor*>(editor);
+    if (codeEditor) {
+        return codeEditor->filePath();
+    }
+    LargeFileEditor *largeFileEditor = qobject_cast<LargeFileEditor*>(editor);
+    if (largeFileEditor) {
+        return largeFileEditor->filePath();
+    }
+    return QString();
+}
+
 void MainWindow::newFile()
 {
     CodeEditor *editor = createEditor();
@@ -530,55 +1317,158 @@ void MainWindow::openFile()
 {
     QString fileName = QFileDialog::getOpenFileName(this, "Open File", "", "All Files (*)");
     if (!fileName.isEmpty()) {
-        QFile file(fileName);
-        if (file.open(QFile::ReadOnly | QFile::Text)) {
-            CodeEditor *editor = createEditor();
-            editor->setPlainText(QTextStream(&file).readAll());
-            int index = tabWidget->addTab(editor, QFileInfo(fileName).fileName());
-            tabWidget->setCurrentIndex(index);
-            setCurrentFile(fileName);
-            file.close();
+        openPath(fileName);
+    }
+}
+
+void MainWindow::openPath(const QString &fileName)
+{
+    QWidget *editor = createFileEditor(fileName);
+    if (editor) {
+        int index = tabWidget->addTab(editor, QFileInfo(fileName).fileName());
+        tabWidget->setCurrentIndex(index);
+        setCurrentFile(fileName);
+        updateWatchedFiles();
+    }
+}
+
+int MainWindow::findTab(const QString &fileName) const
+{
+    // Placeholders count too, so a hibernated tab is reused rather than
+    // opened twice.
+    QString target = QFileInfo(fileName).canonicalFilePath();
+    if (target.isEmpty()) return -1;
+    for (int i = 1; i < tabWidget->count(); ++i) {
+        QWidget *widget = tabWidget->widget(i);
+        TabPlaceholder *placeholder = qobject_cast<TabPlaceholder*>(widget);
+        QString path = placeholder ? placeholder->tab().filePath : editorFilePath(widget);
+        if (!path.isEmpty() && QFileInfo(path).canonicalFilePath() == target) return i;
+    }
+    return -1;
+}
+
+void MainWindow::openFiles(const QStringList &files)
+{
+    for (const QString &fileName : files) {
+        int found = findTab(fileName);
+        if (found > 0) {
+            tabWidget->setCurrentIndex(found);
+        } else {
+            openPath(fileName);
         }
     }
+    
+    // Files sent by another launch should be in front of the user.
+    if (isMinimized()) showNormal();
+    raise();
+    activateWindow();
+}
+
+void MainWindow::saveEditor(QWidget *editor, const QString &fileName)
+{
+    if (savingEditors.contains(editor)) {
+        statusBar()->showMessage("Save already in progress", 2000);
+        return;
+    }
+    
+    // The document holds only part of the file until the loader is done;
+    // saving it would truncate the file on disk.
+    if (fileLoader(editor)) {
+        statusBar()->showMessage("Still loading", 2000);
+        return;
+    }
+    
+    LargeFileEditor *detached = qobject_cast<LargeFileEditor*>(editor);
+    if (detached && detached->buffer()->isDetached()) {
+        statusBar()->showMessage(shrankOnDiskFormat.arg(QFileInfo(detached->filePath()).fileName()), 5000);
+        return;
+    }
+    
+    FileSaver *saver = nullptr;
+    quint64 revision = 0;
+    CodeEditor *codeEditor = qobject_cast<CodeEditor*>(editor);
+    LargeFileEditor *largeFileEditor = qobject_cast<LargeFileEditor*>(editor);
+    if (codeEditor) {
+        saver = new FileSaver(fileName, codeEditor->document()->toRawText(), this);
+        revision = codeEditor->document()->revision();
+    } else if (largeFileEditor) {
+        saver = new FileSaver(fileName, largeFileEditor->buffer()->snapshot(), this);
+        revision = largeFileEditor->buffer()->revision();
+    } else {
+        return;
+    }
+    
+    savingEditors.insert(editor);
+    QPointer<QWidget> target(editor);
+    connect(saver, &FileSaver::finished, this, [this, saver, editor, target, fileName, revision](bool saved, const QString &errorString) {
+        saver->deleteLater();
+        savingEditors.remove(editor);
+        if (!saved) {
+            statusBar()->showMessage(QString("Save failed: %1").arg(errorString), 5000);
+        } else if (target) {
+            saveCompleted(target, fileName, revision);
+        }
+    });
+    statusBar()->showMessage("Saving...");
+    saver->start();
+}
+
+void MainWindow::saveCompleted(QWidget *editor, const QString &fileName, quint64 revision)
+{
+    bool modified = true;
+    CodeEditor *codeEditor = qobject_cast<CodeEditor*>(editor);
+    if (codeEditor) {
+        setEditorPath(codeEditor, fileName);
+        if (quint64(codeEditor->document()->revision()) == revision) {
+            codeEditor->document()->setModified(false);
+        }
+        modified = codeEditor->document()->isModified();
+        queueSymbols(codeEditor);
+    }
+    LargeFileEditor *largeFileEditor = qobject_cast<LargeFileEditor*>(editor);
+    if (largeFileEditor) {
+        largeFileEditor->setFilePath(fileName);
+        if (largeFileEditor->buffer()->revision() == revision) {
+            largeFileEditor->setModified(false);
+        }
+        modified = largeFileEditor->isModified();
+    }
+    
+    int index = tabWidget->indexOf(editor);
+    if (index > 0) {
+        tabWidget->setTabText(index, QFileInfo(fileName).fileName() + (modified ? "*" : ""));
+    }
+    editor->setProperty("fileStamp", fileStamp(fileName));
+    updateWatchedFiles();
+    if (tabWidget->currentWidget() == editor) {
+        setCurrentFile(fileName);
+        outlinePanel->setFile(fileName);
+    }
+    updateTitle();
+    statusBar()->showMessage("File saved", 2000);
 }
 
 void MainWindow::saveFile()
 {
-    CodeEditor *editor = currentEditor();
-    if (!editor) return;
+    QWidget *editor = currentEditor();
+    // A followed tab mirrors its file, possibly without its first lines.
+    if (!editor || fileFollower(editor)) return;
     
     if (currentFile.isEmpty()) {
         saveAsFile();
     } else {
-        QFile file(currentFile);
-        if (file.open(QFile::WriteOnly | QFile::Text)) {
-            QTextStream out(&file);
-            out << editor->toPlainText();
-            file.close();
-            editor->document()->setModified(false);
-            tabWidget->setTabText(tabWidget->currentIndex(), QFileInfo(currentFile).fileName());
-            statusBar()->showMessage("File saved", 2000);
-        }
+        saveEditor(editor, currentFile);
     }
 }
 
 void MainWindow::saveAsFile()
 {
-    CodeEditor *editor = currentEditor();
-    if (!editor) return;
+    QWidget *editor = currentEditor();
+    if (!editor || fileFollower(editor)) return;
     
     QString fileName = QFileDialog::getSaveFileName(this, "Save File", "", "All Files (*)");
     if (!fileName.isEmpty()) {
-        QFile file(fileName);
-        if (file.open(QFile::WriteOnly | QFile::Text)) {
-            QTextStream out(&file);
-            out << editor->toPlainText();
-            file.close();
-            setCurrentFile(fileName);
-            tabWidget->setTabText(tabWidget->currentIndex(), QFileInfo(fileName).fileName());
-            editor->document()->setModified(false);
-            statusBar()->showMessage("File saved", 2000);
-        }
+        saveEditor(editor, fileName);
     }
 }
 
@@ -587,42 +1477,356 @@ void MainWindow::closeTab(int index)
     if (index == 0) return;
     
     QWidget *widget = tabWidget->widget(index);
+    CodeEditor *editor = qobject_cast<CodeEditor*>(widget);
+    if (editor && editor->document()->isModified() && SymbolIndex::isSource(editor->filePath())) {
+        // Unsaved edits leave the index with the file as it is on disk.
+        symbolIndex->updateFile(editor->filePath());
+    }
     if (widget) {
         tabWidget->removeTab(index);
         widget->deleteLater();
     }
+    updateWatchedFiles();
     updateTitle();
 }
 
 void MainWindow::currentTabChanged(int index)
 {
+    if (materializing) return;
+    while (qobject_cast<TabPlaceholder*>(tabWidget->currentWidget())) {
+        materializeTab(tabWidget->currentIndex());
+    }
+    index = tabWidget->currentIndex();
     if (index > 0) {
-        CodeEditor *editor = qobject_cast<CodeEditor*>(tabWidget->widget(index));
-        if (editor) {
-            QString tabText = tabWidget->tabText(index);
-            if (tabText.endsWith("*")) {
-                currentFile = "";
-            } else {
-                for (int i = 1; i < tabWidget->count(); ++i) {
-                    if (i == index) {
-                        currentFile = tabText;
-                        break;
-                    }
-                }
+        currentFile = editorFilePath(tabWidget->widget(index));
+        tabWidget->widget(index)->setProperty("lastActive", QDateTime::currentMSecsSinceEpoch());
+        prefetchTimer->start();
+    }
+    outlinePanel->setFile(index > 0 ? currentFile : QString());
+    // Only text tabs can follow. A large-file tab cannot append to its
+    // piece table while the file is indexed, and its appended bytes would
+    // stay in memory; unmodified, it maps the file afresh when it changes.
+    CodeEditor *codeEditor = qobject_cast<CodeEditor*>(currentEditor());
+    followAct->setEnabled(codeEditor && !codeEditor->filePath().isEmpty());
+    followAct->setChecked(fileFollower(codeEditor) != nullptr);
+    updateLoadProgress();
+    updateCursorPosition();
+    updateTitle();
+}
+
+void MainWindow::goToLine()
+{
+    QWidget *editor = currentEditor();
+    CodeEditor *codeEditor = qobject_cast<CodeEditor*>(editor);
+    LargeFileEditor *largeFileEditor = qobject_cast<LargeFileEditor*>(editor);
+    if (!codeEditor && !largeFileEditor) return;
+    
+    int current = 1;
+    int lines = 1;
+    if (codeEditor) {
+        current = codeEditor->textCursor().blockNumber() + 1;
+        lines = codeEditor->document()->blockCount();
+    } else {
+        current = int(qMin<qint64>(largeFileEditor->cursorLine() + 1, INT_MAX));
+        lines = int(qMin<qint64>(largeFileEditor->buffer()->lineCount(), INT_MAX));
+    }
+    
+    bool ok = false;
+    int line = QInputDialog::getInt(this, goToLineAct->text(), goToLineFormat.arg(lines),
+                                    current, 1, lines, 1, &ok);
+    if (!ok) return;
+    
+    showLocation(editor, line - 1, 0);
+}
+
+void MainWindow::showLocation(QWidget *editor, qint64 line, int column)
+{
+    // Both editors find a line through an index (the block map or the
+    // piece table line counts), so the jump does not depend on file size.
+    CodeEditor *codeEditor = qobject_cast<CodeEditor*>(editor);
+    LargeFileEditor *largeFileEditor = qobject_cast<LargeFileEditor*>(editor);
+    if (codeEditor) {
+        QTextBlock block = codeEditor->document()->findBlockByNumber(int(qMin<qint64>(line, INT_MAX)));
+        if (!block.isValid()) block = codeEditor->document()->lastBlock();
+        QTextCursor cursor(block);
+        cursor.setPosition(block.position() + qBound(0, column, block.length() - 1));
+        codeEditor->setTextCursor(cursor);
+        codeEditor->centerCursor();
+        codeEditor->setFocus();
+    } else if (largeFileEditor) {
+        largeFileEditor->goToLine(line);
+        largeFileEditor->setFocus();
+    }
+}
+
+void MainWindow::openLocation(const QString &fileName, int line, int column)
+{
+    QString target = QFileInfo(fileName).canonicalFilePath();
+    int found = findTab(fileName);
+    if (found > 0) {
+        tabWidget->setCurrentIndex(found);
+    } else {
+        openPath(fileName);
+    }
+    
+    QWidget *editor = currentEditor();
+    if (!editor || QFileInfo(editorFilePath(editor)).canonicalFilePath() != target) return;
+    if (fileLoader(editor)) {
+        editor->setProperty("pendingLine", line);
+        editor->setProperty("pendingColumn", column);
+        return;
+    }
+    showLocation(editor, line, column);
+}
+
+void MainWindow::openFolder()
+{
+    QString folder = QFileDialog::getExistingDirectory(this, openFolderAct->text(), symbolIndex->root());
+    if (folder.isEmpty()) return;
+    
+    settings->setValue("projectFolder", folder);
+    symbolIndex->setRoot(folder);
+    // Files outside the new folder left the index with the old one; open
+    // tabs go back in.
+    for (int i = 1; i < tabWidget->count(); ++i) {
+        CodeEditor *editor = qobject_cast<CodeEditor*>(tabWidget->widget(i));
+        if (editor) queueSymbols(editor);
+    }
+}
+
+void MainWindow::goToDefinition()
+{
+    CodeEditor *editor = qobject_cast<CodeEditor*>(currentEditor());
+    if (!editor) return;
+    
+    // The name under the cursor, with any "Foo::" in front of it so that
+    // members of other classes are left out.
+    QString text = editor->textCursor().block().text();
+    auto isNameChar = [&text](int i) {
+        return i >= 0 && i < text.size() && (text.at(i).isLetterOrNumber() || text.at(i) == QLatin1Char('_'));
+    };
+    int start = editor->textCursor().positionInBlock();
+    int end = start;
+    while (isNameChar(start - 1)) --start;
+    while (isNameChar(end)) ++end;
+    if (start == end) return;
+    if (start > 0 && text.at(start - 1) == QLatin1Char('~')) --start;
+    while (start >= 3 && text.at(start - 1) == QLatin1Char(':') && text.at(start - 2) == QLatin1Char(':') && isNameChar(start - 3)) {
+        start -= 2;
+        while (isNameChar(start - 1)) --start;
+    }
+    QString name = text.mid(start, end - start);
+    
+    QVector<SymbolIndex::Location> found = symbolIndex->find(name);
+    if (found.isEmpty() && name.contains("::")) {
+        found = symbolIndex->find(name.mid(name.lastIndexOf("::") + 2));
+    }
+    if (found.isEmpty()) {
+        statusBar()->showMessage(noDefinitionFormat.arg(name), 3000);
+        return;
+    }
+    int definitions = 0;
+    while (definitions < found.size() && found.at(definitions).symbol.definition) ++definitions;
+    if (definitions > 0) found.resize(definitions);
+    
+    if (found.size() == 1) {
+        openLocation(found.first().path, found.first().symbol.line, found.first().symbol.column);
+        return;
+    }
+    QMenu menu(this);
+    for (int i = 0; i < found.size() && i < 30; ++i) {
+        const SymbolIndex::Location &location = found.at(i);
+        QAction *action = menu.addAction(QString("%1 - %2:%3").arg(location.symbol.qualifiedName(), QFileInfo(location.path).fileName())
+                                         .arg(location.symbol.line + 1));
+        action->setData(i);
+    }
+    QAction *chosen = menu.exec(editor->viewport()->mapToGlobal(editor->cursorRect().bottomLeft()));
+    if (chosen) {
+        const SymbolIndex::Location &location = found.at(chosen->data().toInt());
+        openLocation(location.path, location.symbol.line, location.symbol.column);
+    }
+}
+
+void MainWindow::queueSymbols(CodeEditor *editor)
+{
+    // Edits are collected and each tab's text is taken once typing pauses.
+    if (!SymbolIndex::isSource(editor->filePath())) return;
+    if (!symbolEditors.contains(editor)) {
+        symbolEditors.append(editor);
+    }
+    symbolTimer->start();
+}
+
+void MainWindow::updateSymbols()
+{
+    for (const QPointer<CodeEditor> &editor : qAsConst(symbolEditors)) {
+        if (!editor || fileLoader(editor)) continue;
+        if (editor->document()->isModified()) {
+            symbolIndex->updateText(editor->filePath(), editor->toPlainText());
+        } else {
+            symbolIndex->updateFile(editor->filePath());
+        }
+    }
+    symbolEditors.clear();
+}
+
+void MainWindow::updateWatchedFiles()
+{
+    // Placeholders read their file when woken, so only live editors are
+    // watched.
+    QStringList files;
+    for (int i = 1; i < tabWidget->count(); ++i) {
+        QString path = editorFilePath(tabWidget->widget(i));
+        if (!path.isEmpty()) files.append(path);
+    }
+    fileWatcher->setFiles(files);
+}
+
+void MainWindow::reloadFile(const QString &fileName)
+{
+    for (int i = 1; i < tabWidget->count(); ++i) {
+        QWidget *widget = tabWidget->widget(i);
+        QString path = editorFilePath(widget);
+        if (path.isEmpty() || QFileInfo(path).absoluteFilePath() != fileName || savingEditors.contains(widget)) continue;
+        QString stamp = fileStamp(path);
+        if (widget->property("fileStamp").toString() == stamp) continue;
+        
+        CodeEditor *editor = qobject_cast<CodeEditor*>(widget);
+        LargeFileEditor *largeFileEditor = qobject_cast<LargeFileEditor*>(widget);
+        FileFollower *follower = fileFollower(editor);
+        if (follower) {
+            follower->poll();
+            continue;
+        }
+        // A mapped file that shrank is blanked past its new end before
+        // anything reads there.
+        if (largeFileEditor) largeFileEditor->buffer()->detachBeyond(QFileInfo(path).size());
+        bool modified = editor ? editor->document()->isModified() : largeFileEditor && largeFileEditor->isModified();
+        if (modified) {
+            bool detached = largeFileEditor && largeFileEditor->buffer()->isDetached();
+            statusBar()->showMessage((detached ? shrankOnDiskFormat : changedOnDiskFormat).arg(QFileInfo(fileName).fileName()), 5000);
+            continue;
+        }
+        if (editor && !fileLoader(editor)) {
+            FileReloader *reloader = editor->findChild<FileReloader*>(QString(), Qt::FindDirectChildrenOnly);
+            if (!reloader) {
+                reloader = new FileReloader(fileName, editor);
+                connect(reloader, &FileReloader::finished, editor, [editor, path]() {
+                    editor->setProperty("fileStamp", fileStamp(path));
+                });
+            }
+            reloader->start();
+        } else if (largeFileEditor) {
+            // The piece table maps the file, so it is mapped afresh, even
+            // mid-indexing; the cursor and scroll position are carried over.
+            qint64 cursor = largeFileEditor->cursorPosition();
+            int scroll = largeFileEditor->verticalScrollBar()->value();
+            if (largeFileEditor->loadFile(path)) {
+                largeFileEditor->setProperty("fileStamp", stamp);
+                largeFileEditor->setCursorPosition(cursor);
+                largeFileEditor->verticalScrollBar()->setValue(scroll);
             }
         }
     }
-    updateTitle();
+}
+
+void MainWindow::toggleFollow(bool on)
+{
+    CodeEditor *editor = qobject_cast<CodeEditor*>(currentEditor());
+    FileFollower *follower = fileFollower(editor);
+    if (!editor || editor->filePath().isEmpty() || fileLoader(editor) || on == (follower != nullptr)) {
+        followAct->setChecked(follower != nullptr);
+        return;
+    }
+    
+    if (on) {
+        if (editor->document()->isModified()) {
+            followAct->setChecked(false);
+            statusBar()->showMessage(unsavedEditsFormat.arg(QFileInfo(editor->filePath()).fileName()), 5000);
+            return;
+        }
+        // The editor holds the file as it was at the last load, save or
+        // reload, so following starts at that size and catches up first.
+        qint64 offset = editor->property("fileStamp").toString().section(':', 0, 0).toLongLong();
+        // Dropping lines at the top moves the text under recorded edits.
+        editor->undoHistory()->clear();
+        follower = new FileFollower(editor->filePath(), offset, editor);
+        follower->setMaxLines(settings->value("followMaxLines", DefaultFollowMaxLines).toInt());
+        editor->moveCursor(QTextCursor::End);
+        editor->verticalScrollBar()->setValue(editor->verticalScrollBar()->maximum());
+        follower->poll();
+        return;
+    }
+    
+    bool partial = follower->droppedLines();
+    follower->stop();
+    if (partial) {
+        // Only the last lines are left, so the tab reads its file again and
+        // ends up at the bottom as it was.
+        int index = tabWidget->indexOf(editor);
+        hibernateTab(index);
+        materializeTab(index);
+        tabWidget->setCurrentIndex(index);
+        QWidget *reopened = tabWidget->widget(index);
+        if (fileLoader(reopened)) {
+            reopened->setProperty("pendingLine", INT_MAX);
+        } else {
+            showLocation(reopened, INT_MAX, 0);
+        }
+    }
+}
+
+void MainWindow::toggleTracing(bool on)
+{
+    Tracer::setEnabled(on);
+    hud->setActive(on);
+}
+
+void MainWindow::exportTrace()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, exportTraceAct->text(), "nova-trace.json",
+                                                    "Chrome Trace (*.json)");
+    if (fileName.isEmpty()) return;
+    
+    // Spans stay in the rings after the HUD is closed, so a trace can be
+    // taken after the fact.
+    QByteArray trace = Tracer::chromeTrace();
+    QSaveFile output(fileName);
+    if (!output.open(QFile::WriteOnly) || output.write(trace) != trace.size() || !output.commit()) {
+        statusBar()->showMessage(QString("Export failed: %1").arg(output.errorString()), 5000);
+        return;
+    }
+    statusBar()->showMessage(QString("Trace written to %1").arg(fileName), 2000);
+}
+
+void MainWindow::updateCursorPosition()
+{
+    QWidget *editor = currentEditor();
+    CodeEditor *codeEditor = qobject_cast<CodeEditor*>(editor);
+    LargeFileEditor *largeFileEditor = qobject_cast<LargeFileEditor*>(editor);
+    if (codeEditor) {
+        QTextCursor cursor = codeEditor->textCursor();
+        positionLabel->setText(positionFormat.arg(cursor.blockNumber() + 1).arg(cursor.positionInBlock() + 1));
+    } else if (largeFileEditor) {
+        positionLabel->setText(positionFormat.arg(largeFileEditor->cursorLine() + 1).arg(largeFileEditor->cursorColumn() + 1));
+    }
+    positionLabel->setVisible(codeEditor || largeFileEditor);
 }
 
 void MainWindow::documentModified()
 {
-    CodeEditor *editor = qobject_cast<CodeEditor*>(sender()->parent());
+    QWidget *editor = qobject_cast<LargeFileEditor*>(sender());
+    bool modified = editor && static_cast<LargeFileEditor*>(editor)->isModified();
+    CodeEditor *codeEditor = qobject_cast<CodeEditor*>(sender()->parent());
+    if (codeEditor) {
+        editor = codeEditor;
+        modified = codeEditor->document()->isModified();
+    }
     if (editor) {
         for (int i = 1; i < tabWidget->count(); ++i) {
             if (tabWidget->widget(i) == editor) {
                 QString tabText = tabWidget->tabText(i);
-                if (editor->document()->isModified()) {
+                if (modified) {
                     if (!tabText.endsWith("*")) {
                         tabWidget->setTabText(i, tabText + "*");
                     }
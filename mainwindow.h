@@ -9,16 +9,35 @@
 #include <QStatusBar>
 #include <QSettings>
 #include <QComboBox>
-#include <QSyntaxHighlighter>
-#include <QRegularExpression>
 #include <QTextCharFormat>
 #include <QTranslator>
 #include <QCloseEvent>
 #include <QWidget>
 #include <QScrollBar>
 #include <QPainter>
+#include <QSet>
+#include <QPointer>
+#include <QFuture>
+#include "sessionstore.h"
+#include "gutterrenderer.h"
+#include "decorationlayer.h"
 
 class LineNumberArea;
+class LargeFileEditor;
+class FileLoader;
+class QTimer;
+class QProgressBar;
+class QToolButton;
+class QLabel;
+class SearchPanel;
+class SymbolIndex;
+class OutlinePanel;
+class UndoHistory;
+class FileWatcher;
+class FileFollower;
+class StructureIndex;
+class GrammarRegistry;
+class PerformanceHud;
 
 class CodeEditor : public QPlainTextEdit
 {
@@ -26,22 +45,53 @@ class CodeEditor : public QPlainTextEdit
 public:
     CodeEditor(QWidget *parent = nullptr);
     void lineNumberAreaPaintEvent(QPaintEvent *event);
+    void lineNumberAreaMousePressEvent(QMouseEvent *event);
     int lineNumberAreaWidth();
     void updateLineNumberArea();
     LineNumberArea* getLineNumberArea() { return lineNumberArea; }
     bool getIsDarkTheme() const { return isDarkTheme; }
-    void setIsDarkTheme(bool dark) { isDarkTheme = dark; }
+    void setIsDarkTheme(bool dark);
+    QString filePath() const { return path; }
+    void setFilePath(const QString &fileName) { path = fileName; }
+    int lineCount() const { return qMax(this->document()->blockCount(), expectedLines); }
+    void setExpectedLineCount(qint64 lines);
     void highlightCurrentLine();
+    DecorationLayer *decorationLayer() const { return decorations; }
+    void setDecorations(DecorationLayer::Kind kind, const QVector<DecorationLayer::Range> &ranges);
+    UndoHistory *undoHistory() const { return history; }
+    StructureIndex *structureIndex() const { return structure; }
+    void toggleFold(const QTextBlock &block);
+    qint64 memoryEstimate() const;
 
 protected:
+    void paintEvent(QPaintEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
 
 private slots:
     void updateLineNumberAreaWidth(int newBlockCount);
     void onUpdateRequest(const QRect &rect, int dy);
+    void onContentsChange(int position, int removed, int added);
+    void revealCursor();
+    void matchBrackets();
 
 private:
+    void updateBlockRow(int blockNumber);
+    void unfold(const QTextBlock &block);
+    void reveal(const QTextBlock &block);
+    void relayout(int from, int to);
+
     LineNumberArea *lineNumberArea;
+    DecorationLayer *decorations;
+    UndoHistory *history;
+    StructureIndex *structure;
+    GutterRenderer gutterRenderer;
+    QString path;
+    int expectedLines;
+    int currentBlock;
+    int revision;
+    bool bracketsMatched;
     bool isDarkTheme;
 };
 
@@ -56,33 +106,35 @@ protected:
     void paintEvent(QPaintEvent *event) override {
         codeEditor->lineNumberAreaPaintEvent(event);
     }
+    void mousePressEvent(QMouseEvent *event) override {
+        codeEditor->lineNumberAreaMousePressEvent(event);
+    }
 private:
     CodeEditor *codeEditor;
 };
 
-class CppHighlighter : public QSyntaxHighlighter
+// Stands in for a restored or hibernated tab until the tab is activated.
+// A hibernated tab whose text is not in the session file keeps it here,
+// compressed on the thread pool.
+class TabPlaceholder : public QWidget
 {
     Q_OBJECT
 public:
-    CppHighlighter(QTextDocument *parent = nullptr);
-protected:
-    void highlightBlock(const QString &text) override;
+    TabPlaceholder(const SessionStore::Tab &tab, QWidget *parent = nullptr)
+        : QWidget(parent), sessionTab(tab), packed(false), hibernated(false), scroll(-1) {}
+    const SessionStore::Tab &tab() const { return sessionTab; }
+    void hibernate(int scrollValue) { hibernated = true; scroll = scrollValue; }
+    void pack(const QString &text);
+    bool isHibernated() const { return hibernated; }
+    bool hasText() const { return packed; }
+    QString text() const;
+    int scrollValue() const { return scroll; }
 private:
-    struct HighlightingRule
-    {
-        QRegularExpression pattern;
-        QTextCharFormat format;
-    };
-    QVector<HighlightingRule> highlightingRules;
-    QRegularExpression commentStartExpression;
-    QRegularExpression commentEndExpression;
-    QTextCharFormat keywordFormat;
-    QTextCharFormat classFormat;
-    QTextCharFormat singleLineCommentFormat;
-    QTextCharFormat multiLineCommentFormat;
-    QTextCharFormat quotationFormat;
-    QTextCharFormat functionFormat;
-    QTextCharFormat numberFormat;
+    SessionStore::Tab sessionTab;
+    QFuture<QByteArray> packedText;
+    bool packed;
+    bool hibernated;
+    int scroll;
 };
 
 class MainWindow : public QMainWindow
@@ -92,6 +144,9 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
     
+public slots:
+    void openFiles(const QStringList &files);
+    
 protected:
     void closeEvent(QCloseEvent *event) override;
     
@@ -106,6 +161,19 @@ private slots:
     void changeTheme(int index);
     void updateTitle();
     void documentModified();
+    void cancelLoading();
+    void goToLine();
+    void openLocation(const QString &fileName, int line, int column);
+    void openFolder();
+    void goToDefinition();
+    void updateSymbols();
+    void updateCursorPosition();
+    void prefetchTabs();
+    void hibernateTabs();
+    void reloadFile(const QString &fileName);
+    void toggleFollow(bool on);
+    void toggleTracing(bool on);
+    void exportTrace();
     
 private:
     void setupUI();
@@ -114,26 +182,78 @@ private:
     void applyTheme(bool dark);
     void loadLanguage();
     void loadSession();
+    void loadLegacySession();
+    quint64 sessionId(QWidget *editor);
+    bool materializeTab(int index);
+    void hibernateTab(int index);
     void saveSession();
     void setCurrentFile(const QString &fileName);
-    CodeEditor* currentEditor();
-    CodeEditor* createEditor();
+    void openPath(const QString &fileName);
+    int findTab(const QString &fileName) const;
+    void showLocation(QWidget *editor, qint64 line, int column);
+    void saveEditor(QWidget *editor, const QString &fileName);
+    void saveCompleted(QWidget *editor, const QString &fileName, quint64 revision);
+    QString editorFilePath(QWidget *editor) const;
+    QWidget* currentEditor();
+    CodeEditor* createEditor(const QString &fileName = QString());
+    void setEditorPath(CodeEditor *editor, const QString &fileName);
+    LargeFileEditor* createLargeFileEditor();
+    QWidget* createFileEditor(const QString &fileName);
+    FileLoader* fileLoader(QWidget *editor) const;
+    FileFollower* fileFollower(QWidget *editor) const;
+    void updateLoadProgress();
+    void loadFinished(CodeEditor *editor, bool completed, const QString &errorString);
     void retranslateUI();
+    void queueSymbols(CodeEditor *editor);
+    void updateWatchedFiles();
     
     QTabWidget *tabWidget;
     QToolBar *mainToolBar;
     QSettings *settings;
     QTranslator *translator;
+    SessionStore *sessionStore;
+    QTimer *prefetchTimer;
+    QTimer *hibernateTimer;
+    SearchPanel *searchPanel;
+    SymbolIndex *symbolIndex;
+    OutlinePanel *outlinePanel;
+    PerformanceHud *hud;
+    FileWatcher *fileWatcher;
+    GrammarRegistry *grammarRegistry;
+    QTimer *symbolTimer;
+    QList<QPointer<CodeEditor>> symbolEditors;
     
     QComboBox *languageCombo;
     QComboBox *themeCombo;
+    QProgressBar *loadProgress;
+    QToolButton *cancelLoadButton;
+    QToolButton *traceButton;
+    QToolButton *exportTraceButton;
+    QLabel *positionLabel;
+    QString positionFormat;
+    QString noDefinitionFormat;
+    QString changedOnDiskFormat;
+    QString shrankOnDiskFormat;
+    QString unsavedEditsFormat;
+    QString goToLineFormat;
     
     QAction *newAct;
     QAction *openAct;
     QAction *saveAct;
     QAction *saveAsAct;
+    QAction *goToLineAct;
+    QAction *findAct;
+    QAction *replaceAct;
+    QAction *openFolderAct;
+    QAction *goToDefinitionAct;
+    QAction *outlineAct;
+    QAction *followAct;
+    QAction *traceAct;
+    QAction *exportTraceAct;
     
+    QSet<QWidget*> savingEditors;
     QString currentFile;
+    bool materializing;
     bool isDarkTheme;
 };
 
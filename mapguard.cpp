@@ -0,0 +1,129 @@
+#include "mapguard.h"
+#include <QAtomicInteger>
+
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+// The handler may run on any thread at any time, so regions live in a
+// fixed table of atomics rather than behind a lock.
+const int MaxRegions = 64;
+
+struct Region
+{
+    QAtomicInteger<quintptr> begin;
+    QAtomicInteger<quintptr> end;
+    QAtomicInt detached;
+};
+
+Region regions[MaxRegions];
+struct sigaction previous;
+quintptr pageSize = 0;
+bool installed = false;
+
+Region *find(quintptr address)
+{
+    for (Region &region : regions) {
+        quintptr begin = region.begin.loadAcquire();
+        if (begin && address >= begin && address < region.end.loadAcquire()) return &region;
+    }
+    return nullptr;
+}
+
+bool blank(Region *region, quintptr from)
+{
+    quintptr start = from & ~(pageSize - 1);
+    quintptr end = (region->end.loadAcquire() + pageSize - 1) & ~(pageSize - 1);
+    if (start < end && mmap(reinterpret_cast<void *>(start), end - start, PROT_READ,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        return false;
+    }
+    region->detached.storeRelease(1);
+    return true;
+}
+
+void onBusError(int, siginfo_t *info, void *)
+{
+    Region *region = find(quintptr(info->si_addr));
+    if (region && blank(region, quintptr(info->si_addr))) return;
+
+    // Not one of ours: the faulting read runs again under the previous
+    // disposition.
+    sigaction(SIGBUS, &previous, nullptr);
+}
+
+void install()
+{
+    if (installed) return;
+    installed = true;
+    pageSize = quintptr(sysconf(_SC_PAGESIZE));
+    struct sigaction action = {};
+    action.sa_sigaction = onBusError;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGBUS, &action, &previous);
+}
+
+}
+
+bool MapGuard::add(const char *data, qint64 size)
+{
+    install();
+    // Folder search workers add mappings concurrently, so a free slot is
+    // claimed first; a claimed slot with no end matches no address.
+    for (Region &region : regions) {
+        if (!region.begin.testAndSetOrdered(0, 1)) continue;
+        region.detached.storeRelease(0);
+        region.end.storeRelease(quintptr(data) + quintptr(size));
+        region.begin.storeRelease(quintptr(data));
+        return true;
+    }
+    return false;
+}
+
+void MapGuard::remove(const char *data)
+{
+    Region *region = find(quintptr(data));
+    if (!region) return;
+    region->end.storeRelease(0);
+    region->begin.storeRelease(0);
+}
+
+void MapGuard::detach(const char *data, qint64 offset)
+{
+    // Whole pages only: the one holding the new end of file still reads
+    // back from the file.
+    Region *region = find(quintptr(data));
+    if (region) blank(region, (quintptr(data) + quintptr(offset) + pageSize - 1) & ~(pageSize - 1));
+}
+
+bool MapGuard::isDetached(const char *data)
+{
+    Region *region = find(quintptr(data));
+    return region && region->detached.loadAcquire();
+}
+
+#else
+
+bool MapGuard::add(const char *, qint64)
+{
+    return true;
+}
+
+void MapGuard::remove(const char *)
+{
+}
+
+void MapGuard::detach(const char *, qint64)
+{
+}
+
+bool MapGuard::isDetached(const char *)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MAPGUARD_H
+#define MAPGUARD_H
+
+#include <QtGlobal>
+
+// Keeps a file that shrinks while it is memory-mapped from taking the
+// process down. Reading a mapped page past the new end of the file raises
+// SIGBUS; for a registered mapping the handler puts blank pages over the
+// rest of it instead, so the read returns zeros, and marks the mapping
+// detached. Callers then know the mapped bytes no longer match any file.
+// Elsewhere the signal keeps its previous disposition. A no-op where the
+// system does not let a mapped file shrink.
+class MapGuard
+{
+public:
+    // False when the table of guarded mappings is full.
+    static bool add(const char *data, qint64 size);
+    static void remove(const char *data);
+
+    // Blanks the mapping at data from offset on, for a file found shorter
+    // than it was before anything read past its end.
+    static void detach(const char *data, qint64 offset);
+    static bool isDetached(const char *data);
+};
+
+#endif
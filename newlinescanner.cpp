@@ -0,0 +1,154 @@
+#include "newlinescanner.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NOVA_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+qint64 countScalar(const char *data, qint64 length)
+{
+    qint64 count = 0;
+    const char *p = data;
+    const char *end = data + length;
+    while (p < end) {
+        p = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+        if (!p) break;
+        ++count;
+        ++p;
+    }
+    return count;
+}
+
+qint64 findScalar(const char *data, qint64 length, qint64 &n)
+{
+    const char *p = data;
+    const char *end = data + length;
+    while (p < end) {
+        p = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+        if (!p) break;
+        if (--n == 0) return p - data;
+        ++p;
+    }
+    return -1;
+}
+
+#ifdef NOVA_X86_SIMD
+// Returns the index of the n-th set bit of mask; mask has at least n bits.
+inline int nthBit(quint32 mask, qint64 n)
+{
+    while (--n > 0) mask &= mask - 1;
+    return __builtin_ctz(mask);
+}
+
+// Compare results are subtracted into per-byte counters, which are summed
+// with SAD before they can overflow (255 rounds).
+__attribute__((target("sse2")))
+qint64 countSse2(const char *data, qint64 length)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    qint64 count = 0;
+    qint64 i = 0;
+    while (i + 16 <= length) {
+        __m128i counters = zero;
+        for (int round = 0; round < 255 && i + 16 <= length; ++round, i += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(bytes, newline));
+        }
+        __m128i sums = _mm_sad_epu8(counters, zero);
+        count += _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+    }
+    return count + countScalar(data + i, length - i);
+}
+
+__attribute__((target("sse2")))
+qint64 findSse2(const char *data, qint64 length, qint64 &n)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    qint64 i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        quint32 mask = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+        int found = __builtin_popcount(mask);
+        if (found >= n) return i + nthBit(mask, n);
+        n -= found;
+    }
+    qint64 pos = findScalar(data + i, length - i, n);
+    return pos < 0 ? -1 : i + pos;
+}
+
+__attribute__((target("avx2,popcnt")))
+qint64 countAvx2(const char *data, qint64 length)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    qint64 count = 0;
+    qint64 i = 0;
+    while (i + 32 <= length) {
+        __m256i counters = zero;
+        for (int round = 0; round < 255 && i + 32 <= length; ++round, i += 32) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(bytes, newline));
+        }
+        quint64 lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), _mm256_sad_epu8(counters, zero));
+        count += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return count + countSse2(data + i, length - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+qint64 findAvx2(const char *data, qint64 length, qint64 &n)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    qint64 i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        quint32 mask = quint32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)));
+        int found = __builtin_popcount(mask);
+        if (found >= n) return i + nthBit(mask, n);
+        n -= found;
+    }
+    qint64 pos = findSse2(data + i, length - i, n);
+    return pos < 0 ? -1 : i + pos;
+}
+#endif
+
+struct Implementation
+{
+    qint64 (*count)(const char *, qint64);
+    qint64 (*find)(const char *, qint64, qint64 &);
+};
+
+Implementation selectImplementation()
+{
+#ifdef NOVA_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {countAvx2, findAvx2};
+    if (__builtin_cpu_supports("sse2")) return {countSse2, findSse2};
+#endif
+    return {countScalar, findScalar};
+}
+
+const Implementation &implementation()
+{
+    static const Implementation selected = selectImplementation();
+    return selected;
+}
+
+}
+
+qint64 NewlineScanner::count(const char *data, qint64 length)
+{
+    if (length <= 0) return 0;
+    return implementation().count(data, length);
+}
+
+qint64 NewlineScanner::find(const char *data, qint64 length, qint64 &n)
+{
+    if (length <= 0 || n <= 0) return -1;
+    return implementation().find(data, length, n);
+}
@@ -0,0 +1,19 @@
+#ifndef NEWLINESCANNER_H
+#define NEWLINESCANNER_H
+
+#include <QtGlobal>
+
+// Vectorised line feed search. Uses AVX2 when the CPU has it, SSE2 on other
+// x86 machines and a plain loop elsewhere; the choice is made once at
+// startup.
+class NewlineScanner
+{
+public:
+    static qint64 count(const char *data, qint64 length);
+
+    // Returns the offset of the n-th line feed (n >= 1) in data, or -1 after
+    // subtracting the line feeds that were found from n.
+    static qint64 find(const char *data, qint64 length, qint64 &n);
+};
+
+#endif
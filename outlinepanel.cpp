@@ -0,0 +1,86 @@
+#include "outlinepanel.h"
+#include "symbolindex.h"
+#include <QHash>
+#include <QHeaderView>
+#include <QTreeWidget>
+
+OutlinePanel::OutlinePanel(SymbolIndex *index, QWidget *parent) : QDockWidget(parent), index(index)
+{
+    setObjectName("outlinePanel");
+    setFeatures(QDockWidget::DockWidgetClosable | QDockWidget::DockWidgetMovable);
+
+    tree = new QTreeWidget(this);
+    tree->setColumnCount(2);
+    tree->setHeaderHidden(true);
+    tree->setUniformRowHeights(true);
+    tree->header()->setStretchLastSection(false);
+    tree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    tree->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    setWidget(tree);
+
+    connect(index, &SymbolIndex::fileUpdated, this, &OutlinePanel::fileUpdated);
+    connect(tree, &QTreeWidget::itemActivated, this, &OutlinePanel::openItem);
+    connect(tree, &QTreeWidget::itemClicked, this, &OutlinePanel::openItem);
+    connect(this, &QDockWidget::visibilityChanged, this, [this](bool visible) {
+        if (visible) rebuild();
+    });
+
+    setLanguage("en");
+}
+
+void OutlinePanel::setFile(const QString &fileName)
+{
+    QString absolute = fileName.isEmpty() ? QString() : SymbolIndex::key(fileName);
+    if (absolute == path) return;
+    path = absolute;
+    rebuild();
+}
+
+void OutlinePanel::setLanguage(const QString &language)
+{
+    if (language == "ru") {
+        setWindowTitle("Структура");
+        kindNames = QStringList{"пространство имён", "класс", "структура", "объединение", "перечисление", "функция", "макрос"};
+    } else {
+        setWindowTitle("Outline");
+        kindNames = QStringList{"namespace", "class", "struct", "union", "enum", "function", "macro"};
+    }
+    rebuild();
+}
+
+void OutlinePanel::fileUpdated(const QString &fileName)
+{
+    if (fileName == path) rebuild();
+}
+
+void OutlinePanel::rebuild()
+{
+    if (!isVisible()) return;
+    tree->clear();
+    if (path.isEmpty()) return;
+
+    // Symbols come in file order, so a namespace or class is always listed
+    // before its members.
+    const QVector<SymbolIndex::Symbol> symbols = index->symbols(path);
+    QHash<QString, QTreeWidgetItem*> containers;
+    for (const SymbolIndex::Symbol &symbol : symbols) {
+        QTreeWidgetItem *parent = containers.value(symbol.scope);
+        QString name = parent ? symbol.name : symbol.qualifiedName();
+        QTreeWidgetItem *item = parent ? new QTreeWidgetItem(parent) : new QTreeWidgetItem(tree);
+        item->setText(0, name);
+        item->setText(1, kindNames.value(symbol.kind));
+        item->setData(0, Qt::UserRole, symbol.line);
+        item->setData(0, Qt::UserRole + 1, symbol.column);
+        if (symbol.kind != SymbolIndex::Function && symbol.kind != SymbolIndex::Macro && symbol.definition
+            && !containers.contains(symbol.qualifiedName())) {
+            containers.insert(symbol.qualifiedName(), item);
+        }
+    }
+    tree->expandAll();
+}
+
+void OutlinePanel::openItem(QTreeWidgetItem *item)
+{
+    if (!item || path.isEmpty()) return;
+    emit locationRequested(path, item->data(0, Qt::UserRole).toInt(), item->data(0, Qt::UserRole + 1).toInt());
+}
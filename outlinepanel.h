@@ -0,0 +1,38 @@
+#ifndef OUTLINEPANEL_H
+#define OUTLINEPANEL_H
+
+#include <QDockWidget>
+#include <QStringList>
+
+class SymbolIndex;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Symbols of the current tab's file as the index has them, nested under
+// the namespaces and classes they belong to. Rebuilt only while visible.
+class OutlinePanel : public QDockWidget
+{
+    Q_OBJECT
+public:
+    OutlinePanel(SymbolIndex *index, QWidget *parent = nullptr);
+
+    void setFile(const QString &path);
+    void setLanguage(const QString &language);
+
+signals:
+    void locationRequested(const QString &fileName, int line, int column);
+
+private slots:
+    void fileUpdated(const QString &path);
+    void openItem(QTreeWidgetItem *item);
+
+private:
+    void rebuild();
+
+    SymbolIndex *index;
+    QTreeWidget *tree;
+    QString path;
+    QStringList kindNames;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "performancehud.h"
+#include "largefileeditor.h"
+#include "mainwindow.h"
+#include "tracer.h"
+#include <QApplication>
+#include <QEvent>
+#include <QKeyEvent>
+#include <QTimer>
+
+const char *const PerformanceHud::FrameSpan = "Paint";
+const char *const PerformanceHud::KeyPressSpan = "Key press";
+const char *const PerformanceHud::KeystrokeSpan = "Keystroke to paint";
+
+namespace {
+
+QString milliseconds(qint64 nanoseconds)
+{
+    return QString::number(double(nanoseconds) / 1000000, 'f', 1);
+}
+
+}
+
+PerformanceHud::PerformanceHud(QWidget *parent)
+    : QLabel(parent), cursor(0), keyPressedAt(0), lastRefresh(0)
+{
+    timer = new QTimer(this);
+    timer->setInterval(RefreshMsecs);
+    connect(timer, &QTimer::timeout, this, &PerformanceHud::refresh);
+
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setStyleSheet("QLabel { background-color: rgba(0, 0, 0, 170); color: #50fa7b; padding: 6px;"
+                  " font-family: Monospace; }");
+    hide();
+}
+
+void PerformanceHud::setActive(bool on)
+{
+    if (on == timer->isActive()) return;
+    if (!on) {
+        timer->stop();
+        qApp->removeEventFilter(this);
+        hide();
+        return;
+    }
+
+    // Only what happens from now on is shown.
+    Tracer::threadEvents(cursor);
+    keyPressedAt = 0;
+    lastRefresh = Tracer::now();
+    qApp->installEventFilter(this);
+    timer->start();
+    refresh();
+    show();
+}
+
+bool PerformanceHud::eventFilter(QObject *watched, QEvent *event)
+{
+    // Only keys an editor receives are marked, bare modifiers excepted: the
+    // others paint nothing, and the frame taken as their answer would be
+    // the next cursor blink. The HUD keeps a press until a frame answers it.
+    if (event->type() == QEvent::KeyPress && Tracer::isEnabled()
+        && (qobject_cast<CodeEditor*>(watched) || qobject_cast<LargeFileEditor*>(watched))) {
+        int key = static_cast<QKeyEvent*>(event)->key();
+        if (key != Qt::Key_Shift && key != Qt::Key_Control && key != Qt::Key_Alt && key != Qt::Key_AltGr
+            && key != Qt::Key_Meta) {
+            qint64 now = Tracer::now();
+            Tracer::record(KeyPressSpan, now, now);
+        }
+    }
+    return QLabel::eventFilter(watched, event);
+}
+
+void PerformanceHud::refresh()
+{
+    qint64 frames = 0;
+    qint64 frameTotal = 0;
+    qint64 frameMax = 0;
+    qint64 keys = 0;
+    qint64 keyTotal = 0;
+    qint64 keyMax = 0;
+    const QVector<Tracer::Event> events = Tracer::threadEvents(cursor);
+    for (const Tracer::Event &event : events) {
+        if (event.name == KeyPressSpan) {
+            if (!keyPressedAt) keyPressedAt = event.start;
+        } else if (event.name == FrameSpan) {
+            qint64 duration = event.end - event.start;
+            ++frames;
+            frameTotal += duration;
+            frameMax = qMax(frameMax, duration);
+            if (keyPressedAt && event.end >= keyPressedAt) {
+                qint64 latency = event.end - keyPressedAt;
+                ++keys;
+                keyTotal += latency;
+                keyMax = qMax(keyMax, latency);
+                Tracer::record(KeystrokeSpan, keyPressedAt, event.end);
+                keyPressedAt = 0;
+            }
+        }
+    }
+    // The spans just recorded are not read back as input.
+    Tracer::threadEvents(cursor);
+
+    qint64 now = Tracer::now();
+    double seconds = qMax<qint64>(1, now - lastRefresh) / 1e9;
+    lastRefresh = now;
+
+    QString text = QString("Frame      avg %1 ms  max %2 ms  %3 fps")
+        .arg(milliseconds(frames ? frameTotal / frames : 0), milliseconds(frameMax))
+        .arg(QString::number(frames / seconds, 'f', 0));
+    text += QString("\nKey→paint  avg %1 ms  max %2 ms")
+        .arg(milliseconds(keys ? keyTotal / keys : 0), milliseconds(keyMax));
+    setText(text);
+    adjustSize();
+    if (parentWidget()) move(parentWidget()->width() - width() - 8, 8);
+    raise();
+}
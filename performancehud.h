@@ -0,0 +1,41 @@
+#ifndef PERFORMANCEHUD_H
+#define PERFORMANCEHUD_H
+
+#include <QLabel>
+
+class QTimer;
+
+// Frame time and keystroke-to-paint latency over the top-right corner of
+// its parent. Both come from the GUI thread's trace ring: editors trace
+// their paint events, and while the HUD is shown an application event
+// filter marks the key presses editors receive. A key press is answered by
+// the first frame that ends after it, which is also added to the trace as
+// a span.
+class PerformanceHud : public QLabel
+{
+    Q_OBJECT
+public:
+    static const char *const FrameSpan;
+    static const char *const KeyPressSpan;
+    static const char *const KeystrokeSpan;
+
+    explicit PerformanceHud(QWidget *parent);
+
+    void setActive(bool on);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void refresh();
+
+private:
+    static const int RefreshMsecs = 500;
+
+    QTimer *timer;
+    quint64 cursor;
+    qint64 keyPressedAt;
+    qint64 lastRefresh;
+};
+
+#endif
@@ -0,0 +1,587 @@
+#include "piecetable.h"
+#include "mapguard.h"
+#include <QFile>
+#include <QIODevice>
+
+static const qint64 WriteChunkSize = 1024 * 1024;
+
+static bool writeSpan(QIODevice *device, const char *data, qint64 length)
+{
+    while (length > 0) {
+        qint64 written = device->write(data, qMin(length, WriteChunkSize));
+        if (written <= 0) return false;
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+PieceTable::Buffer::~Buffer()
+{
+    if (mappedFile) {
+        MapGuard::remove(mapped);
+        mappedFile->close();
+        delete mappedFile;
+    }
+}
+
+qint64 PieceTable::Snapshot::size() const
+{
+    qint64 total = 0;
+    for (const Span &span : pieces) {
+        total += span.length;
+    }
+    return total;
+}
+
+bool PieceTable::Snapshot::isDetached() const
+{
+    return !buffers.isEmpty() && buffers.first()->mapped && MapGuard::isDetached(buffers.first()->mapped);
+}
+
+bool PieceTable::Snapshot::writeTo(QIODevice *device) const
+{
+    for (const Span &span : pieces) {
+        if (!writeSpan(device, span.data, span.length)) return false;
+    }
+    return true;
+}
+
+PieceTable::PieceTable()
+    : root(nullptr), editRevision(0), indexing(false), done(0), cleanStep(0), sealed(true), randomState(0x9e3779b9u)
+{
+    setData(QByteArray());
+}
+
+PieceTable::~PieceTable()
+{
+    reset();
+}
+
+void PieceTable::reset()
+{
+    destroy(root);
+    root = nullptr;
+    buffers.clear();
+    indexing = false;
+    ++editRevision;
+    edits.clear();
+    done = 0;
+    cleanStep = 0;
+    sealed = true;
+}
+
+bool PieceTable::load(const QString &fileName, QString *errorString)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        if (errorString) *errorString = file.errorString();
+        return false;
+    }
+    setData(file.readAll());
+    file.close();
+    return true;
+}
+
+bool PieceTable::map(const QString &fileName, QString *errorString)
+{
+    QFile *file = new QFile(fileName);
+    uchar *address = nullptr;
+    if (file->open(QFile::ReadOnly) && file->size() > 0) {
+        address = file->map(0, file->size());
+    }
+    if (!address) {
+        if (errorString) *errorString = file->errorString();
+        delete file;
+        return false;
+    }
+
+    reset();
+
+    QSharedPointer<Buffer> original(new Buffer);
+    original->mapped = reinterpret_cast<const char *>(address);
+    original->mappedSize = file->size();
+    original->mappedFile = file;
+    buffers.append(original);
+    MapGuard::add(original->mapped, original->mappedSize);
+
+    // Line feeds are filled in by appendIndexedChunks() while a LineIndexer
+    // scans the mapping; until finishIndexing() the table stays read-only.
+    root = createNode(0, 0, original->mappedSize);
+    indexing = true;
+    return true;
+}
+
+void PieceTable::setData(const QByteArray &data)
+{
+    reset();
+
+    QSharedPointer<Buffer> original(new Buffer);
+    original->storage = data;
+    original->index.build(original->data(), original->size());
+    buffers.append(original);
+
+    if (!data.isEmpty()) {
+        root = createNode(0, 0, data.size());
+    }
+}
+
+void PieceTable::appendIndexedChunks(const QVector<qint64> &chunkLineFeeds)
+{
+    if (!indexing) return;
+    buffers.first()->index.appendChunks(chunkLineFeeds);
+    root->lineFeeds = buffers.first()->index.lineFeeds();
+    update(root);
+}
+
+void PieceTable::finishIndexing()
+{
+    if (!indexing) return;
+    Buffer *original = buffers.first().data();
+    original->index.extend(original->data(), original->size());
+    root->lineFeeds = original->index.lineFeeds();
+    update(root);
+    indexing = false;
+}
+
+void PieceTable::detachBeyond(qint64 fileSize)
+{
+    const Buffer *original = buffers.first().data();
+    if (original->mapped && fileSize < original->mappedSize) MapGuard::detach(original->mapped, fileSize);
+}
+
+bool PieceTable::isDetached() const
+{
+    const Buffer *original = buffers.first().data();
+    return original->mapped && MapGuard::isDetached(original->mapped);
+}
+
+bool PieceTable::writeTo(QIODevice *device) const
+{
+    return writeNode(root, device);
+}
+
+PieceTable::Snapshot PieceTable::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.buffers = buffers;
+    collectSpans(root, snapshot.pieces);
+    return snapshot;
+}
+
+qint64 PieceTable::size() const
+{
+    return subtreeLength(root);
+}
+
+qint64 PieceTable::lineCount() const
+{
+    return subtreeLineFeeds(root) + 1;
+}
+
+qint64 PieceTable::lineStart(qint64 line) const
+{
+    if (line <= 0) return 0;
+
+    qint64 offset = 0;
+    qint64 remaining = line;
+    const Node *node = root;
+    while (node) {
+        qint64 leftLineFeeds = subtreeLineFeeds(node->left);
+        if (remaining <= leftLineFeeds) {
+            node = node->left;
+        } else if (remaining <= leftLineFeeds + node->lineFeeds) {
+            const Buffer *buffer = buffers.at(node->buffer).data();
+            qint64 feed = buffer->index.findLineFeed(buffer->data(), node->start, remaining - leftLineFeeds);
+            return offset + subtreeLength(node->left) + (feed - node->start) + 1;
+        } else {
+            remaining -= leftLineFeeds + node->lineFeeds;
+            offset += subtreeLength(node->left) + node->length;
+            node = node->right;
+        }
+    }
+    return size();
+}
+
+qint64 PieceTable::lineEnd(qint64 line) const
+{
+    if (line + 1 >= lineCount()) return indexing ? indexedSize() : size();
+    return lineStart(line + 1) - 1;
+}
+
+qint64 PieceTable::lineAt(qint64 pos) const
+{
+    qint64 lines = 0;
+    qint64 remaining = qBound<qint64>(0, pos, size());
+    const Node *node = root;
+    while (node) {
+        qint64 leftLength = subtreeLength(node->left);
+        if (remaining < leftLength) {
+            node = node->left;
+            continue;
+        }
+        lines += subtreeLineFeeds(node->left);
+        remaining -= leftLength;
+        if (remaining < node->length) {
+            const Buffer *buffer = buffers.at(node->buffer).data();
+            return lines + buffer->index.countLineFeeds(buffer->data(), node->start, node->start + remaining);
+        }
+        lines += node->lineFeeds;
+        remaining -= node->length;
+        node = node->right;
+    }
+    return lines;
+}
+
+QByteArray PieceTable::text(qint64 pos, qint64 length) const
+{
+    QByteArray out;
+    pos = qBound<qint64>(0, pos, size());
+    length = qBound<qint64>(0, length, size() - pos);
+    out.reserve(length);
+    collect(root, pos, length, out);
+    return out;
+}
+
+QByteArray PieceTable::line(qint64 line) const
+{
+    qint64 start = lineStart(line);
+    QByteArray bytes = text(start, lineEnd(line) - start);
+    if (bytes.endsWith('\r')) bytes.chop(1);
+    return bytes;
+}
+
+void PieceTable::insert(qint64 pos, const QByteArray &text)
+{
+    if (text.isEmpty() || indexing) return;
+    pos = qBound<qint64>(0, pos, size());
+
+    qint64 start = 0;
+    int buffer = appendToAddBuffer(text, start);
+    const Buffer *added = buffers.at(buffer).data();
+    qint64 lineFeeds = added->index.countLineFeeds(added->data(), start, start + text.size());
+
+    ++editRevision;
+    record(pos, QVector<Piece>(), QVector<Piece>{Piece{buffer, start, qint64(text.size()), lineFeeds}});
+    if (extendPiece(root, pos, buffer, start, text.size(), lineFeeds)) return;
+
+    Node *left = nullptr;
+    Node *right = nullptr;
+    split(root, pos, left, right);
+    root = merge(merge(left, createNode(buffer, start, text.size())), right);
+}
+
+void PieceTable::remove(qint64 pos, qint64 length)
+{
+    pos = qBound<qint64>(0, pos, size());
+    length = qBound<qint64>(0, length, size() - pos);
+    if (length == 0 || indexing) return;
+
+    Node *left = nullptr;
+    Node *middle = nullptr;
+    Node *right = nullptr;
+    ++editRevision;
+    split(root, pos, left, middle);
+    split(middle, length, middle, right);
+    QVector<Piece> removed;
+    collectPieces(middle, removed);
+    record(pos, removed, QVector<Piece>());
+    destroy(middle);
+    root = merge(left, right);
+}
+
+bool PieceTable::undo(qint64 *position)
+{
+    if (done == 0 || indexing) return false;
+    const Edit &edit = edits.at(--done);
+    replacePieces(edit.position, piecesLength(edit.inserted), edit.removed);
+    sealed = true;
+    if (position) *position = edit.position + piecesLength(edit.removed);
+    return true;
+}
+
+bool PieceTable::redo(qint64 *position)
+{
+    if (done == edits.size() || indexing) return false;
+    const Edit &edit = edits.at(done++);
+    replacePieces(edit.position, piecesLength(edit.removed), edit.inserted);
+    sealed = true;
+    if (position) *position = edit.position + piecesLength(edit.inserted);
+    return true;
+}
+
+void PieceTable::markClean()
+{
+    cleanStep = done;
+    sealed = true;
+}
+
+void PieceTable::record(qint64 pos, const QVector<Piece> &removed, const QVector<Piece> &inserted)
+{
+    if (done < edits.size()) {
+        if (cleanStep > done) cleanStep = -1;
+        edits.resize(done);
+        sealed = true;
+    }
+
+    // Typing extends the step at its end; Backspace and Delete extend a
+    // step that only removed text at its start or end.
+    if (!sealed && done > 0) {
+        Edit &last = edits[done - 1];
+        if (removed.isEmpty() && pos == last.position + piecesLength(last.inserted)) {
+            appendPieces(last.inserted, inserted);
+            return;
+        }
+        if (inserted.isEmpty() && last.inserted.isEmpty()) {
+            if (pos + piecesLength(removed) == last.position) {
+                QVector<Piece> joined = removed;
+                appendPieces(joined, last.removed);
+                last.removed = joined;
+                last.position = pos;
+                return;
+            }
+            if (pos == last.position) {
+                appendPieces(last.removed, removed);
+                return;
+            }
+        }
+    }
+    edits.append(Edit{pos, removed, inserted});
+    ++done;
+    sealed = false;
+}
+
+void PieceTable::replacePieces(qint64 pos, qint64 length, const QVector<Piece> &pieces)
+{
+    Node *left = nullptr;
+    Node *middle = nullptr;
+    Node *right = nullptr;
+    ++editRevision;
+    split(root, pos, left, middle);
+    split(middle, length, middle, right);
+    destroy(middle);
+    for (const Piece &piece : pieces) {
+        Node *node = new Node;
+        node->left = nullptr;
+        node->right = nullptr;
+        node->priority = nextPriority();
+        node->buffer = piece.buffer;
+        node->start = piece.start;
+        node->length = piece.length;
+        node->lineFeeds = piece.lineFeeds;
+        update(node);
+        left = merge(left, node);
+    }
+    root = merge(left, right);
+}
+
+void PieceTable::appendPieces(QVector<Piece> &pieces, const QVector<Piece> &more)
+{
+    for (const Piece &piece : more) {
+        if (!pieces.isEmpty()) {
+            Piece &last = pieces.last();
+            if (last.buffer == piece.buffer && last.start + last.length == piece.start) {
+                last.length += piece.length;
+                last.lineFeeds += piece.lineFeeds;
+                continue;
+            }
+        }
+        pieces.append(piece);
+    }
+}
+
+qint64 PieceTable::piecesLength(const QVector<Piece> &pieces)
+{
+    qint64 length = 0;
+    for (const Piece &piece : pieces) {
+        length += piece.length;
+    }
+    return length;
+}
+
+PieceTable::Node *PieceTable::createNode(int buffer, qint64 start, qint64 length)
+{
+    const Buffer *source = buffers.at(buffer).data();
+    Node *node = new Node;
+    node->left = nullptr;
+    node->right = nullptr;
+    node->priority = nextPriority();
+    node->buffer = buffer;
+    node->start = start;
+    node->length = length;
+    node->lineFeeds = source->index.countLineFeeds(source->data(), start, start + length);
+    update(node);
+    return node;
+}
+
+void PieceTable::destroy(Node *node)
+{
+    if (!node) return;
+    destroy(node->left);
+    destroy(node->right);
+    delete node;
+}
+
+void PieceTable::update(Node *node)
+{
+    node->subtreeLength = subtreeLength(node->left) + node->length + subtreeLength(node->right);
+    node->subtreeLineFeeds = subtreeLineFeeds(node->left) + node->lineFeeds + subtreeLineFeeds(node->right);
+}
+
+PieceTable::Node *PieceTable::merge(Node *left, Node *right)
+{
+    if (!left) return right;
+    if (!right) return left;
+    if (left->priority > right->priority) {
+        left->right = merge(left->right, right);
+        update(left);
+        return left;
+    }
+    right->left = merge(left, right->left);
+    update(right);
+    return right;
+}
+
+void PieceTable::split(Node *node, qint64 pos, Node *&left, Node *&right)
+{
+    if (!node) {
+        left = nullptr;
+        right = nullptr;
+        return;
+    }
+
+    qint64 leftLength = subtreeLength(node->left);
+    if (pos <= leftLength) {
+        split(node->left, pos, left, node->left);
+        update(node);
+        right = node;
+    } else if (pos >= leftLength + node->length) {
+        split(node->right, pos - leftLength - node->length, node->right, right);
+        update(node);
+        left = node;
+    } else {
+        qint64 offset = pos - leftLength;
+        const Buffer *source = buffers.at(node->buffer).data();
+        qint64 headLineFeeds = source->index.countLineFeeds(source->data(), node->start, node->start + offset);
+
+        Node *tail = new Node;
+        tail->left = nullptr;
+        tail->right = nullptr;
+        tail->priority = nextPriority();
+        tail->buffer = node->buffer;
+        tail->start = node->start + offset;
+        tail->length = node->length - offset;
+        tail->lineFeeds = node->lineFeeds - headLineFeeds;
+        update(tail);
+
+        node->length = offset;
+        node->lineFeeds = headLineFeeds;
+        Node *rest = node->right;
+        node->right = nullptr;
+        update(node);
+
+        left = node;
+        right = merge(tail, rest);
+    }
+}
+
+bool PieceTable::extendPiece(Node *node, qint64 pos, int buffer, qint64 start, qint64 length, qint64 lineFeeds)
+{
+    if (!node) return false;
+
+    qint64 leftLength = subtreeLength(node->left);
+    bool extended = false;
+    if (pos <= leftLength) {
+        extended = extendPiece(node->left, pos, buffer, start, length, lineFeeds);
+    } else if (pos == leftLength + node->length) {
+        if (node->buffer == buffer && node->start + node->length == start) {
+            node->length += length;
+            node->lineFeeds += lineFeeds;
+            extended = true;
+        }
+    } else if (pos > leftLength + node->length) {
+        extended = extendPiece(node->right, pos - leftLength - node->length, buffer, start, length, lineFeeds);
+    }
+
+    if (extended) {
+        node->subtreeLength += length;
+        node->subtreeLineFeeds += lineFeeds;
+    }
+    return extended;
+}
+
+void PieceTable::collect(const Node *node, qint64 &pos, qint64 &remaining, QByteArray &out) const
+{
+    if (!node || remaining <= 0) return;
+    if (pos >= node->subtreeLength) {
+        pos -= node->subtreeLength;
+        return;
+    }
+
+    collect(node->left, pos, remaining, out);
+    if (remaining <= 0) return;
+
+    if (pos < node->length) {
+        qint64 count = qMin(node->length - pos, remaining);
+        out.append(buffers.at(node->buffer)->data() + node->start + pos, count);
+        remaining -= count;
+        pos = 0;
+    } else {
+        pos -= node->length;
+    }
+
+    collect(node->right, pos, remaining, out);
+}
+
+bool PieceTable::writeNode(const Node *node, QIODevice *device) const
+{
+    if (!node) return true;
+    if (!writeNode(node->left, device)) return false;
+
+    const char *data = buffers.at(node->buffer)->data() + node->start;
+    if (!writeSpan(device, data, node->length)) return false;
+
+    return writeNode(node->right, device);
+}
+
+void PieceTable::collectPieces(const Node *node, QVector<Piece> &pieces) const
+{
+    if (!node) return;
+    collectPieces(node->left, pieces);
+    pieces.append(Piece{node->buffer, node->start, node->length, node->lineFeeds});
+    collectPieces(node->right, pieces);
+}
+
+void PieceTable::collectSpans(const Node *node, QVector<Span> &spans) const
+{
+    if (!node) return;
+    collectSpans(node->left, spans);
+    Span span;
+    span.data = buffers.at(node->buffer)->data() + node->start;
+    span.length = node->length;
+    spans.append(span);
+    collectSpans(node->right, spans);
+}
+
+int PieceTable::appendToAddBuffer(const QByteArray &text, qint64 &start)
+{
+    Buffer *buffer = buffers.size() > 1 ? buffers.last().data() : nullptr;
+    if (!buffer || buffer->storage.size() + text.size() > buffer->storage.capacity()) {
+        buffer = new Buffer;
+        buffer->storage.reserve(int(qMax<qint64>(AddBufferCapacity, text.size())));
+        buffers.append(QSharedPointer<Buffer>(buffer));
+    }
+
+    start = buffer->storage.size();
+    buffer->storage.append(text);
+    buffer->index.extend(buffer->data(), buffer->size());
+    return buffers.size() - 1;
+}
+
+quint32 PieceTable::nextPriority()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
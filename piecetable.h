@@ -0,0 +1,171 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include "lineindex.h"
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+class QFile;
+class QIODevice;
+
+// Byte-oriented piece table. The original file and every appended edit live
+// in immutable buffers; the document is a treap of pieces pointing into them,
+// so edits and line lookups are O(log n) in the number of pieces. Undo keeps
+// the pieces each edit removed and inserted, so it copies no text.
+class PieceTable
+{
+    struct Buffer;
+
+public:
+    struct Span
+    {
+        const char *data;
+        qint64 length;
+    };
+
+    // Immutable view of the document at one point in time. It shares the
+    // underlying buffers, so taking it copies no text and it stays valid
+    // while the table keeps being edited or is destroyed.
+    class Snapshot
+    {
+    public:
+        qint64 size() const;
+        bool writeTo(QIODevice *device) const;
+        bool isDetached() const;
+        const QVector<Span> &spans() const { return pieces; }
+
+    private:
+        friend class PieceTable;
+        QVector<Span> pieces;
+        QVector<QSharedPointer<Buffer>> buffers;
+    };
+
+    PieceTable();
+    ~PieceTable();
+
+    bool load(const QString &fileName, QString *errorString = nullptr);
+    bool map(const QString &fileName, QString *errorString = nullptr);
+    void setData(const QByteArray &data);
+    bool writeTo(QIODevice *device) const;
+    Snapshot snapshot() const;
+    quint64 revision() const { return editRevision; }
+
+    // A mapped file that shrinks is blanked from its new end on (see
+    // MapGuard), either here once the change is seen or on the first read
+    // past that end. The table then no longer holds the file's text and
+    // must not be written back.
+    void detachBeyond(qint64 fileSize);
+    bool isDetached() const;
+
+    bool isIndexing() const { return indexing; }
+    const char *originalData() const { return buffers.first()->data(); }
+    qint64 originalSize() const { return buffers.first()->size(); }
+    qint64 indexedSize() const { return buffers.first()->index.size(); }
+    void appendIndexedChunks(const QVector<qint64> &chunkLineFeeds);
+    void finishIndexing();
+
+    qint64 size() const;
+    qint64 lineCount() const;
+    qint64 lineStart(qint64 line) const;
+    qint64 lineEnd(qint64 line) const;
+    qint64 lineAt(qint64 pos) const;
+    // The range has to fit in a QByteArray; callers bound what they ask
+    // for, as LargeFileEditor::copy() does.
+    QByteArray text(qint64 pos, qint64 length) const;
+    QByteArray line(qint64 line) const;
+
+    void insert(qint64 pos, const QByteArray &text);
+    void remove(qint64 pos, qint64 length);
+
+    // Edits next to the previous one join its undo step until the step is
+    // sealed. The position is where the cursor goes after undo or redo.
+    bool undo(qint64 *position = nullptr);
+    bool redo(qint64 *position = nullptr);
+    bool isUndoAvailable() const { return done > 0; }
+    bool isRedoAvailable() const { return done < edits.size(); }
+    void sealUndoStep() { sealed = true; }
+    // The current step is the one that matches the file; isClean() is
+    // true whenever undo or redo gets back to it.
+    void markClean();
+    bool isClean() const { return done == cleanStep; }
+
+private:
+    struct Buffer
+    {
+        Buffer() : mapped(nullptr), mappedSize(0), mappedFile(nullptr) {}
+        ~Buffer();
+        const char *data() const { return mapped ? mapped : storage.constData(); }
+        qint64 size() const { return mapped ? mappedSize : storage.size(); }
+
+        QByteArray storage;
+        const char *mapped;
+        qint64 mappedSize;
+        QFile *mappedFile;
+        LineIndex index;
+    };
+
+    struct Piece
+    {
+        int buffer;
+        qint64 start;
+        qint64 length;
+        qint64 lineFeeds;
+    };
+
+    struct Edit
+    {
+        qint64 position;
+        QVector<Piece> removed;
+        QVector<Piece> inserted;
+    };
+
+    struct Node
+    {
+        Node *left;
+        Node *right;
+        quint32 priority;
+        int buffer;
+        qint64 start;
+        qint64 length;
+        qint64 lineFeeds;
+        qint64 subtreeLength;
+        qint64 subtreeLineFeeds;
+    };
+
+    static const int AddBufferCapacity = 1024 * 1024;
+
+    Node *createNode(int buffer, qint64 start, qint64 length);
+    void destroy(Node *node);
+    void update(Node *node);
+    Node *merge(Node *left, Node *right);
+    void split(Node *node, qint64 pos, Node *&left, Node *&right);
+    bool extendPiece(Node *node, qint64 pos, int buffer, qint64 start, qint64 length, qint64 lineFeeds);
+    void collect(const Node *node, qint64 &pos, qint64 &remaining, QByteArray &out) const;
+    bool writeNode(const Node *node, QIODevice *device) const;
+    void collectSpans(const Node *node, QVector<Span> &spans) const;
+    void collectPieces(const Node *node, QVector<Piece> &pieces) const;
+    void replacePieces(qint64 pos, qint64 length, const QVector<Piece> &pieces);
+    void record(qint64 pos, const QVector<Piece> &removed, const QVector<Piece> &inserted);
+    static void appendPieces(QVector<Piece> &pieces, const QVector<Piece> &more);
+    static qint64 piecesLength(const QVector<Piece> &pieces);
+    int appendToAddBuffer(const QByteArray &text, qint64 &start);
+    quint32 nextPriority();
+    void reset();
+
+    static qint64 subtreeLength(const Node *node) { return node ? node->subtreeLength : 0; }
+    static qint64 subtreeLineFeeds(const Node *node) { return node ? node->subtreeLineFeeds : 0; }
+
+    QVector<QSharedPointer<Buffer>> buffers;
+    Node *root;
+    quint64 editRevision;
+    bool indexing;
+    QVector<Edit> edits;
+    int done;
+    int cleanStep;
+    bool sealed;
+    quint32 randomState;
+};
+
+#endif
@@ -0,0 +1,647 @@
+#include "searchpanel.h"
+#include "largefileeditor.h"
+#include "mainwindow.h"
+#include "newlinescanner.h"
+#include <QCheckBox>
+#include <QDir>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTabWidget>
+#include <QTextCursor>
+#include <QToolButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <QtConcurrent>
+
+SearchPanel::SearchPanel(QTabWidget *tabs, QWidget *parent)
+    : QDockWidget(parent), tabs(tabs), generation(0), running(0), replacing(false),
+      folderSearch(nullptr), folderHits(0), folderFiles(0), resultsScheduled(false)
+{
+    setObjectName("searchPanel");
+    setFeatures(QDockWidget::DockWidgetClosable | QDockWidget::DockWidgetMovable);
+
+    QWidget *content = new QWidget(this);
+    QVBoxLayout *layout = new QVBoxLayout(content);
+    layout->setContentsMargins(6, 6, 6, 6);
+
+    QHBoxLayout *fields = new QHBoxLayout();
+    findEdit = new QLineEdit(content);
+    replaceEdit = new QLineEdit(content);
+    findButton = new QPushButton(content);
+    replaceButton = new QPushButton(content);
+    fields->addWidget(findEdit, 1);
+    fields->addWidget(findButton);
+    fields->addWidget(replaceEdit, 1);
+    fields->addWidget(replaceButton);
+    layout->addLayout(fields);
+
+    QHBoxLayout *folder = new QHBoxLayout();
+    folderEdit = new QLineEdit(content);
+    folderButton = new QToolButton(content);
+    folderButton->setText("...");
+    folder->addWidget(folderEdit, 1);
+    folder->addWidget(folderButton);
+    layout->addLayout(folder);
+
+    QHBoxLayout *flags = new QHBoxLayout();
+    caseBox = new QCheckBox(content);
+    wordBox = new QCheckBox(content);
+    regexBox = new QCheckBox(content);
+    summary = new QLabel(content);
+    flags->addWidget(caseBox);
+    flags->addWidget(wordBox);
+    flags->addWidget(regexBox);
+    flags->addStretch(1);
+    flags->addWidget(summary);
+    layout->addLayout(flags);
+
+    results = new QTreeWidget(content);
+    results->setHeaderHidden(true);
+    results->setUniformRowHeights(true);
+    layout->addWidget(results, 1);
+    setWidget(content);
+
+    connect(findEdit, &QLineEdit::returnPressed, this, &SearchPanel::findAll);
+    connect(findButton, &QPushButton::clicked, this, &SearchPanel::findAll);
+    connect(replaceEdit, &QLineEdit::returnPressed, this, &SearchPanel::replaceAll);
+    connect(replaceButton, &QPushButton::clicked, this, &SearchPanel::replaceAll);
+    connect(folderEdit, &QLineEdit::returnPressed, this, &SearchPanel::findAll);
+    connect(folderButton, &QToolButton::clicked, this, &SearchPanel::chooseFolder);
+    connect(folderEdit, &QLineEdit::textChanged, this, [this](const QString &text) {
+        // Replace All only works on open tabs.
+        replaceButton->setEnabled(text.trimmed().isEmpty());
+    });
+    connect(results, &QTreeWidget::itemActivated, this, &SearchPanel::openResult);
+    connect(results, &QTreeWidget::itemClicked, this, &SearchPanel::openResult);
+
+    setLanguage("en");
+}
+
+SearchPanel::~SearchPanel()
+{
+    generation.fetchAndAddOrdered(1);
+    delete folderSearch;
+    waitForWorkers();
+}
+
+void SearchPanel::showFind()
+{
+    CodeEditor *editor = qobject_cast<CodeEditor*>(tabs->currentWidget());
+    if (editor) {
+        QString selected = editor->textCursor().selectedText();
+        if (!selected.isEmpty() && !selected.contains(QChar::ParagraphSeparator)) {
+            findEdit->setText(selected);
+        }
+    }
+    show();
+    raise();
+    findEdit->setFocus();
+    findEdit->selectAll();
+}
+
+void SearchPanel::showReplace()
+{
+    showFind();
+    if (!findEdit->text().isEmpty()) {
+        replaceEdit->setFocus();
+        replaceEdit->selectAll();
+    }
+}
+
+void SearchPanel::setLanguage(const QString &language)
+{
+    if (language == "ru") {
+        setWindowTitle("Поиск и замена");
+        findEdit->setPlaceholderText("Найти");
+        replaceEdit->setPlaceholderText("Заменить на");
+        findButton->setText("Найти все");
+        replaceButton->setText("Заменить все");
+        caseBox->setText("Учитывать регистр");
+        wordBox->setText("Слово целиком");
+        regexBox->setText("Регулярное выражение");
+        summaryFormat = "Совпадений: %1, вкладок: %2";
+        replacedFormat = "Заменено: %1, вкладок: %2";
+        searchingText = "Поиск...";
+        folderEdit->setPlaceholderText("Папка (пусто — открытые вкладки)");
+        folderFormat = "Совпадений: %1, файлов: %2 (просмотрено %3)";
+        folderTitle = "Выбор папки";
+        skippedFormat = ", пропущено вкладок: %1";
+    } else {
+        setWindowTitle("Find and Replace");
+        findEdit->setPlaceholderText("Find");
+        replaceEdit->setPlaceholderText("Replace with");
+        findButton->setText("Find All");
+        replaceButton->setText("Replace All");
+        caseBox->setText("Match case");
+        wordBox->setText("Whole words");
+        regexBox->setText("Regular expression");
+        summaryFormat = "%1 matches in %2 tabs";
+        replacedFormat = "Replaced %1 matches in %2 tabs";
+        searchingText = "Searching...";
+        folderEdit->setPlaceholderText("Folder (empty searches open tabs)");
+        folderFormat = "%1 matches in %2 files (%3 searched)";
+        folderTitle = "Choose Folder";
+        skippedFormat = ", %1 tabs skipped";
+    }
+    updateSummary();
+}
+
+TextSearch::Options SearchPanel::options() const
+{
+    TextSearch::Options options;
+    options.pattern = findEdit->text();
+    options.caseSensitive = caseBox->isChecked();
+    options.wholeWords = wordBox->isChecked();
+    options.regularExpression = regexBox->isChecked();
+    return options;
+}
+
+void SearchPanel::resetResults()
+{
+    // Bumping the generation under the lock stops the previous job's
+    // workers and keeps their late batches out of the new results.
+    {
+        QMutexLocker locker(&mutex);
+        generation.fetchAndAddOrdered(1);
+        pendingHits.clear();
+        finishedDocuments.clear();
+        pendingReplacements.clear();
+    }
+    for (int i = futures.size() - 1; i >= 0; --i) {
+        if (futures.at(i).isFinished()) futures.removeAt(i);
+    }
+    if (folderSearch) {
+        // The old walk stops at its next file and deletes itself once its
+        // workers are gone, so starting a new search never waits for it.
+        folderSearch->disconnect(this);
+        folderSearch->cancel();
+        connect(folderSearch, &FolderSearch::finished, folderSearch, &QObject::deleteLater);
+        if (folderSearch->isFinished()) folderSearch->deleteLater();
+        folderSearch = nullptr;
+    }
+
+    clearDecorations();
+    results->clear();
+    documents.clear();
+    skipped.clear();
+    summary->setToolTip(QString());
+    running = 0;
+    folderHits = 0;
+    folderFiles = 0;
+}
+
+bool SearchPanel::startJob(const TextSearch &searcher, QVector<QString> *texts, QVector<PieceTable::Snapshot> *snapshots)
+{
+    resetResults();
+    if (!searcher.isValid()) {
+        summary->setText(searcher.errorString());
+        return false;
+    }
+
+    for (int i = 1; i < tabs->count(); ++i) {
+        CodeEditor *editor = qobject_cast<CodeEditor*>(tabs->widget(i));
+        LargeFileEditor *largeEditor = qobject_cast<LargeFileEditor*>(tabs->widget(i));
+        // Tabs that are still loading are read-only until they finish, and
+        // restored or hibernated tabs have no editor until they are shown.
+        // Without snapshots (Replace All) large-file tabs are left out too.
+        if ((editor && editor->isReadOnly()) || (largeEditor && !snapshots) || (!editor && !largeEditor)) {
+            skipped.append(tabs->tabText(i));
+            continue;
+        }
+
+        Document document;
+        document.editor = editor;
+        document.largeEditor = largeEditor;
+        document.title = tabs->tabText(i);
+        document.revision = editor ? editor->document()->revision() : 0;
+        document.hits = 0;
+        document.finished = false;
+        document.item = new QTreeWidgetItem(results, QStringList(document.title));
+        documents.append(document);
+        texts->append(editor ? editor->toPlainText() : QString());
+        if (snapshots) snapshots->append(largeEditor ? largeEditor->buffer()->snapshot() : PieceTable::Snapshot());
+    }
+    summary->setToolTip(skipped.join(QLatin1Char('\n')));
+    running = documents.size();
+    updateSummary();
+    return true;
+}
+
+void SearchPanel::findAll()
+{
+    TextSearch searcher(options());
+    QVector<QString> texts;
+    QVector<PieceTable::Snapshot> snapshots;
+    replacing = false;
+    if (!folderEdit->text().trimmed().isEmpty()) {
+        findInFolder(searcher);
+        return;
+    }
+    if (!startJob(searcher, &texts, &snapshots)) return;
+
+    TextSearch::Options lines = options();
+    lines.singleLine = true;
+    TextSearch lineSearcher(lines);
+    int current = generation.loadAcquire();
+    for (int i = 0; i < texts.size(); ++i) {
+        if (documents.at(i).largeEditor) {
+            PieceTable::Snapshot snapshot = snapshots.at(i);
+            futures.append(QtConcurrent::run([this, current, i, snapshot, lineSearcher]() {
+                searchSnapshot(current, i, snapshot, lineSearcher);
+            }));
+            continue;
+        }
+        QString text = texts.at(i);
+        futures.append(QtConcurrent::run([this, current, i, text, searcher]() {
+            search(current, i, text, searcher);
+        }));
+    }
+}
+
+void SearchPanel::findInFolder(const TextSearch &searcher)
+{
+    resetResults();
+    if (!searcher.isValid()) {
+        summary->setText(searcher.errorString());
+        return;
+    }
+
+    folderSearch = new FolderSearch(folderEdit->text().trimmed(), options(), this);
+    connect(folderSearch, &FolderSearch::resultsReady, this, &SearchPanel::takeFolderResults);
+    connect(folderSearch, &FolderSearch::finished, this, &SearchPanel::folderFinished);
+    running = 1;
+    updateSummary();
+    folderSearch->start();
+}
+
+void SearchPanel::replaceAll()
+{
+    if (!folderEdit->text().trimmed().isEmpty()) return;
+    TextSearch searcher(options());
+    QVector<QString> texts;
+    replacing = true;
+    if (!startJob(searcher, &texts, nullptr)) return;
+
+    int current = generation.loadAcquire();
+    QString replacement = replaceEdit->text();
+    for (int i = 0; i < texts.size(); ++i) {
+        QString text = texts.at(i);
+        futures.append(QtConcurrent::run([this, current, i, text, searcher, replacement]() {
+            TextSearch::Replacement result = searcher.replaceAll(text, replacement);
+            QMutexLocker locker(&mutex);
+            if (generation.loadAcquire() != current) return;
+            pendingReplacements.append(Replaced{i, result});
+            schedule();
+        }));
+    }
+}
+
+void SearchPanel::search(int current, int document, const QString &text, const TextSearch &searcher)
+{
+    // Lines are counted incrementally between hits, so the cost is one
+    // extra pass over the text no matter how many hits there are.
+    QVector<Hit> batch;
+    batch.reserve(BatchHits);
+    const QChar *data = text.constData();
+    int length = int(text.size());
+    int line = 0;
+    int lineStart = 0;
+    int lineEnd = -1;
+    int scanned = 0;
+    int hits = 0;
+
+    searcher.findAll(text, [&](const TextSearch::Match &match) {
+        if (generation.loadAcquire() != current) return false;
+
+        while (scanned < match.position) {
+            int newline = TextSearch::indexOf(data + scanned, match.position - scanned, QLatin1Char('\n'), QLatin1Char('\n'));
+            if (newline < 0) break;
+            ++line;
+            lineStart = scanned + newline + 1;
+            scanned = lineStart;
+            lineEnd = -1;
+        }
+        scanned = qMax(scanned, match.position);
+        if (lineEnd < 0) {
+            int newline = TextSearch::indexOf(data + lineStart, length - lineStart, QLatin1Char('\n'), QLatin1Char('\n'));
+            lineEnd = newline < 0 ? length : lineStart + newline;
+        }
+
+        Hit hit{document, match.position, match.length, line, QString()};
+        if (hits < MaxListed) {
+            int from = match.position - lineStart > MaxPreview / 2 ? match.position - MaxPreview / 4 : lineStart;
+            hit.preview = text.mid(from, qMin(lineEnd - from, MaxPreview));
+        }
+        batch.append(hit);
+        if (batch.size() >= BatchHits) publish(current, batch, -1);
+        return ++hits < MaxHits;
+    });
+    publish(current, batch, document);
+}
+
+void SearchPanel::searchSnapshot(int current, int document, const PieceTable::Snapshot &snapshot, const TextSearch &searcher)
+{
+    // The bytes are gathered into blocks cut after their last line feed and
+    // decoded one block at a time, so memory stays flat however big the
+    // file is. A line longer than a block is searched in block-sized pieces.
+    QVector<Hit> batch;
+    batch.reserve(BatchHits);
+    QByteArray block;
+    block.reserve(BlockBytes);
+    qint64 offset = 0;
+    qint64 line = 0;
+    int hits = 0;
+    bool more = true;
+
+    auto searchCut = [&](bool last) {
+        int cut = block.size();
+        if (!last) {
+            cut = int(block.lastIndexOf('\n')) + 1;
+            if (cut == 0) {
+                cut = block.size();
+                while (cut > 0 && (uchar(block.at(cut - 1)) & 0xC0) == 0x80) --cut;
+                if (cut > 0 && uchar(block.at(cut - 1)) >= 0xC0) --cut;
+                if (cut == 0) cut = block.size();
+            }
+        }
+        QString text = QString::fromUtf8(block.constData(), cut);
+        more = searchBlock(current, document, text, offset, line, searcher, batch, hits);
+        line += NewlineScanner::count(block.constData(), cut);
+        offset += cut;
+        block.remove(0, cut);
+    };
+
+    for (const PieceTable::Span &span : snapshot.spans()) {
+        qint64 used = 0;
+        while (more && used < span.length) {
+            int take = int(qMin<qint64>(span.length - used, BlockBytes - block.size()));
+            block.append(span.data + used, take);
+            used += take;
+            if (block.size() >= BlockBytes) searchCut(false);
+        }
+        if (!more) break;
+    }
+    if (more && !block.isEmpty()) searchCut(true);
+    publish(current, batch, document);
+}
+
+bool SearchPanel::searchBlock(int current, int document, const QString &text, qint64 offset, qint64 line,
+                              const TextSearch &searcher, QVector<Hit> &batch, int &hits)
+{
+    // Hits need byte positions; the UTF-8 length of the characters before
+    // each match is summed as the matches come. A malformed sequence
+    // decodes to U+FFFD and can shift the rest of the block slightly.
+    auto utf8Length = [](const QChar *data, int length) {
+        qint64 bytes = 0;
+        for (int i = 0; i < length; ++i) {
+            ushort c = data[i].unicode();
+            bytes += c < 0x80 ? 1 : (c < 0x800 || QChar::isSurrogate(c)) ? 2 : 3;
+        }
+        return bytes;
+    };
+
+    const QChar *data = text.constData();
+    int length = int(text.size());
+    int lineStart = 0;
+    int scanned = 0;
+    int measured = 0;
+    qint64 bytes = 0;
+    bool more = true;
+
+    searcher.findAll(text, [&](const TextSearch::Match &match) {
+        if (generation.loadAcquire() != current) {
+            more = false;
+            return false;
+        }
+
+        while (scanned < match.position) {
+            int newline = TextSearch::indexOf(data + scanned, match.position - scanned, QLatin1Char('\n'), QLatin1Char('\n'));
+            if (newline < 0) break;
+            ++line;
+            lineStart = scanned + newline + 1;
+            scanned = lineStart;
+        }
+        scanned = qMax(scanned, match.position);
+        bytes += utf8Length(data + measured, match.position - measured);
+        measured = match.position;
+
+        Hit hit{document, offset + bytes, int(utf8Length(data + match.position, match.length)), line, QString()};
+        if (hits < MaxListed) {
+            int newline = TextSearch::indexOf(data + match.position, length - match.position, QLatin1Char('\n'), QLatin1Char('\n'));
+            int lineEnd = newline < 0 ? length : match.position + newline;
+            int from = match.position - lineStart > MaxPreview / 2 ? match.position - MaxPreview / 4 : lineStart;
+            hit.preview = text.mid(from, qMin(lineEnd - from, MaxPreview));
+        }
+        batch.append(hit);
+        if (batch.size() >= BatchHits) publish(current, batch, -1);
+        more = ++hits < MaxHits;
+        return more;
+    });
+    return more;
+}
+
+void SearchPanel::publish(int current, QVector<Hit> &batch, int finishedDocument)
+{
+    QMutexLocker locker(&mutex);
+    if (generation.loadAcquire() == current) {
+        pendingHits += batch;
+        if (finishedDocument >= 0) finishedDocuments.append(finishedDocument);
+        schedule();
+    }
+    batch.clear();
+}
+
+void SearchPanel::schedule()
+{
+    // Called with the mutex held; one queued call drains everything.
+    if (resultsScheduled) return;
+    resultsScheduled = true;
+    QMetaObject::invokeMethod(this, "takeResults", Qt::QueuedConnection);
+}
+
+void SearchPanel::takeResults()
+{
+    QVector<Hit> hits;
+    QVector<int> finished;
+    QVector<Replaced> replaced;
+    {
+        QMutexLocker locker(&mutex);
+        hits.swap(pendingHits);
+        finished.swap(finishedDocuments);
+        replaced.swap(pendingReplacements);
+        resultsScheduled = false;
+    }
+
+    QSet<int> touched;
+    for (const Hit &hit : qAsConst(hits)) {
+        Document &document = documents[hit.document];
+        if (document.editor) document.ranges.append(DecorationLayer::Range{int(hit.position), hit.length});
+        if (++document.hits <= MaxListed) {
+            QString text = QString("%1: %2").arg(hit.line + 1).arg(hit.preview.trimmed());
+            QTreeWidgetItem *item = new QTreeWidgetItem(document.item, QStringList(text));
+            item->setData(0, Qt::UserRole, hit.position);
+            item->setData(0, Qt::UserRole + 1, hit.length);
+        }
+        touched.insert(hit.document);
+    }
+
+    for (int index : qAsConst(finished)) {
+        Document &document = documents[index];
+        document.finished = true;
+        --running;
+        if (document.editor && document.editor->document()->revision() == document.revision) {
+            document.editor->setDecorations(DecorationLayer::SearchMatch, document.ranges);
+        }
+        document.item->setHidden(document.hits == 0);
+        touched.insert(index);
+    }
+
+    for (const Replaced &replacement : qAsConst(replaced)) {
+        applyReplacement(replacement);
+        touched.insert(replacement.document);
+    }
+
+    for (int index : qAsConst(touched)) {
+        const Document &document = documents.at(index);
+        document.item->setText(0, QString("%1 (%2)").arg(document.title).arg(document.hits));
+        if (document.hits > 0 && results->topLevelItemCount() == 1) document.item->setExpanded(true);
+    }
+    updateSummary();
+}
+
+void SearchPanel::takeFolderResults()
+{
+    // Signals queued by a search that has since been replaced arrive with
+    // no sender and are dropped.
+    if (!folderSearch || sender() != folderSearch) return;
+
+    QDir root(folderEdit->text().trimmed());
+    const QVector<FolderSearch::FileHits> files = folderSearch->takeResults();
+    for (const FolderSearch::FileHits &file : files) {
+        QTreeWidgetItem *parent = new QTreeWidgetItem(results);
+        parent->setText(0, QString("%1 (%2)").arg(root.relativeFilePath(file.path)).arg(file.hits.size()));
+        parent->setData(0, Qt::UserRole + 2, file.path);
+        for (const FolderSearch::Hit &hit : file.hits) {
+            if (folderHits++ >= MaxFolderListed) continue;
+            QTreeWidgetItem *item = new QTreeWidgetItem(parent, QStringList(QString("%1: %2").arg(hit.line + 1).arg(hit.preview.trimmed())));
+            item->setData(0, Qt::UserRole, hit.line);
+            item->setData(0, Qt::UserRole + 1, hit.column);
+        }
+        ++folderFiles;
+    }
+    if (folderHits >= MaxHits) folderSearch->cancel();
+    updateSummary();
+}
+
+void SearchPanel::folderFinished()
+{
+    if (!folderSearch || sender() != folderSearch) return;
+    takeFolderResults();
+    running = 0;
+    updateSummary();
+}
+
+void SearchPanel::chooseFolder()
+{
+    QString folder = QFileDialog::getExistingDirectory(this, folderTitle, folderEdit->text());
+    if (!folder.isEmpty()) {
+        folderEdit->setText(folder);
+    }
+}
+
+void SearchPanel::applyReplacement(const Replaced &replaced)
+{
+    Document &document = documents[replaced.document];
+    document.finished = true;
+    document.item->setHidden(true);
+    --running;
+
+    // Snapshot positions are only valid if the text has not moved since.
+    CodeEditor *editor = document.editor;
+    if (!editor || replaced.replacement.count == 0 || editor->document()->revision() != document.revision) return;
+
+    QTextCursor cursor(editor->document());
+    cursor.beginEditBlock();
+    cursor.setPosition(replaced.replacement.from);
+    cursor.setPosition(replaced.replacement.to, QTextCursor::KeepAnchor);
+    cursor.insertText(replaced.replacement.text);
+    cursor.endEditBlock();
+    document.hits = replaced.replacement.count;
+}
+
+void SearchPanel::openResult(QTreeWidgetItem *item)
+{
+    if (!item || !item->parent()) return;
+    QVariant fileName = item->parent()->data(0, Qt::UserRole + 2);
+    if (fileName.isValid()) {
+        emit locationRequested(fileName.toString(), item->data(0, Qt::UserRole).toInt(), item->data(0, Qt::UserRole + 1).toInt());
+        return;
+    }
+    int index = results->indexOfTopLevelItem(item->parent());
+    if (index < 0 || index >= documents.size()) return;
+
+    LargeFileEditor *largeEditor = documents.at(index).largeEditor;
+    if (largeEditor) {
+        qint64 position = item->data(0, Qt::UserRole).toLongLong();
+        tabs->setCurrentWidget(largeEditor);
+        largeEditor->setCursorPosition(position);
+        largeEditor->setCursorPosition(position + item->data(0, Qt::UserRole + 1).toInt(), true);
+        largeEditor->setFocus();
+        return;
+    }
+    if (!documents.at(index).editor) return;
+
+    CodeEditor *editor = documents.at(index).editor;
+    int end = editor->document()->characterCount() - 1;
+    int position = qMin(item->data(0, Qt::UserRole).toInt(), end);
+    QTextCursor cursor = editor->textCursor();
+    cursor.setPosition(position);
+    cursor.setPosition(qMin(position + item->data(0, Qt::UserRole + 1).toInt(), end), QTextCursor::KeepAnchor);
+
+    tabs->setCurrentWidget(editor);
+    editor->setTextCursor(cursor);
+    editor->centerCursor();
+    editor->setFocus();
+}
+
+void SearchPanel::clearDecorations()
+{
+    for (const Document &document : qAsConst(documents)) {
+        if (document.editor) {
+            document.editor->setDecorations(DecorationLayer::SearchMatch, QVector<DecorationLayer::Range>());
+        }
+    }
+}
+
+void SearchPanel::updateSummary()
+{
+    if (folderSearch) {
+        QString text = folderFormat.arg(folderHits).arg(folderFiles).arg(folderSearch->filesSearched());
+        summary->setText(running > 0 ? searchingText + " " + text : text);
+        return;
+    }
+    if (running > 0) {
+        summary->setText(searchingText);
+        return;
+    }
+    int total = 0;
+    int matched = 0;
+    for (const Document &document : qAsConst(documents)) {
+        total += document.hits;
+        if (document.hits > 0) ++matched;
+    }
+    QString text = documents.isEmpty() && skipped.isEmpty() ? QString() : (replacing ? replacedFormat : summaryFormat).arg(total).arg(matched);
+    if (!skipped.isEmpty()) text += skippedFormat.arg(skipped.size());
+    summary->setText(text);
+}
+
+void SearchPanel::waitForWorkers()
+{
+    for (QFuture<void> &future : futures) {
+        future.waitForFinished();
+    }
+    futures.clear();
+}
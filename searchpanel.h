@@ -0,0 +1,144 @@
+#ifndef SEARCHPANEL_H
+#define SEARCHPANEL_H
+
+#include "decorationlayer.h"
+#include "foldersearch.h"
+#include "piecetable.h"
+#include "textsearch.h"
+#include <QDockWidget>
+#include <QFuture>
+#include <QMutex>
+#include <QPointer>
+
+class CodeEditor;
+class LargeFileEditor;
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QTabWidget;
+class QToolButton;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Find and replace over every open editor tab. Each tab's text is
+// snapshotted on the GUI thread and searched on the thread pool; hits are
+// handed back in batches and listed as they arrive. Large-file tabs are
+// searched through a PieceTable snapshot a block of lines at a time, and
+// their matches never span lines. Replace All rebuilds the span between
+// the first and last match off the GUI thread and applies it as one edit,
+// so it is a single undo step; it leaves large-file tabs alone. Tabs that
+// are not loaded are counted as skipped. With a folder set, Find All
+// searches the files below it instead (see FolderSearch).
+class SearchPanel : public QDockWidget
+{
+    Q_OBJECT
+public:
+    SearchPanel(QTabWidget *tabs, QWidget *parent = nullptr);
+    ~SearchPanel();
+
+    void showFind();
+    void showReplace();
+    void setLanguage(const QString &language);
+
+signals:
+    void locationRequested(const QString &fileName, int line, int column);
+
+private slots:
+    void findAll();
+    void replaceAll();
+    void takeResults();
+    void takeFolderResults();
+    void folderFinished();
+    void chooseFolder();
+    void openResult(QTreeWidgetItem *item);
+
+private:
+    static const int BatchHits = 256;
+    static const int MaxHits = 100000;
+    static const int MaxListed = 2000;
+    static const int MaxFolderListed = 20000;
+    static const int MaxPreview = 200;
+    static const int BlockBytes = 1024 * 1024;
+
+    // Positions and lengths are in characters for a CodeEditor and in bytes
+    // for a LargeFileEditor.
+    struct Hit
+    {
+        int document;
+        qint64 position;
+        int length;
+        qint64 line;
+        QString preview;
+    };
+
+    struct Document
+    {
+        QPointer<CodeEditor> editor;
+        QPointer<LargeFileEditor> largeEditor;
+        QString title;
+        int revision;
+        int hits;
+        bool finished;
+        QVector<DecorationLayer::Range> ranges;
+        QTreeWidgetItem *item;
+    };
+
+    struct Replaced
+    {
+        int document;
+        TextSearch::Replacement replacement;
+    };
+
+    TextSearch::Options options() const;
+    void resetResults();
+    bool startJob(const TextSearch &searcher, QVector<QString> *texts, QVector<PieceTable::Snapshot> *snapshots);
+    void findInFolder(const TextSearch &searcher);
+    void schedule();
+    void search(int current, int document, const QString &text, const TextSearch &searcher);
+    void searchSnapshot(int current, int document, const PieceTable::Snapshot &snapshot, const TextSearch &searcher);
+    bool searchBlock(int current, int document, const QString &text, qint64 offset, qint64 line,
+                     const TextSearch &searcher, QVector<Hit> &batch, int &hits);
+    void publish(int current, QVector<Hit> &batch, int finishedDocument);
+    void applyReplacement(const Replaced &replaced);
+    void clearDecorations();
+    void updateSummary();
+    void waitForWorkers();
+
+    QTabWidget *tabs;
+    QLineEdit *findEdit;
+    QLineEdit *replaceEdit;
+    QLineEdit *folderEdit;
+    QToolButton *folderButton;
+    QCheckBox *caseBox;
+    QCheckBox *wordBox;
+    QCheckBox *regexBox;
+    QPushButton *findButton;
+    QPushButton *replaceButton;
+    QLabel *summary;
+    QTreeWidget *results;
+    QString summaryFormat;
+    QString replacedFormat;
+    QString searchingText;
+    QString folderFormat;
+    QString folderTitle;
+    QString skippedFormat;
+
+    QVector<Document> documents;
+    QStringList skipped;
+    QList<QFuture<void>> futures;
+    QAtomicInt generation;
+    int running;
+    bool replacing;
+    FolderSearch *folderSearch;
+    int folderHits;
+    int folderFiles;
+
+    QMutex mutex;
+    QVector<Hit> pendingHits;
+    QVector<int> finishedDocuments;
+    QVector<Replaced> pendingReplacements;
+    bool resultsScheduled;
+};
+
+#endif
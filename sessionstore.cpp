@@ -0,0 +1,225 @@
+#include "sessionstore.h"
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+SessionStore::SessionStore(const QString &fileName) : path(fileName), fileSize(0), nextId(1)
+{
+}
+
+bool SessionStore::exists() const
+{
+    return QFile::exists(path);
+}
+
+QVector<SessionStore::Tab> SessionStore::load()
+{
+    QVector<Tab> tabs;
+    entries.clear();
+    lastIndex.clear();
+    fileSize = 0;
+
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) return tabs;
+
+    QDataStream header(&file);
+    header.setVersion(QDataStream::Qt_5_15);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint64 indexOffset = 0;
+    header >> magic >> version >> indexOffset;
+    if (magic != Magic || version != Version || indexOffset < quint64(HeaderSize) || !file.seek(indexOffset)) {
+        return tabs;
+    }
+
+    QByteArray index;
+    header >> index;
+    if (header.status() != QDataStream::Ok) return tabs;
+
+    QDataStream stream(index);
+    stream.setVersion(QDataStream::Qt_5_15);
+    quint32 count = 0;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        Tab tab;
+        Entry entry;
+        stream >> tab.id >> entry.revision >> tab.filePath >> tab.modifiedTime >> tab.cursor
+               >> entry.blobOffset >> entry.blobLength;
+        if (stream.status() != QDataStream::Ok) break;
+
+        tab.revision = entry.revision;
+        tab.hasText = entry.blobLength > 0;
+        if (!tab.hasText && tab.filePath.isEmpty()) continue;
+
+        entries.insert(tab.id, entry);
+        nextId = qMax(nextId, tab.id + 1);
+        tabs.append(tab);
+    }
+
+    fileSize = file.size();
+    lastIndex = index;
+    return tabs;
+}
+
+QString SessionStore::loadText(const Tab &tab) const
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) return QString();
+    return QString::fromUtf8(qUncompress(readBlob(&file, entries.value(tab.id))));
+}
+
+void SessionStore::adopt(quint64 id, quint64 revision)
+{
+    // Restored documents get fresh revision numbers; remap them so an
+    // untouched tab keeps its stored blob.
+    auto it = entries.find(id);
+    if (it != entries.end()) {
+        it->revision = revision;
+    }
+}
+
+bool SessionStore::needsText(const Tab &tab) const
+{
+    auto it = entries.constFind(tab.id);
+    return it == entries.constEnd() || it->revision != tab.revision || it->blobLength == 0;
+}
+
+bool SessionStore::save(const QVector<Tab> &tabs)
+{
+    QHash<quint64, QByteArray> blobs;
+    for (const Tab &tab : tabs) {
+        if (tab.hasText && needsText(tab)) {
+            blobs.insert(tab.id, qCompress(tab.text.toUtf8()));
+        }
+    }
+
+    QFile file(path);
+    if (fileSize < HeaderSize || !file.open(QFile::ReadWrite)) {
+        return rewrite(tabs, blobs);
+    }
+
+    QHash<quint64, Entry> updated;
+    qint64 end = fileSize;
+    qint64 liveBytes = HeaderSize;
+    for (const Tab &tab : tabs) {
+        Entry entry;
+        entry.revision = tab.revision;
+        if (blobs.contains(tab.id)) {
+            entry.blobOffset = end;
+            entry.blobLength = blobs.value(tab.id).size();
+            end += entry.blobLength;
+        } else if (tab.hasText) {
+            entry = entries.value(tab.id);
+        }
+        liveBytes += entry.blobLength;
+        updated.insert(tab.id, entry);
+    }
+
+    QByteArray index = encodeIndex(tabs, updated);
+    if (blobs.isEmpty() && index == lastIndex) {
+        return true;
+    }
+    if (end + index.size() > 2 * (liveBytes + index.size()) + CompactSlack) {
+        file.close();
+        return rewrite(tabs, blobs);
+    }
+
+    // Blobs and the new index go after everything the current header can
+    // reach, so a crash before the header is rewritten leaves the old
+    // session readable.
+    if (!file.seek(fileSize)) return false;
+    for (const Tab &tab : tabs) {
+        auto blob = blobs.constFind(tab.id);
+        if (blob != blobs.constEnd() && file.write(*blob) != blob->size()) return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << index;
+    if (stream.status() != QDataStream::Ok || !file.flush()) return false;
+
+    QByteArray header = encodeHeader(end);
+    if (!file.seek(0) || file.write(header) != header.size() || !file.flush()) return false;
+
+    entries = updated;
+    lastIndex = index;
+    fileSize = file.size();
+    return true;
+}
+
+bool SessionStore::rewrite(const QVector<Tab> &tabs, const QHash<quint64, QByteArray> &blobs)
+{
+    QFile old(path);
+    bool haveOld = fileSize >= HeaderSize && old.open(QFile::ReadOnly);
+
+    QSaveFile output(path);
+    if (!output.open(QFile::WriteOnly)) return false;
+
+    QHash<quint64, Entry> updated;
+    qint64 end = HeaderSize;
+    output.write(encodeHeader(0));
+    for (const Tab &tab : tabs) {
+        Entry entry;
+        entry.revision = tab.revision;
+        if (tab.hasText) {
+            QByteArray blob = blobs.value(tab.id);
+            if (blob.isNull() && haveOld) {
+                blob = readBlob(&old, entries.value(tab.id));
+            }
+            if (output.write(blob) != blob.size()) {
+                output.cancelWriting();
+                return false;
+            }
+            entry.blobOffset = end;
+            entry.blobLength = blob.size();
+            end += blob.size();
+        }
+        updated.insert(tab.id, entry);
+    }
+
+    QByteArray index = encodeIndex(tabs, updated);
+    QDataStream stream(&output);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << index;
+    QByteArray header = encodeHeader(end);
+    if (stream.status() != QDataStream::Ok || !output.seek(0) || output.write(header) != header.size()) {
+        output.cancelWriting();
+        return false;
+    }
+    qint64 size = output.size();
+    if (!output.commit()) return false;
+
+    entries = updated;
+    lastIndex = index;
+    fileSize = size;
+    return true;
+}
+
+QByteArray SessionStore::readBlob(QFile *file, const Entry &entry)
+{
+    if (entry.blobLength <= 0 || !file->seek(entry.blobOffset)) return QByteArray();
+    QByteArray blob = file->read(entry.blobLength);
+    return blob.size() == entry.blobLength ? blob : QByteArray();
+}
+
+QByteArray SessionStore::encodeIndex(const QVector<Tab> &tabs, const QHash<quint64, Entry> &entries)
+{
+    QByteArray index;
+    QDataStream stream(&index, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << quint32(tabs.size());
+    for (const Tab &tab : tabs) {
+        const Entry entry = entries.value(tab.id);
+        stream << tab.id << entry.revision << tab.filePath << tab.modifiedTime << tab.cursor
+               << entry.blobOffset << entry.blobLength;
+    }
+    return index;
+}
+
+QByteArray SessionStore::encodeHeader(qint64 indexOffset)
+{
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+    stream << Magic << Version << quint64(indexOffset);
+    return header;
+}
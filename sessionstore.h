@@ -0,0 +1,67 @@
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class QFile;
+
+// Binary session file: a fixed header pointing at an index of tabs, and
+// one compressed blob per tab that carries text. load() reads only the
+// index; blobs are decompressed when a tab asks for its text. Saving
+// appends blobs only for tabs whose revision changed, then a new index,
+// then repoints the header, so unchanged tabs cost nothing. Dead blobs are
+// dropped by a full rewrite once they outweigh the live data.
+class SessionStore
+{
+public:
+    struct Tab
+    {
+        quint64 id = 0;
+        quint64 revision = 0;
+        QString filePath;
+        qint64 modifiedTime = 0;
+        qint64 cursor = 0;
+        bool hasText = false;
+        QString text;
+    };
+
+    explicit SessionStore(const QString &fileName);
+
+    bool exists() const;
+    QVector<Tab> load();
+    QString loadText(const Tab &tab) const;
+    bool save(const QVector<Tab> &tabs);
+
+    quint64 createId() { return nextId++; }
+    void adopt(quint64 id, quint64 revision);
+    bool needsText(const Tab &tab) const;
+
+private:
+    struct Entry
+    {
+        quint64 revision = 0;
+        qint64 blobOffset = 0;
+        qint32 blobLength = 0;
+    };
+
+    static const quint32 Magic = 0x4E565353;
+    static const quint32 Version = 1;
+    static const qint64 HeaderSize = 16;
+    static const qint64 CompactSlack = 1024 * 1024;
+
+    bool rewrite(const QVector<Tab> &tabs, const QHash<quint64, QByteArray> &blobs);
+    static QByteArray readBlob(QFile *file, const Entry &entry);
+    static QByteArray encodeIndex(const QVector<Tab> &tabs, const QHash<quint64, Entry> &entries);
+    static QByteArray encodeHeader(qint64 indexOffset);
+
+    QString path;
+    QHash<quint64, Entry> entries;
+    QByteArray lastIndex;
+    qint64 fileSize;
+    quint64 nextId;
+};
+
+#endif
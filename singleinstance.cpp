@@ -0,0 +1,102 @@
+#include "singleinstance.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QUrl>
+
+SingleInstance::SingleInstance(QObject *parent) : QObject(parent), server(nullptr)
+{
+    // The socket lives in a shared temporary folder, so the name is made
+    // per user.
+    QByteArray user = QCryptographicHash::hash(QDir::homePath().toUtf8(), QCryptographicHash::Md5).toHex();
+    name = "nova-editor-" + QString::fromLatin1(user.left(16));
+}
+
+SingleInstance::Outcome SingleInstance::forward(const QStringList &files)
+{
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    if (!socket.waitForConnected(ConnectMsecs)) return isAbsent(socket) ? NoInstance : NoReply;
+
+    QByteArray request;
+    QDataStream out(&request, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << Magic << files;
+    socket.write(request);
+    if (!socket.waitForBytesWritten(ReplyMsecs)) return NoReply;
+
+    // The reply means the files were taken, not just sent; an instance
+    // that is stuck leaves this launch to open them itself.
+    while (socket.bytesAvailable() < 1) {
+        if (!socket.waitForReadyRead(ReplyMsecs)) return NoReply;
+    }
+    return socket.read(1) == "1" ? Taken : NoReply;
+}
+
+bool SingleInstance::listen()
+{
+    server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(server, &QLocalServer::newConnection, this, &SingleInstance::acceptConnections);
+    if (server->listen(name)) return true;
+    if (server->serverError() != QAbstractSocket::AddressInUseError) return false;
+
+    // The socket file is only removed when connecting to it is refused,
+    // which means it was left behind by an instance that crashed; one that
+    // is merely busy keeps its name.
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(ConnectMsecs) || !isAbsent(probe)) return false;
+    QLocalServer::removeServer(name);
+    return server->listen(name);
+}
+
+bool SingleInstance::isAbsent(const QLocalSocket &socket)
+{
+    return socket.error() == QLocalSocket::ServerNotFoundError || socket.error() == QLocalSocket::ConnectionRefusedError;
+}
+
+QStringList SingleInstance::filesFromArguments(const QStringList &arguments)
+{
+    QStringList files;
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString &argument = arguments.at(i);
+        if (argument.startsWith('-')) continue;
+        QString path = argument.startsWith("file:") ? QUrl(argument).toLocalFile() : argument;
+        if (!path.isEmpty()) files.append(QFileInfo(path).absoluteFilePath());
+    }
+    return files;
+}
+
+void SingleInstance::acceptConnections()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { readRequest(socket); });
+        readRequest(socket);
+    }
+}
+
+void SingleInstance::readRequest(QLocalSocket *socket)
+{
+    QDataStream in(socket);
+    in.setVersion(QDataStream::Qt_5_15);
+    in.startTransaction();
+    quint32 magic = 0;
+    QStringList files;
+    in >> magic >> files;
+    if (!in.commitTransaction()) return;
+    if (magic != Magic) {
+        socket->abort();
+        return;
+    }
+
+    // Answered before the files are opened, so the sender can exit while
+    // this instance does the work.
+    socket->write("1");
+    socket->flush();
+    emit filesReceived(files);
+}
@@ -0,0 +1,50 @@
+#ifndef SINGLEINSTANCE_H
+#define SINGLEINSTANCE_H
+
+#include <QObject>
+#include <QStringList>
+
+class QLocalServer;
+class QLocalSocket;
+
+// One editor per user. A launch first offers its files to a running
+// instance over a local socket and exits once that instance has taken
+// them; if there is none, it becomes the instance and listens for the
+// launches that follow. An instance that is alive but slow to answer keeps
+// the name, and the launch runs on its own. Paths are made absolute before
+// they are sent, since the two processes need not share a working
+// directory.
+class SingleInstance : public QObject
+{
+    Q_OBJECT
+public:
+    enum Outcome { Taken, NoInstance, NoReply };
+
+    explicit SingleInstance(QObject *parent = nullptr);
+
+    // An empty list just brings the running instance to the front.
+    Outcome forward(const QStringList &files);
+    bool listen();
+
+    // The files named on a command line, file:// URLs included.
+    static QStringList filesFromArguments(const QStringList &arguments);
+
+signals:
+    void filesReceived(const QStringList &files);
+
+private slots:
+    void acceptConnections();
+
+private:
+    static const quint32 Magic = 0x4E56534F;
+    static const int ConnectMsecs = 100;
+    static const int ReplyMsecs = 2000;
+
+    void readRequest(QLocalSocket *socket);
+    static bool isAbsent(const QLocalSocket &socket);
+
+    QString name;
+    QLocalServer *server;
+};
+
+#endif
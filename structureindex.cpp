@@ -0,0 +1,346 @@
+#include "structureindex.h"
+#include "blockdata.h"
+#include <QRandomGenerator>
+#include <QTextDocument>
+#include <algorithm>
+
+namespace {
+
+// Depth change over a run of brackets and the lowest depth reached in it,
+// counting the start, so min is never above zero.
+struct Sum
+{
+    int delta;
+    int min;
+};
+
+inline Sum combine(const Sum &first, const Sum &second)
+{
+    return Sum{first.delta + second.delta, qMin(first.min, first.delta + second.min)};
+}
+
+// Walking the same run backwards, closing brackets raise the depth.
+inline int reverseMin(const Sum &sum)
+{
+    return sum.min - sum.delta;
+}
+
+}
+
+struct StructureIndex::Node
+{
+    Node *left = nullptr;
+    Node *right = nullptr;
+    Node *parent = nullptr;
+    StructureIndex *index = nullptr;
+    BlockData *data = nullptr;
+    QTextBlock block;
+    quint32 priority = 0;
+    int size = 1;
+    Sum own[CppLexer::BracketKindCount] = {};
+    Sum total[CppLexer::BracketKindCount] = {};
+};
+
+namespace {
+
+typedef StructureIndex::Node Node;
+
+inline int size(const Node *node)
+{
+    return node ? node->size : 0;
+}
+
+void pull(Node *node)
+{
+    node->size = 1 + size(node->left) + size(node->right);
+    for (int kind = 0; kind < CppLexer::BracketKindCount; ++kind) {
+        Sum sum = node->own[kind];
+        if (node->left) sum = combine(node->left->total[kind], sum);
+        if (node->right) sum = combine(sum, node->right->total[kind]);
+        node->total[kind] = sum;
+    }
+}
+
+void pullUp(Node *node)
+{
+    for (; node; node = node->parent) {
+        pull(node);
+    }
+}
+
+int rank(const Node *node)
+{
+    int result = size(node->left);
+    for (; node->parent; node = node->parent) {
+        if (node == node->parent->right) result += size(node->parent->left) + 1;
+    }
+    return result;
+}
+
+Node *leftmost(Node *node)
+{
+    while (node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+void destroy(Node *node)
+{
+    if (!node) return;
+    destroy(node->left);
+    destroy(node->right);
+    node->data->structureNode = nullptr;
+    delete node;
+}
+
+// The first node from index 'from' on in which a depth starting at 'depth'
+// drops to zero. Subtrees it cannot drop in are skipped whole, adding their
+// delta; on success 'depth' is the depth at the start of the node.
+Node *findForward(Node *node, int from, int kind, int &depth)
+{
+    if (!node) return nullptr;
+    if (from <= 0 && depth + node->total[kind].min > 0) {
+        depth += node->total[kind].delta;
+        return nullptr;
+    }
+    int leftSize = size(node->left);
+    if (from < leftSize) {
+        Node *found = findForward(node->left, from, kind, depth);
+        if (found) return found;
+    }
+    if (from <= leftSize) {
+        if (depth + node->own[kind].min <= 0) return node;
+        depth += node->own[kind].delta;
+    }
+    return findForward(node->right, from - leftSize - 1, kind, depth);
+}
+
+// The same walking backwards from index 'to'; on success 'depth' is the
+// depth at the end of the node.
+Node *findBackward(Node *node, int to, int kind, int &depth)
+{
+    if (!node || to < 0) return nullptr;
+    if (to >= node->size - 1 && depth + reverseMin(node->total[kind]) > 0) {
+        depth -= node->total[kind].delta;
+        return nullptr;
+    }
+    int leftSize = size(node->left);
+    if (to > leftSize) {
+        Node *found = findBackward(node->right, to - leftSize - 1, kind, depth);
+        if (found) return found;
+    }
+    if (to >= leftSize) {
+        if (depth + reverseMin(node->own[kind]) <= 0) return node;
+        depth -= node->own[kind].delta;
+    }
+    return findBackward(node->left, to, kind, depth);
+}
+
+// Index of the bracket of the kind at which the depth reaches zero, walking
+// from 'from' in 'direction'.
+int scan(const QVector<CppLexer::Bracket> &brackets, int from, int direction, int kind, int &depth)
+{
+    for (int i = from; i >= 0 && i < brackets.size(); i += direction) {
+        const CppLexer::Bracket &bracket = brackets.at(i);
+        if (bracket.kind != kind) continue;
+        depth += bracket.step * direction;
+        if (depth == 0) return i;
+    }
+    return -1;
+}
+
+}
+
+StructureIndex::StructureIndex(QTextDocument *document, QObject *parent)
+    : QObject(parent), document(document), root(nullptr)
+{
+}
+
+StructureIndex::~StructureIndex()
+{
+    // The document may outlive the index; its blocks must not report back.
+    destroy(root);
+}
+
+void StructureIndex::update(const QTextBlock &block)
+{
+    BlockData *data = static_cast<BlockData*>(block.userData());
+    if (!data) return;
+
+    Sum own[CppLexer::BracketKindCount] = {};
+    for (const CppLexer::Bracket &bracket : qAsConst(data->brackets)) {
+        Sum &sum = own[bracket.kind];
+        sum.delta += bracket.step;
+        sum.min = qMin(sum.min, sum.delta);
+    }
+
+    Node *node = data->structureNode;
+    if (!node) {
+        // A block goes in right after the block above it, which keeps the
+        // tree in document order; until that one is in, it waits.
+        Node *previous = nullptr;
+        QTextBlock above = block.previous();
+        if (above.isValid()) {
+            BlockData *aboveData = static_cast<BlockData*>(above.userData());
+            if (!aboveData || !aboveData->structureNode) return;
+            previous = aboveData->structureNode;
+        }
+        node = new Node;
+        node->index = this;
+        node->data = data;
+        node->block = block;
+        node->priority = QRandomGenerator::global()->generate();
+        std::copy(own, own + CppLexer::BracketKindCount, node->own);
+        data->structureNode = node;
+        insertAfter(previous, node);
+        return;
+    }
+
+    node->block = block;
+    bool changed = false;
+    for (int kind = 0; kind < CppLexer::BracketKindCount; ++kind) {
+        changed = changed || own[kind].delta != node->own[kind].delta || own[kind].min != node->own[kind].min;
+        node->own[kind] = own[kind];
+    }
+    if (changed) pullUp(node);
+}
+
+bool StructureIndex::contains(const QTextBlock &block) const
+{
+    BlockData *data = static_cast<BlockData*>(block.userData());
+    return data && data->structureNode;
+}
+
+int StructureIndex::match(int position) const
+{
+    QTextBlock block = document->findBlock(position);
+    BlockData *data = block.isValid() ? static_cast<BlockData*>(block.userData()) : nullptr;
+    if (!data || !data->structureNode) return -1;
+
+    const QVector<CppLexer::Bracket> &brackets = data->brackets;
+    int offset = position - block.position();
+    int at = -1;
+    for (int i = 0; i < brackets.size() && at < 0; ++i) {
+        if (brackets.at(i).position == offset) at = i;
+    }
+    if (at < 0) return -1;
+
+    // The rest of the block first, then the tree finds the block the depth
+    // runs out in, and that block is walked to the bracket itself.
+    int kind = brackets.at(at).kind;
+    int direction = brackets.at(at).step;
+    int depth = 1;
+    int found = scan(brackets, at + direction, direction, kind, depth);
+    if (found >= 0) return block.position() + brackets.at(found).position;
+
+    int index = rank(data->structureNode);
+    Node *target = direction > 0 ? findForward(root, index + 1, kind, depth) : findBackward(root, index - 1, kind, depth);
+    if (!target) return -1;
+    const QVector<CppLexer::Bracket> &other = target->data->brackets;
+    found = scan(other, direction > 0 ? 0 : int(other.size()) - 1, direction, kind, depth);
+    return found >= 0 ? target->block.position() + other.at(found).position : -1;
+}
+
+bool StructureIndex::isFoldable(const QTextBlock &block) const
+{
+    BlockData *data = static_cast<BlockData*>(block.userData());
+    if (!data || !data->structureNode) return false;
+    const Sum *own = data->structureNode->own;
+    return own[CppLexer::Brace].delta > own[CppLexer::Brace].min || own[CppLexer::Region].delta > own[CppLexer::Region].min;
+}
+
+QTextBlock StructureIndex::foldEnd(const QTextBlock &block) const
+{
+    BlockData *data = static_cast<BlockData*>(block.userData());
+    if (!data || !data->structureNode) return QTextBlock();
+
+    // What the block leaves open is closed where the depth falls back to
+    // the lowest point inside the block.
+    Node *node = data->structureNode;
+    const int kinds[] = { CppLexer::Brace, CppLexer::Region };
+    for (int kind : kinds) {
+        int depth = node->own[kind].delta - node->own[kind].min;
+        if (depth <= 0) continue;
+        Node *end = findForward(root, rank(node) + 1, kind, depth);
+        return end ? end->block : QTextBlock();
+    }
+    return QTextBlock();
+}
+
+void StructureIndex::detach(Node *node)
+{
+    node->index->remove(node);
+}
+
+void StructureIndex::insertAfter(Node *previous, Node *node)
+{
+    if (!root) {
+        root = node;
+        pull(node);
+        return;
+    }
+
+    Node *parent = nullptr;
+    if (!previous) {
+        parent = leftmost(root);
+        parent->left = node;
+    } else if (!previous->right) {
+        parent = previous;
+        parent->right = node;
+    } else {
+        parent = leftmost(previous->right);
+        parent->left = node;
+    }
+    node->parent = parent;
+    pull(node);
+    while (node->parent && node->parent->priority < node->priority) {
+        rotateUp(node);
+    }
+    pullUp(node->parent);
+}
+
+void StructureIndex::remove(Node *node)
+{
+    // Rotated down until it is a leaf, then cut off.
+    while (node->left || node->right) {
+        bool leftUp = !node->right || (node->left && node->left->priority > node->right->priority);
+        rotateUp(leftUp ? node->left : node->right);
+    }
+    Node *parent = node->parent;
+    if (!parent) {
+        root = nullptr;
+    } else if (parent->left == node) {
+        parent->left = nullptr;
+    } else {
+        parent->right = nullptr;
+    }
+    pullUp(parent);
+    delete node;
+}
+
+void StructureIndex::rotateUp(Node *node)
+{
+    Node *parent = node->parent;
+    Node *grandparent = parent->parent;
+    if (parent->left == node) {
+        parent->left = node->right;
+        if (node->right) node->right->parent = parent;
+        node->right = parent;
+    } else {
+        parent->right = node->left;
+        if (node->left) node->left->parent = parent;
+        node->left = parent;
+    }
+    parent->parent = node;
+    node->parent = grandparent;
+    if (!grandparent) {
+        root = node;
+    } else if (grandparent->left == parent) {
+        grandparent->left = node;
+    } else {
+        grandparent->right = node;
+    }
+    pull(parent);
+    pull(node);
+}
@@ -0,0 +1,47 @@
+#ifndef STRUCTUREINDEX_H
+#define STRUCTUREINDEX_H
+
+#include <QObject>
+#include <QTextBlock>
+
+class QTextDocument;
+
+// Bracket and #if depth over a whole document, for bracket matching and
+// folding. Each block contributes, per kind, how much it changes the depth
+// and the lowest depth it reaches; a treap over the blocks in document
+// order keeps the same two numbers for every subtree. Finding where a
+// bracket is closed is then a descent of O(log n), and re-reading a block
+// only updates the path above it. Blocks join as they are highlighted, in
+// document order.
+class StructureIndex : public QObject
+{
+    Q_OBJECT
+public:
+    struct Node;
+
+    StructureIndex(QTextDocument *document, QObject *parent = nullptr);
+    ~StructureIndex();
+
+    // Takes in the block's brackets after the highlighter read them.
+    void update(const QTextBlock &block);
+    bool contains(const QTextBlock &block) const;
+
+    // Position of the bracket matching the one at position, or -1.
+    int match(int position) const;
+    // A foldable block opens a brace or #if it does not close; its fold
+    // ends with the block that closes them.
+    bool isFoldable(const QTextBlock &block) const;
+    QTextBlock foldEnd(const QTextBlock &block) const;
+
+    static void detach(Node *node);
+
+private:
+    void insertAfter(Node *previous, Node *node);
+    void remove(Node *node);
+    void rotateUp(Node *node);
+
+    QTextDocument *document;
+    Node *root;
+};
+
+#endif
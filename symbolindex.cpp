@@ -0,0 +1,980 @@
+#include "symbolindex.h"
+#include "cpplexer.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QTimer>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+const char *const sourceSuffixes[] = {"c", "cc", "cpp", "cxx", "c++", "h", "hh", "hpp", "hxx", "h++", "inl", "ipp", "tpp", "ixx"};
+
+inline bool isIdentifierStart(ushort c)
+{
+    if (c < 128) return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    return QChar(c).isLetter();
+}
+
+inline bool isIdentifierChar(ushort c)
+{
+    if (c < 128) return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (c >= '0' && c <= '9');
+    return QChar(c).isLetterOrNumber();
+}
+
+inline bool isSpace(ushort c)
+{
+    return c == ' ' || c == '\t';
+}
+
+bool isMacroName(const QString &name)
+{
+    bool lower = false;
+    for (int i = 0; i < name.size() && !lower; ++i) {
+        ushort c = name.at(i).unicode();
+        lower = (c >= 'a' && c <= 'z') || c > 127;
+    }
+    return !lower && name.size() > 1;
+}
+
+bool equals(const QChar *text, int length, const char *word)
+{
+    for (int i = 0; i < length; ++i) {
+        if (text[i].unicode() != uchar(word[i])) return false;
+    }
+    return word[length] == '\0';
+}
+
+// Walks a file with a small declaration state machine on top of CppLexer,
+// which takes care of comments, strings and raw strings. Only tokens at
+// namespace or class scope are looked at; inside function bodies and
+// initializers just the braces are counted. Of a preprocessor conditional
+// only the first branch that is not "#if 0" is read, so the braces of the
+// alternatives do not add up.
+class Extractor
+{
+public:
+    QVector<SymbolIndex::Symbol> run(const QString &text);
+
+private:
+    enum ScopeKind { NamespaceScope, ClassScope, FunctionScope, BlockScope };
+    enum Previous { Other, Word };
+
+    struct Scope
+    {
+        int kind;
+        QString name;
+        QString shortName;
+    };
+
+    struct Conditional
+    {
+        bool active;
+        bool taken;
+    };
+
+    void directive(const QChar *text, int from, int length, int line);
+    void scan(const QChar *text, int from, int to, int line);
+    void word(const QChar *text, int length, int line, int column);
+    int punctuation(const QChar *text, int at, int to);
+    void openBrace();
+    void closeBrace();
+    void endStatement();
+    void add(const QString &name, const QString &qualifier, int kind, bool definition, int line, int column);
+    void push(int kind, const QString &name);
+    bool declarative() const;
+    bool active() const;
+    QString scopeName() const { return scopes.isEmpty() ? QString() : scopes.last().name; }
+
+    QVector<SymbolIndex::Symbol> symbols;
+    QVector<Scope> scopes;
+    QVector<Conditional> conditionals;
+
+    int words = 0;
+    int parens = 0;
+    int templateAngles = 0;
+    bool templatePending = false;
+    bool initializer = false;
+    bool skipStatement = false;
+    bool externLinkage = false;
+
+    int typeKind = -1;
+    int typeAngles = 0;
+    bool typeBases = false;
+    QString typeName;
+    int typeLine = 0;
+    int typeColumn = 0;
+
+    QString lastWord;
+    QString qualifier;
+    int lastLine = 0;
+    int lastColumn = 0;
+    int previous = Other;
+    bool afterScope = false;
+    bool tilde = false;
+    bool operatorName = false;
+    bool operatorFunction = false;
+
+    QString functionName;
+    QString functionQualifier;
+    int functionLine = 0;
+    int functionColumn = 0;
+    bool functionClosed = false;
+    bool trailingReturn = false;
+    bool constructorInit = false;
+};
+
+QVector<SymbolIndex::Symbol> Extractor::run(const QString &text)
+{
+    CppLexer::State state;
+    QVector<CppLexer::Token> tokens;
+    const QChar *data = text.constData();
+    int length = text.size();
+    bool continued = false;
+
+    for (int start = 0, line = 0; start <= length; ++line) {
+        int end = text.indexOf(QLatin1Char('\n'), start);
+        if (end < 0) end = length;
+        const QChar *lineText = data + start;
+        int lineLength = end - start;
+        if (lineLength > 0 && lineText[lineLength - 1].unicode() == '\r') --lineLength;
+        start = end + 1;
+
+        bool code = state.kind == CppLexer::Normal;
+        tokens.clear();
+        CppLexer::lex(lineText, lineLength, state, tokens);
+        bool backslash = lineLength > 0 && lineText[lineLength - 1].unicode() == '\\';
+        if (continued) {
+            continued = backslash;
+            continue;
+        }
+
+        int first = 0;
+        while (first < lineLength && isSpace(lineText[first].unicode())) ++first;
+        if (code && first < lineLength && lineText[first].unicode() == '#') {
+            directive(lineText, first + 1, lineLength, line);
+            continued = backslash;
+            continue;
+        }
+        if (!active()) continue;
+
+        // Comments, strings and numbers are skipped; keywords and names are
+        // read again by scan().
+        int from = 0;
+        for (const CppLexer::Token &token : qAsConst(tokens)) {
+            if (token.kind == CppLexer::Keyword || token.kind == CppLexer::Class || token.kind == CppLexer::Function) continue;
+            scan(lineText, from, token.start, line);
+            from = token.start + token.length;
+        }
+        scan(lineText, from, lineLength, line);
+    }
+    return symbols;
+}
+
+void Extractor::directive(const QChar *text, int from, int length, int line)
+{
+    int i = from;
+    while (i < length && isSpace(text[i].unicode())) ++i;
+    int word = i;
+    while (i < length && isIdentifierChar(text[i].unicode())) ++i;
+    const QChar *name = text + word;
+    int size = i - word;
+
+    if (equals(name, size, "if") || equals(name, size, "ifdef") || equals(name, size, "ifndef")) {
+        bool disabled = false;
+        if (size == 2) {
+            int rest = i;
+            while (rest < length && isSpace(text[rest].unicode())) ++rest;
+            disabled = rest < length && text[rest].unicode() == '0'
+                && (rest + 1 == length || !isIdentifierChar(text[rest + 1].unicode()));
+        }
+        bool enabled = active() && !disabled;
+        conditionals.append(Conditional{enabled, enabled});
+    } else if ((equals(name, size, "elif") || equals(name, size, "else")) && !conditionals.isEmpty()) {
+        Conditional top = conditionals.takeLast();
+        bool enabled = active() && !top.taken;
+        conditionals.append(Conditional{enabled, top.taken || enabled});
+    } else if (equals(name, size, "endif") && !conditionals.isEmpty()) {
+        conditionals.removeLast();
+    } else if (equals(name, size, "define")) {
+        while (i < length && isSpace(text[i].unicode())) ++i;
+        int macro = i;
+        while (i < length && isIdentifierChar(text[i].unicode())) ++i;
+        if (i > macro) add(QString(text + macro, i - macro), QString(), SymbolIndex::Macro, true, line, macro);
+    }
+}
+
+void Extractor::scan(const QChar *text, int from, int to, int line)
+{
+    int i = from;
+    while (i < to) {
+        ushort c = text[i].unicode();
+        if (isSpace(c)) {
+            ++i;
+        } else if (isIdentifierStart(c)) {
+            int end = i + 1;
+            while (end < to && isIdentifierChar(text[end].unicode())) ++end;
+            word(text + i, end - i, line, i);
+            i = end;
+        } else {
+            i = punctuation(text, i, to);
+        }
+    }
+}
+
+void Extractor::word(const QChar *text, int length, int line, int column)
+{
+    if (!declarative() || skipStatement || templatePending || templateAngles > 0 || parens > 0 || initializer) return;
+
+    if (operatorName) {
+        lastWord += QLatin1Char(' ');
+        lastWord.append(text, length);
+        return;
+    }
+    if (constructorInit) {
+        previous = Word;
+        return;
+    }
+    if (functionClosed) {
+        // Specifiers after the parameter list, or a trailing return type.
+        if (trailingReturn || equals(text, length, "const") || equals(text, length, "volatile")
+            || equals(text, length, "noexcept") || equals(text, length, "throw") || equals(text, length, "override")
+            || equals(text, length, "final") || equals(text, length, "requires") || equals(text, length, "try")) {
+            previous = Other;
+            return;
+        }
+        endStatement();
+    }
+
+    bool keyword = CppLexer::isKeyword(text, length);
+    if (typeKind >= 0) {
+        if (typeBases || typeAngles > 0 || keyword || equals(text, length, "final")) return;
+        if (typeKind == SymbolIndex::Namespace && afterScope) {
+            typeName += "::";
+            typeName.append(text, length);
+        } else {
+            typeName.setUnicode(text, length);
+            typeLine = line;
+            typeColumn = column;
+        }
+        afterScope = false;
+        return;
+    }
+
+    if (keyword) {
+        if (equals(text, length, "namespace")) {
+            typeKind = SymbolIndex::Namespace;
+        } else if (equals(text, length, "class")) {
+            typeKind = SymbolIndex::Class;
+        } else if (equals(text, length, "struct")) {
+            typeKind = SymbolIndex::Struct;
+        } else if (equals(text, length, "union")) {
+            typeKind = SymbolIndex::Union;
+        } else if (equals(text, length, "enum")) {
+            typeKind = SymbolIndex::Enum;
+        } else if (equals(text, length, "template")) {
+            templatePending = true;
+        } else if (equals(text, length, "typedef") || equals(text, length, "using") || equals(text, length, "friend")
+                   || equals(text, length, "static_assert")) {
+            skipStatement = true;
+        } else if (equals(text, length, "extern")) {
+            externLinkage = true;
+        } else if (equals(text, length, "operator")) {
+            if (!afterScope) qualifier.clear();
+            lastWord = QStringLiteral("operator");
+            lastLine = line;
+            lastColumn = column;
+            operatorName = true;
+            previous = Word;
+            afterScope = false;
+            ++words;
+            return;
+        }
+        if (typeKind >= 0) {
+            typeName.clear();
+            typeLine = line;
+            typeColumn = column;
+        }
+        ++words;
+        previous = Other;
+        afterScope = false;
+        return;
+    }
+
+    if (!afterScope) qualifier.clear();
+    lastWord.setUnicode(text, length);
+    lastLine = line;
+    lastColumn = column;
+    if (tilde) {
+        lastWord.prepend(QLatin1Char('~'));
+        --lastColumn;
+        tilde = false;
+    }
+    ++words;
+    previous = Word;
+    afterScope = false;
+}
+
+int Extractor::punctuation(const QChar *text, int at, int to)
+{
+    ushort c = text[at].unicode();
+    ushort next = at + 1 < to ? text[at + 1].unicode() : 0;
+    if (c == '{') {
+        openBrace();
+        return at + 1;
+    }
+    if (c == '}') {
+        closeBrace();
+        return at + 1;
+    }
+    if (!declarative()) return at + 1;
+
+    if (c == ';') {
+        if (functionClosed && !skipStatement && parens == 0) {
+            add(functionName, functionQualifier, SymbolIndex::Function, false, functionLine, functionColumn);
+        }
+        endStatement();
+        return at + 1;
+    }
+    if (skipStatement) return at + 1;
+
+    if (templatePending) {
+        templatePending = false;
+        if (c == '<') {
+            templateAngles = 1;
+            return at + 1;
+        }
+    }
+    if (templateAngles > 0) {
+        if (c == '<') ++templateAngles;
+        if (c == '>') --templateAngles;
+        return at + 1;
+    }
+
+    if (operatorName) {
+        if (c != '(') {
+            lastWord += QChar(c);
+            return at + 1;
+        }
+        operatorName = false;
+        operatorFunction = true;
+        if (lastWord == QLatin1String("operator")) {
+            int close = at + 1;
+            while (close < to && isSpace(text[close].unicode())) ++close;
+            if (close < to && text[close].unicode() == ')') {
+                lastWord += QLatin1String("()");
+                return close + 1;
+            }
+        }
+    }
+
+    if (c == ':' && next == ':') {
+        if (previous == Word && typeKind < 0) {
+            qualifier += lastWord;
+            qualifier += QLatin1String("::");
+        }
+        afterScope = parens == 0;
+        previous = Other;
+        return at + 2;
+    }
+
+    if (c == '(') {
+        if (typeKind >= 0 && !typeName.isEmpty() && !typeBases) typeKind = -1;
+        if (parens == 0 && previous == Word && typeKind < 0 && !initializer && !functionClosed && !constructorInit) {
+            // A bare name needs a return type in front of it unless it is a
+            // constructor, a destructor or an operator. Names in capitals are
+            // taken to be macros such as Q_PROPERTY(...).
+            bool constructor = !scopes.isEmpty() && scopes.last().kind == ClassScope
+                && (lastWord == scopes.last().shortName || lastWord.startsWith(QLatin1Char('~')));
+            if ((words > 1 || !qualifier.isEmpty() || constructor || operatorFunction) && !isMacroName(lastWord)) {
+                functionName = lastWord;
+                functionQualifier = qualifier;
+                functionQualifier.chop(2);
+                functionLine = lastLine;
+                functionColumn = lastColumn;
+            }
+        }
+        ++parens;
+        previous = Other;
+        afterScope = false;
+        return at + 1;
+    }
+    if (c == ')') {
+        if (parens > 0) --parens;
+        if (parens == 0 && !functionName.isEmpty()) functionClosed = true;
+        previous = Other;
+        return at + 1;
+    }
+    if (parens > 0) return at + 1;
+
+    if (c == '~') {
+        tilde = true;
+        return at + 1;
+    }
+    if (c == '-' && next == '>') {
+        if (functionClosed) trailingReturn = true;
+        previous = Other;
+        return at + 2;
+    }
+    if (c == ':') {
+        if (typeKind >= 0) {
+            typeBases = true;
+        } else if (functionClosed) {
+            constructorInit = true;
+            previous = Other;
+        } else if (!initializer) {
+            // An access specifier or a bit-field.
+            endStatement();
+        }
+        return at + 1;
+    }
+    if (c == '=') {
+        typeKind = -1;
+        // "= default", "= delete" and "= 0" keep the declaration for ';'.
+        initializer = true;
+        previous = Other;
+        return at + 1;
+    }
+    if (typeKind >= 0) {
+        if (c == '<') {
+            ++typeAngles;
+        } else if (c == '>' && typeAngles > 0) {
+            --typeAngles;
+        } else if (typeAngles == 0 && !typeBases && (c == '*' || c == '&' || c == ',')) {
+            // An elaborated type specifier such as "struct stat *buffer".
+            typeKind = -1;
+        }
+        return at + 1;
+    }
+
+    previous = Other;
+    afterScope = false;
+    return at + 1;
+}
+
+void Extractor::openBrace()
+{
+    if (!declarative()) {
+        push(BlockScope, QString());
+        return;
+    }
+    if (skipStatement) {
+        // A friend function defined in place; its body ends the statement.
+        push(FunctionScope, QString());
+        return;
+    }
+    if (parens > 0 || initializer || templateAngles > 0) {
+        push(BlockScope, QString());
+        return;
+    }
+
+    if (typeKind >= 0) {
+        QString name = typeName;
+        int kind = typeKind;
+        QString scope = scopeName();
+        QString qualified = name.isEmpty() ? scope : scope.isEmpty() ? name : scope + "::" + name;
+        if (!name.isEmpty()) add(name, QString(), kind, true, typeLine, typeColumn);
+        endStatement();
+        if (kind == SymbolIndex::Namespace) {
+            push(NamespaceScope, qualified);
+        } else if (kind == SymbolIndex::Enum) {
+            push(BlockScope, QString());
+        } else {
+            push(ClassScope, qualified);
+            scopes.last().shortName = name.mid(name.lastIndexOf(QLatin1Char(':')) + 1);
+        }
+        return;
+    }
+    if (constructorInit && previous == Word) {
+        // A member initialised with braces.
+        push(BlockScope, QString());
+        return;
+    }
+    if (functionClosed) {
+        add(functionName, functionQualifier, SymbolIndex::Function, true, functionLine, functionColumn);
+        endStatement();
+        push(FunctionScope, QString());
+        return;
+    }
+    if (externLinkage) {
+        endStatement();
+        push(NamespaceScope, scopeName());
+        return;
+    }
+    push(BlockScope, QString());
+}
+
+void Extractor::closeBrace()
+{
+    if (scopes.isEmpty()) return;
+    int kind = scopes.last().kind;
+    scopes.removeLast();
+    if (declarative() && kind != BlockScope) endStatement();
+    previous = Other;
+}
+
+void Extractor::endStatement()
+{
+    words = 0;
+    parens = 0;
+    templateAngles = 0;
+    templatePending = false;
+    initializer = false;
+    skipStatement = false;
+    externLinkage = false;
+    typeKind = -1;
+    typeAngles = 0;
+    typeBases = false;
+    typeName.clear();
+    qualifier.clear();
+    previous = Other;
+    afterScope = false;
+    tilde = false;
+    operatorName = false;
+    operatorFunction = false;
+    functionName.clear();
+    functionQualifier.clear();
+    functionClosed = false;
+    trailingReturn = false;
+    constructorInit = false;
+}
+
+void Extractor::add(const QString &name, const QString &qualifier, int kind, bool definition, int line, int column)
+{
+    // Symbols of one scope share its name string.
+    QString scope = scopeName();
+    if (kind == SymbolIndex::Macro) {
+        scope.clear();
+    } else if (!qualifier.isEmpty()) {
+        scope = scope.isEmpty() ? qualifier : scope + "::" + qualifier;
+    }
+    symbols.append(SymbolIndex::Symbol{name, scope, kind, line, column, definition});
+}
+
+void Extractor::push(int kind, const QString &name)
+{
+    scopes.append(Scope{kind, name, QString()});
+}
+
+bool Extractor::declarative() const
+{
+    return scopes.isEmpty() || scopes.last().kind == NamespaceScope || scopes.last().kind == ClassScope;
+}
+
+bool Extractor::active() const
+{
+    return conditionals.isEmpty() || conditionals.last().active;
+}
+
+}
+
+SymbolIndex::SymbolIndex(const QString &storeDirectory, QObject *parent)
+    : QObject(parent), storeDirectory(storeDirectory), generation(0), serial(0), scanning(false), dirty(false),
+      finishedScan(0), resultsScheduled(false)
+{
+    saveTimer = new QTimer(this);
+    saveTimer->setSingleShot(true);
+    saveTimer->setInterval(SaveDelay);
+    connect(saveTimer, &QTimer::timeout, this, &SymbolIndex::save);
+}
+
+SymbolIndex::~SymbolIndex()
+{
+    generation.fetchAndAddOrdered(1);
+    for (QFuture<void> &future : futures) {
+        future.waitForFinished();
+    }
+    if (dirty && !rootPath.isEmpty()) {
+        write(storeFile(rootPath), rootPath, files);
+    }
+}
+
+QString SymbolIndex::key(const QString &path)
+{
+    return QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+}
+
+bool SymbolIndex::isSource(const QString &path)
+{
+    QString suffix = QFileInfo(path).suffix().toLower();
+    for (const char *known : sourceSuffixes) {
+        if (suffix == QLatin1String(known)) return true;
+    }
+    return false;
+}
+
+QVector<SymbolIndex::Symbol> SymbolIndex::extract(const QString &text)
+{
+    Extractor extractor;
+    return extractor.run(text);
+}
+
+void SymbolIndex::setRoot(const QString &folder)
+{
+    QString root = folder.isEmpty() ? QString() : key(folder);
+    if (dirty) save();
+
+    // Files read from disk outside the new root go; tab text stays.
+    QStringList dropped;
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        if (it->modified >= 0 && (root.isEmpty() || !isUnder(it.key(), root))) dropped.append(it.key());
+    }
+    for (const QString &path : qAsConst(dropped)) {
+        remove(path);
+        emit fileUpdated(path);
+    }
+
+    rootPath = root;
+    int current = generation.fetchAndAddOrdered(1) + 1;
+    scanning = !root.isEmpty();
+    if (!scanning) return;
+
+    QHash<QString, File> known = files;
+    QString store = storeFile(root);
+    futures.append(QtConcurrent::run([this, current, root, known, store]() {
+        scan(current, root, known, store);
+    }));
+}
+
+void SymbolIndex::updateText(const QString &path, const QString &text)
+{
+    QString fileName = key(path);
+    int current = ++serial;
+    latest.insert(fileName, current);
+    futures.append(QtConcurrent::run([this, fileName, text, current]() {
+        Result result;
+        result.path = fileName;
+        result.serial = current;
+        result.file.size = -1;
+        result.file.modified = -1;
+        result.file.symbols = extract(text);
+        post(QVector<Result>() << result);
+    }));
+}
+
+void SymbolIndex::updateFile(const QString &path)
+{
+    QString fileName = key(path);
+    int current = ++serial;
+    latest.insert(fileName, current);
+    futures.append(QtConcurrent::run([this, fileName, current]() {
+        Result result;
+        result.path = fileName;
+        result.serial = current;
+        result.removed = !readFile(fileName, result.file);
+        post(QVector<Result>() << result);
+    }));
+}
+
+QVector<SymbolIndex::Location> SymbolIndex::find(const QString &name) const
+{
+    int split = name.lastIndexOf(QLatin1String("::"));
+    QString key = split < 0 ? name : name.mid(split + 2);
+    QString scope = split < 0 ? QString() : name.left(split);
+
+    QVector<Location> found;
+    auto refs = names.constFind(key);
+    if (refs == names.cend()) return found;
+    for (const Ref &ref : *refs) {
+        const Symbol &symbol = files.constFind(ref.path)->symbols.at(ref.index);
+        if (!scope.isEmpty() && symbol.scope != scope && !symbol.scope.endsWith("::" + scope)) continue;
+        found.append(Location{ref.path, symbol});
+    }
+    std::stable_partition(found.begin(), found.end(), [](const Location &location) {
+        return location.symbol.definition;
+    });
+    return found;
+}
+
+QVector<SymbolIndex::Symbol> SymbolIndex::symbols(const QString &path) const
+{
+    auto file = files.constFind(key(path));
+    return file == files.cend() ? QVector<Symbol>() : file->symbols;
+}
+
+void SymbolIndex::scan(int current, const QString &folder, QHash<QString, File> known, const QString &store)
+{
+    // What the last run stored counts as known; it reaches the GUI only
+    // for files the GUI has nothing newer for.
+    QVector<Result> batch;
+    const QHash<QString, File> stored = read(store, folder);
+    for (auto it = stored.cbegin(); it != stored.cend(); ++it) {
+        if (known.contains(it.key())) continue;
+        known.insert(it.key(), it.value());
+        Result result;
+        result.path = it.key();
+        result.file = it.value();
+        result.scan = current;
+        batch.append(result);
+        if (batch.size() >= BatchFiles * 16) {
+            post(batch);
+            batch.clear();
+        }
+    }
+
+    QStringList filters;
+    for (const char *suffix : sourceSuffixes) {
+        filters.append(QString("*.%1").arg(QLatin1String(suffix)));
+    }
+    QSet<QString> seen;
+    QDirIterator it(folder, filters, QDir::Files | QDir::NoSymLinks, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (generation.loadAcquire() != current) return;
+        QString path = it.next();
+        seen.insert(path);
+        QFileInfo info = it.fileInfo();
+        auto entry = known.constFind(path);
+        if (entry != known.cend() && (entry->modified < 0 || (entry->size == info.size()
+            && entry->modified == info.lastModified().toMSecsSinceEpoch()))) {
+            continue;
+        }
+        Result result;
+        result.path = path;
+        result.scan = current;
+        if (!readFile(path, result.file)) continue;
+        batch.append(result);
+        if (batch.size() >= BatchFiles) {
+            post(batch);
+            batch.clear();
+        }
+    }
+
+    for (auto entry = known.cbegin(); entry != known.cend(); ++entry) {
+        if (entry->modified < 0 || seen.contains(entry.key()) || !isUnder(entry.key(), folder)) continue;
+        Result result;
+        result.path = entry.key();
+        result.scan = current;
+        result.removed = true;
+        batch.append(result);
+    }
+    post(batch, current);
+}
+
+void SymbolIndex::post(const QVector<Result> &results, int finished)
+{
+    QMutexLocker locker(&mutex);
+    pending += results;
+    if (finished) finishedScan = finished;
+    if (resultsScheduled) return;
+    resultsScheduled = true;
+    QMetaObject::invokeMethod(this, "takeResults", Qt::QueuedConnection);
+}
+
+void SymbolIndex::takeResults()
+{
+    QVector<Result> results;
+    int finished = 0;
+    {
+        QMutexLocker locker(&mutex);
+        results.swap(pending);
+        finished = finishedScan;
+        finishedScan = 0;
+        resultsScheduled = false;
+    }
+    for (int i = futures.size() - 1; i >= 0; --i) {
+        if (futures.at(i).isFinished()) futures.removeAt(i);
+    }
+
+    int current = generation.loadAcquire();
+    QSet<QString> updated;
+    for (const Result &result : qAsConst(results)) {
+        if (result.serial) {
+            // Only the newest update of a path counts.
+            if (latest.value(result.path) != result.serial) continue;
+            latest.remove(result.path);
+        } else {
+            // A scan never overrides a tab's text or an update in flight.
+            if (result.scan != current || latest.contains(result.path)) continue;
+            auto file = files.constFind(result.path);
+            if (file != files.cend() && file->modified < 0) continue;
+        }
+        if (result.removed) {
+            remove(result.path);
+        } else {
+            replace(result.path, result.file);
+        }
+        updated.insert(result.path);
+    }
+
+    for (const QString &path : qAsConst(updated)) {
+        emit fileUpdated(path);
+    }
+    if (!updated.isEmpty()) {
+        dirty = true;
+        saveTimer->start();
+    }
+    if (finished && finished == current) {
+        scanning = false;
+        emit scanFinished(int(files.size()));
+    }
+}
+
+void SymbolIndex::replace(const QString &path, const File &file)
+{
+    remove(path);
+    files.insert(path, file);
+    for (int i = 0; i < file.symbols.size(); ++i) {
+        names[file.symbols.at(i).name].append(Ref{path, i});
+    }
+}
+
+void SymbolIndex::remove(const QString &path)
+{
+    auto file = files.find(path);
+    if (file == files.end()) return;
+    for (const Symbol &symbol : qAsConst(file->symbols)) {
+        auto refs = names.find(symbol.name);
+        if (refs == names.end()) continue;
+        refs->erase(std::remove_if(refs->begin(), refs->end(), [&path](const Ref &ref) {
+            return ref.path == path;
+        }), refs->end());
+        if (refs->isEmpty()) names.erase(refs);
+    }
+    files.erase(file);
+}
+
+void SymbolIndex::save()
+{
+    saveTimer->stop();
+    if (!dirty || rootPath.isEmpty()) return;
+    dirty = false;
+    // The hash is shared, not copied; the GUI detaches on its next change.
+    QHash<QString, File> snapshot = files;
+    QString root = rootPath;
+    QString store = storeFile(root);
+    futures.append(QtConcurrent::run([store, root, snapshot]() {
+        write(store, root, snapshot);
+    }));
+}
+
+QString SymbolIndex::storeFile(const QString &folder) const
+{
+    QByteArray hash = QCryptographicHash::hash(folder.toUtf8(), QCryptographicHash::Md5).toHex();
+    return storeDirectory + "/symbols-" + QString::fromLatin1(hash.left(16)) + ".dat";
+}
+
+bool SymbolIndex::isUnder(const QString &path, const QString &folder)
+{
+    return path.size() > folder.size() && path.startsWith(folder) && path.at(folder.size()) == QLatin1Char('/');
+}
+
+bool SymbolIndex::readFile(const QString &path, File &file)
+{
+    QFileInfo info(path);
+    QFile input(path);
+    if (!info.isFile() || !input.open(QFile::ReadOnly)) return false;
+    file.size = info.size();
+    file.modified = info.lastModified().toMSecsSinceEpoch();
+    file.symbols.clear();
+    // Generated sources of this size are not worth a lookup.
+    if (file.size <= MaxFileBytes) {
+        file.symbols = extract(QString::fromUtf8(input.readAll()));
+    }
+    return true;
+}
+
+// Layout: magic, version, root folder, then one compressed block holding a
+// string table and the files, whose paths, names and scopes are indexes
+// into the table.
+QHash<QString, SymbolIndex::File> SymbolIndex::read(const QString &fileName, const QString &folder)
+{
+    QHash<QString, File> result;
+    QFile input(fileName);
+    if (!input.open(QFile::ReadOnly)) return result;
+
+    QDataStream header(&input);
+    header.setVersion(QDataStream::Qt_5_15);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString root;
+    QByteArray compressed;
+    header >> magic >> version;
+    if (magic != Magic || version != Version) return result;
+    header >> root >> compressed;
+    if (root != folder || header.status() != QDataStream::Ok) return result;
+
+    QByteArray payload = qUncompress(compressed);
+    QDataStream in(&payload, QIODevice::ReadOnly);
+    in.setVersion(QDataStream::Qt_5_15);
+    QStringList strings;
+    quint32 fileCount = 0;
+    in >> strings >> fileCount;
+    quint32 stringCount = quint32(strings.size());
+    for (quint32 i = 0; i < fileCount && in.status() == QDataStream::Ok; ++i) {
+        quint32 path = 0;
+        quint32 symbolCount = 0;
+        File file;
+        in >> path >> file.size >> file.modified >> symbolCount;
+        if (path >= stringCount || symbolCount > quint32(payload.size())) return QHash<QString, File>();
+        file.symbols.reserve(int(symbolCount));
+        for (quint32 j = 0; j < symbolCount; ++j) {
+            quint32 name = 0;
+            quint32 scope = 0;
+            quint8 kind = 0;
+            quint8 definition = 0;
+            qint32 line = 0;
+            qint32 column = 0;
+            in >> name >> scope >> kind >> definition >> line >> column;
+            if (name >= stringCount || scope >= stringCount || kind >= KindCount) return QHash<QString, File>();
+            file.symbols.append(Symbol{strings.at(int(name)), strings.at(int(scope)), kind, line, column, definition != 0});
+        }
+        result.insert(strings.at(int(path)), file);
+    }
+    if (in.status() != QDataStream::Ok) result.clear();
+    return result;
+}
+
+bool SymbolIndex::write(const QString &fileName, const QString &folder, const QHash<QString, File> &files)
+{
+    static QMutex writing;
+    QMutexLocker locker(&writing);
+
+    QHash<QString, quint32> ids;
+    QStringList strings;
+    auto intern = [&ids, &strings](const QString &text) {
+        auto found = ids.constFind(text);
+        if (found != ids.cend()) return found.value();
+        quint32 id = quint32(strings.size());
+        ids.insert(text, id);
+        strings.append(text);
+        return id;
+    };
+
+    QByteArray body;
+    quint32 fileCount = 0;
+    {
+        QDataStream out(&body, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_15);
+        for (auto it = files.cbegin(); it != files.cend(); ++it) {
+            if (it->modified < 0 || !isUnder(it.key(), folder)) continue;
+            out << intern(it.key()) << it->size << it->modified << quint32(it->symbols.size());
+            for (const Symbol &symbol : it->symbols) {
+                out << intern(symbol.name) << intern(symbol.scope) << quint8(symbol.kind) << quint8(symbol.definition)
+                    << qint32(symbol.line) << qint32(symbol.column);
+            }
+            ++fileCount;
+        }
+    }
+
+    QByteArray payload;
+    {
+        QDataStream table(&payload, QIODevice::WriteOnly);
+        table.setVersion(QDataStream::Qt_5_15);
+        table << strings << fileCount;
+    }
+    payload += body;
+
+    QSaveFile output(fileName);
+    if (!output.open(QFile::WriteOnly)) return false;
+    QDataStream stream(&output);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << Magic << Version << folder << qCompress(payload);
+    return stream.status() == QDataStream::Ok && output.commit();
+}
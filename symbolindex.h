@@ -0,0 +1,128 @@
+#ifndef SYMBOLINDEX_H
+#define SYMBOLINDEX_H
+
+#include <QAtomicInt>
+#include <QFuture>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+
+class QTimer;
+
+// Namespaces, classes, functions and macros of the C++ files below a
+// project folder and in the open tabs. Files are lexed with CppLexer on the
+// thread pool and merged on the GUI thread, where a lookup is one hash
+// probe. Between runs the index lives in a compact file per project; a
+// rescan only stats the tree and re-lexes files whose size or modification
+// time changed, and an edit re-lexes just the edited tab.
+class SymbolIndex : public QObject
+{
+    Q_OBJECT
+public:
+    enum Kind { Namespace, Class, Struct, Union, Enum, Function, Macro, KindCount };
+
+    struct Symbol
+    {
+        QString name;
+        QString scope;
+        int kind;
+        int line;
+        int column;
+        bool definition;
+
+        QString qualifiedName() const { return scope.isEmpty() ? name : scope + "::" + name; }
+    };
+
+    struct Location
+    {
+        QString path;
+        Symbol symbol;
+    };
+
+    SymbolIndex(const QString &storeDirectory, QObject *parent = nullptr);
+    ~SymbolIndex();
+
+    void setRoot(const QString &folder);
+    QString root() const { return rootPath; }
+    void updateText(const QString &path, const QString &text);
+    void updateFile(const QString &path);
+
+    // Definitions come first. A qualified name ("Foo::bar") only matches
+    // symbols whose scope ends with the qualifier.
+    QVector<Location> find(const QString &name) const;
+    QVector<Symbol> symbols(const QString &path) const;
+    bool isScanning() const { return scanning; }
+
+    static QString key(const QString &path);
+    static bool isSource(const QString &path);
+    static QVector<Symbol> extract(const QString &text);
+
+signals:
+    void fileUpdated(const QString &path);
+    void scanFinished(int files);
+
+private slots:
+    void takeResults();
+    void save();
+
+private:
+    static const int BatchFiles = 64;
+    static const int SaveDelay = 5000;
+    static const qint64 MaxFileBytes = 4 * 1024 * 1024;
+    static const quint32 Magic = 0x4E565349;
+    static const quint32 Version = 1;
+
+    // modified is -1 for symbols taken from a tab's text rather than the
+    // file on disk; a rescan leaves those alone.
+    struct File
+    {
+        qint64 size = 0;
+        qint64 modified = 0;
+        QVector<Symbol> symbols;
+    };
+
+    struct Ref
+    {
+        QString path;
+        int index;
+    };
+
+    struct Result
+    {
+        QString path;
+        File file;
+        int scan = 0;
+        int serial = 0;
+        bool removed = false;
+    };
+
+    void scan(int current, const QString &folder, QHash<QString, File> known, const QString &store);
+    void post(const QVector<Result> &results, int finishedScan = 0);
+    void replace(const QString &path, const File &file);
+    void remove(const QString &path);
+    QString storeFile(const QString &folder) const;
+    static bool isUnder(const QString &path, const QString &folder);
+    static bool readFile(const QString &path, File &file);
+    static QHash<QString, File> read(const QString &fileName, const QString &folder);
+    static bool write(const QString &fileName, const QString &folder, const QHash<QString, File> &files);
+
+    QString storeDirectory;
+    QString rootPath;
+    QHash<QString, File> files;
+    QHash<QString, QVector<Ref>> names;
+    QHash<QString, int> latest;
+    QTimer *saveTimer;
+    QList<QFuture<void>> futures;
+    QAtomicInt generation;
+    int serial;
+    bool scanning;
+    bool dirty;
+
+    QMutex mutex;
+    QVector<Result> pending;
+    int finishedScan;
+    bool resultsScheduled;
+};
+
+#endif
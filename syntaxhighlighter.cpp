@@ -0,0 +1,190 @@
+#include "syntaxhighlighter.h"
+#include "blockdata.h"
+#include "structureindex.h"
+#include "tracer.h"
+#include <QElapsedTimer>
+#include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QTextDocument>
+#include <QTimer>
+
+int SyntaxHighlighter::lastGeneration = 0;
+
+SyntaxHighlighter::SyntaxHighlighter(QPlainTextEdit *editor)
+    : QObject(editor), editor(editor), document(editor->document()), generation(++lastGeneration),
+      pendingFrom(-1), dirtyUntil(-1), blockCount(editor->document()->blockCount()),
+      changedFrom(-1), changedTo(-1), applying(false)
+{
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setInterval(0);
+    connect(timer, &QTimer::timeout, this, &SyntaxHighlighter::processPending);
+    structure = editor->findChild<StructureIndex*>(QString(), Qt::FindDirectChildrenOnly);
+    connect(document, &QTextDocument::contentsChange, this, &SyntaxHighlighter::onContentsChange);
+    connect(editor->verticalScrollBar(), &QScrollBar::valueChanged, this, &SyntaxHighlighter::highlightVisible);
+
+    markPending(0, blockCount - 1);
+}
+
+void SyntaxHighlighter::rehighlight()
+{
+    generation = ++lastGeneration;
+    blockCount = document->blockCount();
+    markPending(0, blockCount - 1);
+}
+
+BlockData *SyntaxHighlighter::blockData(QTextBlock block)
+{
+    return BlockData::of(block);
+}
+
+void SyntaxHighlighter::onContentsChange(int position, int removed, int added)
+{
+    Q_UNUSED(removed);
+    if (applying) return;
+
+    QTextBlock first = document->findBlock(position);
+    QTextBlock last = document->findBlock(position + added);
+    if (!first.isValid()) first = document->lastBlock();
+    if (!last.isValid()) last = document->lastBlock();
+
+    // Blocks inside the change are new, only the two ends keep old data.
+    BlockData *data = static_cast<BlockData*>(first.userData());
+    if (data) data->previousState = -1;
+    data = static_cast<BlockData*>(last.userData());
+    if (data) data->previousState = -1;
+
+    int firstNumber = first.blockNumber();
+    int lastNumber = last.blockNumber();
+    int delta = document->blockCount() - blockCount;
+    blockCount = document->blockCount();
+    if (dirtyUntil >= firstNumber) {
+        dirtyUntil = qMax(dirtyUntil + delta, lastNumber);
+    }
+    markPending(firstNumber, lastNumber);
+
+    // Highlight what was typed right away, like QSyntaxHighlighter does, but
+    // only a bounded number of blocks; the rest goes to the timer.
+    if (lastNumber - firstNumber < SyncBlocks) {
+        QTextBlock block = first;
+        for (int i = 0; i < SyncBlocks && block.isValid(); ++i) {
+            int previousState = block.previous().isValid() ? block.previous().userState() : -1;
+            if (block.blockNumber() > lastNumber && !needsHighlight(block, previousState)) break;
+            highlight(block, previousState);
+            block = block.next();
+        }
+        flushFormats();
+    }
+}
+
+void SyntaxHighlighter::highlightVisible()
+{
+    TRACE_SCOPE("SyntaxHighlighter::highlightVisible");
+    if (pendingFrom < 0) return;
+
+    // Blocks in view are highlighted from whatever state the block above
+    // has now; if that was stale, the in-order pass corrects them later.
+    QTextBlock block = editor->cursorForPosition(QPoint(0, 0)).block();
+    QTextBlock end = editor->cursorForPosition(QPoint(0, editor->viewport()->height())).block();
+    if (block.blockNumber() < pendingFrom) {
+        block = document->findBlockByNumber(pendingFrom);
+    }
+    if (!block.isValid() || block.blockNumber() > end.blockNumber()) return;
+
+    bool highlighted = false;
+    while (block.isValid()) {
+        int previousState = block.previous().isValid() ? block.previous().userState() : -1;
+        if (needsHighlight(block, previousState)) {
+            highlight(block, previousState);
+            highlighted = true;
+        }
+        if (block == end) break;
+        block = block.next();
+    }
+    if (highlighted) {
+        dirtyUntil = qMax(dirtyUntil, end.blockNumber() + 1);
+    }
+    flushFormats();
+}
+
+void SyntaxHighlighter::processPending()
+{
+    TRACE_SCOPE("SyntaxHighlighter::processPending");
+    if (pendingFrom < 0) return;
+    highlightVisible();
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    QTextBlock block = document->findBlockByNumber(pendingFrom);
+    int count = 0;
+    while (block.isValid()) {
+        int previousState = block.previous().isValid() ? block.previous().userState() : -1;
+        if (needsHighlight(block, previousState)) {
+            highlight(block, previousState);
+        } else if (block.blockNumber() > dirtyUntil) {
+            break;
+        }
+        block = block.next();
+
+        if (++count % 16 == 0 && elapsed.elapsed() >= SliceMsecs && block.isValid()) {
+            pendingFrom = block.blockNumber();
+            flushFormats();
+            timer->start();
+            return;
+        }
+    }
+
+    pendingFrom = -1;
+    dirtyUntil = -1;
+    flushFormats();
+}
+
+bool SyntaxHighlighter::needsHighlight(const QTextBlock &block, int previousState) const
+{
+    // A block the structure index could not take in yet, because the one
+    // above was not in it, is read again when the in-order pass gets there.
+    BlockData *data = static_cast<BlockData*>(block.userData());
+    return !data || data->previousState != previousState || data->generation != generation
+        || (structure && !data->structureNode);
+}
+
+void SyntaxHighlighter::highlight(QTextBlock block, int previousState)
+{
+    ranges.clear();
+    int state = highlightLine(block.text(), block, previousState, ranges);
+
+    BlockData *data = blockData(block);
+    data->previousState = previousState;
+    data->generation = generation;
+    block.setUserState(state);
+    if (structure) structure->update(block);
+
+    QTextLayout *layout = block.layout();
+    if (layout->formats() != ranges) {
+        layout->setFormats(ranges);
+        int from = block.position();
+        int to = from + block.length();
+        changedFrom = changedFrom < 0 ? from : qMin(changedFrom, from);
+        changedTo = qMax(changedTo, to);
+    }
+}
+
+void SyntaxHighlighter::markPending(int from, int until)
+{
+    pendingFrom = pendingFrom < 0 ? from : qMin(pendingFrom, from);
+    dirtyUntil = qMax(dirtyUntil, until);
+    timer->start();
+}
+
+void SyntaxHighlighter::flushFormats()
+{
+    if (changedFrom < 0) return;
+
+    // One relayout for everything recoloured in this pass; the guard keeps
+    // the resulting contentsChange from looking like an edit.
+    applying = true;
+    document->markContentsDirty(changedFrom, changedTo - changedFrom);
+    applying = false;
+    changedFrom = -1;
+    changedTo = -1;
+}
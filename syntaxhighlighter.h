@@ -0,0 +1,70 @@
+#ifndef SYNTAXHIGHLIGHTER_H
+#define SYNTAXHIGHLIGHTER_H
+
+#include <QObject>
+#include <QTextBlock>
+#include <QTextLayout>
+#include <QVector>
+
+class BlockData;
+class QPlainTextEdit;
+class QTextDocument;
+class QTimer;
+class StructureIndex;
+
+// Replacement for QSyntaxHighlighter that never highlights the whole
+// document in one go. An edit rehighlights the changed blocks (and a few
+// after them) immediately; everything else is done in short slices from
+// the event loop, visible blocks first. A block is redone only when the
+// state it was highlighted from changed, so later edits simply move the
+// pending range and any work past them is revalidated instead of reused.
+// Each highlighted block is also handed to the editor's StructureIndex.
+class SyntaxHighlighter : public QObject
+{
+    Q_OBJECT
+public:
+    SyntaxHighlighter(QPlainTextEdit *editor);
+
+    void rehighlight();
+    bool isPending() const { return pendingFrom >= 0; }
+
+protected:
+    // Appends the formats for one line and returns the state the next
+    // line starts in. previousState is -1 for the first block.
+    virtual int highlightLine(const QString &text, const QTextBlock &block, int previousState,
+                              QVector<QTextLayout::FormatRange> &formats) = 0;
+
+    static BlockData *blockData(QTextBlock block);
+
+private slots:
+    void onContentsChange(int position, int removed, int added);
+    void processPending();
+    void highlightVisible();
+
+private:
+    static const int SyncBlocks = 64;
+    static const int SliceMsecs = 4;
+    // Generations are unique across highlighters, so one that replaces
+    // another on the same editor redoes every block.
+    static int lastGeneration;
+
+    bool needsHighlight(const QTextBlock &block, int previousState) const;
+    void highlight(QTextBlock block, int previousState);
+    void markPending(int from, int until);
+    void flushFormats();
+
+    QPlainTextEdit *editor;
+    QTextDocument *document;
+    QTimer *timer;
+    StructureIndex *structure;
+    QVector<QTextLayout::FormatRange> ranges;
+    int generation;
+    int pendingFrom;
+    int dirtyUntil;
+    int blockCount;
+    int changedFrom;
+    int changedTo;
+    bool applying;
+};
+
+#endif
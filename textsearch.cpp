@@ -0,0 +1,244 @@
+#include "textsearch.h"
+#include <QStringView>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NOVA_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+int indexOfScalar(const ushort *data, int length, ushort a, ushort b)
+{
+    for (int i = 0; i < length; ++i) {
+        if (data[i] == a || data[i] == b) return i;
+    }
+    return -1;
+}
+
+#ifdef NOVA_X86_SIMD
+// Both candidates (the two cases of the first character) are compared at
+// once; the byte mask has two bits per UTF-16 unit.
+__attribute__((target("sse2")))
+int indexOfSse2(const ushort *data, int length, ushort a, ushort b)
+{
+    const __m128i first = _mm_set1_epi16(short(a));
+    const __m128i second = _mm_set1_epi16(short(b));
+    int i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i equal = _mm_or_si128(_mm_cmpeq_epi16(units, first), _mm_cmpeq_epi16(units, second));
+        quint32 mask = quint32(_mm_movemask_epi8(equal));
+        if (mask) return i + __builtin_ctz(mask) / 2;
+    }
+    int pos = indexOfScalar(data + i, length - i, a, b);
+    return pos < 0 ? -1 : i + pos;
+}
+
+__attribute__((target("avx2")))
+int indexOfAvx2(const ushort *data, int length, ushort a, ushort b)
+{
+    const __m256i first = _mm256_set1_epi16(short(a));
+    const __m256i second = _mm256_set1_epi16(short(b));
+    int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        __m256i equal = _mm256_or_si256(_mm256_cmpeq_epi16(units, first), _mm256_cmpeq_epi16(units, second));
+        quint32 mask = quint32(_mm256_movemask_epi8(equal));
+        if (mask) return i + __builtin_ctz(mask) / 2;
+    }
+    int pos = indexOfSse2(data + i, length - i, a, b);
+    return pos < 0 ? -1 : i + pos;
+}
+#endif
+
+typedef int (*IndexOfFunction)(const ushort *, int, ushort, ushort);
+
+IndexOfFunction selectIndexOf()
+{
+#ifdef NOVA_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return indexOfAvx2;
+    if (__builtin_cpu_supports("sse2")) return indexOfSse2;
+#endif
+    return indexOfScalar;
+}
+
+bool isWordCharacter(QChar c)
+{
+    return c.isLetterOrNumber() || c == QLatin1Char('_');
+}
+
+}
+
+TextSearch::TextSearch(const Options &options)
+    : options(options),
+      literalSpansLines(options.singleLine
+                        && (options.pattern.contains(QLatin1Char('\n')) || options.pattern.contains(QLatin1Char('\r'))))
+{
+    if (options.regularExpression) {
+        QString pattern = options.wholeWords ? "\\b(?:" + options.pattern + ")\\b" : options.pattern;
+        QRegularExpression::PatternOptions flags = QRegularExpression::UseUnicodePropertiesOption
+                                                 | QRegularExpression::MultilineOption;
+        if (!options.caseSensitive) flags |= QRegularExpression::CaseInsensitiveOption;
+        regex.setPattern(pattern);
+        regex.setPatternOptions(flags);
+        // Compile (and JIT, which Qt enables by default) once up front
+        // instead of on first use in every worker.
+        regex.optimize();
+    } else if (!options.pattern.isEmpty()) {
+        QChar c = options.pattern.at(0);
+        first[0] = options.caseSensitive ? c : c.toLower();
+        first[1] = options.caseSensitive ? c : c.toUpper();
+    }
+}
+
+bool TextSearch::isValid() const
+{
+    if (options.pattern.isEmpty()) return false;
+    return !options.regularExpression || regex.isValid();
+}
+
+QString TextSearch::errorString() const
+{
+    return options.regularExpression ? regex.errorString() : QString();
+}
+
+int TextSearch::indexOf(const QChar *data, int length, QChar a, QChar b)
+{
+    static const IndexOfFunction selected = selectIndexOf();
+    if (length <= 0) return -1;
+    return selected(reinterpret_cast<const ushort *>(data), length, a.unicode(), b.unicode());
+}
+
+void TextSearch::findAll(const QString &text, const std::function<bool(const Match &)> &found) const
+{
+    if (!isValid()) return;
+
+    if (options.regularExpression) {
+        matchRegex(text, [&](int offset, const QRegularExpressionMatch &match) {
+            return found(Match{offset + int(match.capturedStart()), int(match.capturedLength())});
+        });
+        return;
+    }
+
+    int length = options.pattern.size();
+    for (int pos = findLiteral(text, 0); pos >= 0; pos = findLiteral(text, pos + length)) {
+        if (!found(Match{pos, length})) return;
+    }
+}
+
+TextSearch::Replacement TextSearch::replaceAll(const QString &text, const QString &replacement) const
+{
+    // Everything between the first and the last match is rebuilt into one
+    // string, so the caller can apply it as a single edit.
+    Replacement result;
+    int copied = 0;
+    auto replace = [&](int position, int length, const QString &with) {
+        if (result.count == 0) {
+            result.from = position;
+        } else {
+            result.text.append(text.constData() + copied, position - copied);
+        }
+        result.text += with;
+        copied = position + length;
+        ++result.count;
+    };
+
+    if (!isValid()) return result;
+    if (options.regularExpression) {
+        matchRegex(text, [&](int offset, const QRegularExpressionMatch &match) {
+            replace(offset + int(match.capturedStart()), int(match.capturedLength()), expand(match, replacement));
+            return true;
+        });
+    } else {
+        int length = options.pattern.size();
+        for (int pos = findLiteral(text, 0); pos >= 0; pos = findLiteral(text, pos + length)) {
+            replace(pos, length, replacement);
+        }
+    }
+    result.to = copied;
+    return result;
+}
+
+void TextSearch::matchRegex(const QString &text, const std::function<bool(int, const QRegularExpressionMatch &)> &found) const
+{
+    // 'found' gets each match with the offset of the string it was made in.
+    if (!options.singleLine) {
+        QRegularExpressionMatchIterator it = regex.globalMatch(text);
+        while (it.hasNext()) {
+            if (!found(0, it.next())) return;
+        }
+        return;
+    }
+
+    // Text after the last line feed is a line of its own only if there is
+    // any, so a block that ends on a line feed adds no empty line.
+    const int size = int(text.size());
+    int start = 0;
+    while (start < size) {
+        int newline = indexOf(text.constData() + start, size - start, QLatin1Char('\n'), QLatin1Char('\n'));
+        int end = newline < 0 ? size : start + newline;
+        int length = end > start && text.at(end - 1) == QLatin1Char('\r') ? end - 1 - start : end - start;
+        QRegularExpressionMatchIterator it = regex.globalMatch(text.mid(start, length));
+        while (it.hasNext()) {
+            if (!found(start, it.next())) return;
+        }
+        start = end + 1;
+    }
+}
+
+int TextSearch::findLiteral(const QString &text, int from) const
+{
+    // Scan for the first character, then verify the rest in place.
+    if (literalSpansLines) return -1;
+    int length = options.pattern.size();
+    int last = int(text.size()) - length;
+    Qt::CaseSensitivity sensitivity = options.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    QStringView needle(options.pattern);
+    int pos = from;
+    while (pos <= last) {
+        int found = indexOf(text.constData() + pos, last + 1 - pos, first[0], first[1]);
+        if (found < 0) return -1;
+        pos += found;
+        if (QStringView(text.constData() + pos, length).compare(needle, sensitivity) == 0
+            && (!options.wholeWords || isWholeWord(text, pos, length))) {
+            return pos;
+        }
+        ++pos;
+    }
+    return -1;
+}
+
+bool TextSearch::isWholeWord(const QString &text, int position, int length) const
+{
+    int end = position + length;
+    if (position > 0 && isWordCharacter(text.at(position - 1))) return false;
+    return end >= text.size() || !isWordCharacter(text.at(end));
+}
+
+QString TextSearch::expand(const QRegularExpressionMatch &match, const QString &replacement) const
+{
+    // \0 to \9 insert captures, \n and \t the usual characters.
+    if (!replacement.contains(QLatin1Char('\\'))) return replacement;
+
+    QString result;
+    for (int i = 0; i < replacement.size(); ++i) {
+        QChar c = replacement.at(i);
+        if (c != QLatin1Char('\\') || i + 1 == replacement.size()) {
+            result += c;
+            continue;
+        }
+        QChar next = replacement.at(++i);
+        if (next.isDigit()) {
+            result += match.captured(next.digitValue());
+        } else if (next == QLatin1Char('n')) {
+            result += QLatin1Char('\n');
+        } else if (next == QLatin1Char('t')) {
+            result += QLatin1Char('\t');
+        } else {
+            result += next;
+        }
+    }
+    return result;
+}
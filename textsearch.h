@@ -0,0 +1,65 @@
+#ifndef TEXTSEARCH_H
+#define TEXTSEARCH_H
+
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+// Literal or regular expression search over a text snapshot. Copies are
+// cheap and independent, so each worker thread takes its own.
+class TextSearch
+{
+public:
+    struct Options
+    {
+        QString pattern;
+        bool caseSensitive = false;
+        bool wholeWords = false;
+        bool regularExpression = false;
+        // Matches never span a line end: a regular expression is run over
+        // each line, without its "\n" or "\r\n", on its own, so results do
+        // not depend on how the text was cut into blocks of whole lines.
+        bool singleLine = false;
+    };
+
+    struct Match
+    {
+        int position;
+        int length;
+    };
+
+    // One edit that replaces every match: text replaces [from, to).
+    struct Replacement
+    {
+        int from = 0;
+        int to = 0;
+        int count = 0;
+        QString text;
+    };
+
+    explicit TextSearch(const Options &options);
+
+    bool isValid() const;
+    QString errorString() const;
+
+    // Calls found for each match in order until it returns false.
+    void findAll(const QString &text, const std::function<bool(const Match &)> &found) const;
+    Replacement replaceAll(const QString &text, const QString &replacement) const;
+
+    // First index in data of a or b, or -1; vectorised like NewlineScanner.
+    static int indexOf(const QChar *data, int length, QChar a, QChar b);
+
+private:
+    void matchRegex(const QString &text, const std::function<bool(int, const QRegularExpressionMatch &)> &found) const;
+    int findLiteral(const QString &text, int from) const;
+    bool isWholeWord(const QString &text, int position, int length) const;
+    QString expand(const QRegularExpressionMatch &match, const QString &replacement) const;
+
+    Options options;
+    QRegularExpression regex;
+    QChar first[2];
+    bool literalSpansLines;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "tracer.h"
+#include <QCoreApplication>
+#include <QMutex>
+#include <QThread>
+#include <atomic>
+#include <chrono>
+
+namespace {
+
+const quint64 Capacity = 1 << 16;
+
+struct Ring
+{
+    Tracer::Event events[Capacity];
+    QAtomicInteger<quint64> head{0};
+    QAtomicInt owned{1};
+    bool gui = false;
+};
+
+// Rings are never freed: one left behind by a thread that exited keeps its
+// events for the export and is reused by the next new thread.
+QMutex ringsMutex;
+QVector<Ring*> rings;
+
+struct RingHandle
+{
+    Ring *ring = nullptr;
+
+    ~RingHandle()
+    {
+        if (ring) ring->owned.storeRelease(0);
+    }
+};
+
+thread_local RingHandle handle;
+
+Ring *threadRing()
+{
+    if (handle.ring) return handle.ring;
+
+    QMutexLocker locker(&ringsMutex);
+    Ring *ring = nullptr;
+    for (Ring *candidate : qAsConst(rings)) {
+        if (candidate->owned.testAndSetAcquire(0, 1)) {
+            ring = candidate;
+            break;
+        }
+    }
+    if (!ring) {
+        ring = new Ring;
+        rings.append(ring);
+    }
+    QCoreApplication *app = QCoreApplication::instance();
+    ring->gui = app && QThread::currentThread() == app->thread();
+    handle.ring = ring;
+    return ring;
+}
+
+// The events of 'ring' from 'cursor' on that are still in it. The writer
+// keeps going while they are copied; whatever it may have overwritten by
+// the end is dropped.
+QVector<Tracer::Event> copyRing(const Ring *ring, quint64 &cursor)
+{
+    quint64 end = ring->head.loadAcquire();
+    quint64 begin = qMax(cursor, end > Capacity ? end - Capacity : 0);
+    QVector<Tracer::Event> events;
+    events.reserve(int(end - begin));
+    for (quint64 i = begin; i < end; ++i) {
+        events.append(ring->events[i % Capacity]);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    quint64 after = ring->head.loadAcquire();
+    quint64 safe = after >= Capacity ? after - Capacity + 1 : 0;
+    if (safe > begin) events.remove(0, int(qMin(safe, end) - begin));
+    cursor = end;
+    return events;
+}
+
+}
+
+QAtomicInt Tracer::enabled(0);
+
+void Tracer::setEnabled(bool on)
+{
+    enabled.storeRelaxed(on ? 1 : 0);
+}
+
+qint64 Tracer::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::record(const char *name, qint64 start, qint64 end)
+{
+    // Only this thread writes the ring; publishing the new head is the one
+    // synchronising step.
+    Ring *ring = threadRing();
+    quint64 head = ring->head.loadRelaxed();
+    ring->events[head % Capacity] = Event{name, start, end};
+    ring->head.storeRelease(head + 1);
+}
+
+QVector<Tracer::Event> Tracer::threadEvents(quint64 &cursor)
+{
+    return copyRing(threadRing(), cursor);
+}
+
+QByteArray Tracer::chromeTrace()
+{
+    QVector<QVector<Event>> threads;
+    QVector<bool> gui;
+    {
+        QMutexLocker locker(&ringsMutex);
+        for (const Ring *ring : qAsConst(rings)) {
+            quint64 cursor = 0;
+            threads.append(copyRing(ring, cursor));
+            gui.append(ring->gui);
+        }
+    }
+
+    qint64 origin = -1;
+    for (const QVector<Event> &events : qAsConst(threads)) {
+        for (const Event &event : events) {
+            if (origin < 0 || event.start < origin) origin = event.start;
+        }
+    }
+
+    // Complete ("X") events with times in microseconds from the first
+    // span; one metadata event names each thread.
+    QByteArray json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (int tid = 0; tid < threads.size(); ++tid) {
+        QByteArray thread = QByteArray::number(tid + 1);
+        if (!first) json += ',';
+        first = false;
+        json += "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + thread + ",\"args\":{\"name\":\""
+              + (gui.at(tid) ? QByteArray("GUI") : "Worker " + thread) + "\"}}";
+        for (const Event &event : threads.at(tid)) {
+            json += ",\n{\"name\":\"";
+            json += event.name;
+            json += "\",\"cat\":\"nova\",\"ph\":\"X\",\"pid\":1,\"tid\":" + thread;
+            json += ",\"ts\":" + QByteArray::number(double(event.start - origin) / 1000, 'f', 3);
+            json += ",\"dur\":" + QByteArray::number(double(event.end - event.start) / 1000, 'f', 3) + '}';
+        }
+    }
+    json += "\n]}\n";
+    return json;
+}
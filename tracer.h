@@ -0,0 +1,62 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QVector>
+
+// Scoped timing spans for the hot paths. Each thread writes into its own
+// fixed ring of events with no lock and no allocation, overwriting the
+// oldest; readers copy a ring and drop whatever the writer may have
+// overwritten meanwhile. While tracing is off a span costs one relaxed
+// load. The rings export as Chrome trace_event JSON (chrome://tracing,
+// Perfetto). Span names must be string literals: only the pointer is kept.
+class Tracer
+{
+public:
+    struct Event
+    {
+        const char *name;
+        qint64 start;
+        qint64 end;
+    };
+
+    static bool isEnabled() { return enabled.loadRelaxed() != 0; }
+    static void setEnabled(bool on);
+
+    // Nanoseconds on a monotonic clock.
+    static qint64 now();
+    static void record(const char *name, qint64 start, qint64 end);
+
+    // Events the calling thread recorded after 'cursor', which is moved
+    // past them; for polling a thread's own ring.
+    static QVector<Event> threadEvents(quint64 &cursor);
+    static QByteArray chromeTrace();
+
+private:
+    static QAtomicInt enabled;
+};
+
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name)
+        : name(Tracer::isEnabled() ? name : nullptr), start(this->name ? Tracer::now() : 0) {}
+    ~TraceSpan()
+    {
+        if (name) Tracer::record(name, start, Tracer::now());
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name;
+    qint64 start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#endif
@@ -0,0 +1,562 @@
+#include "undohistory.h"
+#include <QDataStream>
+#include <QHash>
+#include <QPlainTextEdit>
+#include <QTemporaryFile>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// One temporary file holds the spilled history of every tab. Blobs are
+// appended and released; once released bytes outweigh live ones the live
+// blobs are copied to a fresh file.
+class SpillFile
+{
+public:
+    static SpillFile &instance()
+    {
+        static SpillFile spill;
+        return spill;
+    }
+
+    ~SpillFile()
+    {
+        delete file;
+    }
+
+    quint64 store(const QByteArray &data)
+    {
+        if (!file) {
+            file = new QTemporaryFile();
+            if (!file->open()) {
+                delete file;
+                file = nullptr;
+                return 0;
+            }
+        }
+        if (!file->seek(end) || file->write(data) != data.size()) return 0;
+
+        Blob blob{end, int(data.size())};
+        end += blob.length;
+        live += blob.length;
+        blobs.insert(nextId, blob);
+        return nextId++;
+    }
+
+    QByteArray load(quint64 id)
+    {
+        auto it = blobs.constFind(id);
+        if (it == blobs.constEnd() || !file || !file->seek(it->offset)) return QByteArray();
+        return file->read(it->length);
+    }
+
+    void release(quint64 id)
+    {
+        auto it = blobs.find(id);
+        if (it == blobs.end()) return;
+        live -= it->length;
+        dead += it->length;
+        blobs.erase(it);
+
+        if (blobs.isEmpty()) {
+            delete file;
+            file = nullptr;
+            end = live = dead = 0;
+        } else if (dead > CompactSlack && dead > live) {
+            compact();
+        }
+    }
+
+private:
+    static const qint64 CompactSlack = 64 * 1024 * 1024;
+
+    struct Blob
+    {
+        qint64 offset;
+        int length;
+    };
+
+    void compact()
+    {
+        QTemporaryFile *fresh = new QTemporaryFile();
+        if (!fresh->open()) {
+            delete fresh;
+            return;
+        }
+        qint64 offset = 0;
+        for (auto it = blobs.begin(); it != blobs.end(); ++it) {
+            if (!file->seek(it->offset)) continue;
+            QByteArray data = file->read(it->length);
+            if (fresh->write(data) != data.size()) {
+                delete fresh;
+                return;
+            }
+            it->offset = offset;
+            offset += data.size();
+        }
+        delete file;
+        file = fresh;
+        end = live = offset;
+        dead = 0;
+    }
+
+    QTemporaryFile *file = nullptr;
+    QHash<quint64, Blob> blobs;
+    quint64 nextId = 1;
+    qint64 end = 0;
+    qint64 live = 0;
+    qint64 dead = 0;
+};
+
+}
+
+void GapText::reset(const QString &value)
+{
+    text = value;
+    gapStart = gapEnd = int(text.size());
+}
+
+QString GapText::mid(int position, int length) const
+{
+    if (position + length <= gapStart) return text.mid(position, length);
+    if (position >= gapStart) return text.mid(position + gapEnd - gapStart, length);
+    return text.mid(position, gapStart - position) + text.mid(gapEnd, length - (gapStart - position));
+}
+
+void GapText::replace(int position, int removed, const QString &inserted)
+{
+    moveGap(position);
+    gapEnd += removed;
+
+    int length = int(inserted.size());
+    if (gapEnd - gapStart < length) {
+        int gap = length + qBound(4096, size() / 64, 1024 * 1024);
+        int tail = int(text.size()) - gapEnd;
+        QString grown(gapStart + gap + tail, Qt::Uninitialized);
+        memcpy(grown.data(), text.constData(), gapStart * sizeof(QChar));
+        memcpy(grown.data() + gapStart + gap, text.constData() + gapEnd, tail * sizeof(QChar));
+        text = grown;
+        gapEnd = gapStart + gap;
+    }
+    memcpy(text.data() + gapStart, inserted.constData(), length * sizeof(QChar));
+    gapStart += length;
+}
+
+void GapText::moveGap(int position)
+{
+    if (position == gapStart) return;
+    QChar *data = text.data();
+    if (position < gapStart) {
+        int count = gapStart - position;
+        memmove(data + gapEnd - count, data + position, count * sizeof(QChar));
+        gapStart -= count;
+        gapEnd -= count;
+    } else {
+        int count = position - gapStart;
+        memmove(data + gapStart, data + gapEnd, count * sizeof(QChar));
+        gapStart += count;
+        gapEnd += count;
+    }
+}
+
+QList<UndoHistory*> UndoHistory::histories;
+qint64 UndoHistory::totalMemory = 0;
+qint64 UndoHistory::tabBudget = UndoHistory::DefaultTabBudget;
+qint64 UndoHistory::totalBudget = UndoHistory::DefaultTotalBudget;
+
+UndoHistory::UndoHistory(QPlainTextEdit *editor)
+    : QObject(editor), editor(editor), document(editor->document()), current(0), base(0), clean(0), memory(0),
+      revision(0), applying(false), sealed(true)
+{
+    document->setUndoRedoEnabled(false);
+    resync();
+    histories.append(this);
+    sinceEdit.start();
+
+    connect(document, &QTextDocument::contentsChange, this, &UndoHistory::onContentsChange);
+    connect(document, &QTextDocument::modificationChanged, this, &UndoHistory::onModificationChanged);
+}
+
+UndoHistory::~UndoHistory()
+{
+    release(below);
+    release(above);
+    account(-memory);
+    histories.removeOne(this);
+}
+
+void UndoHistory::setBudgets(qint64 perTab, qint64 total)
+{
+    tabBudget = qMax(perTab, qint64(SpillChunk));
+    totalBudget = qMax(total, tabBudget);
+    for (UndoHistory *history : histories) {
+        history->trim();
+    }
+}
+
+bool UndoHistory::undo()
+{
+    if (editor->isReadOnly()) return false;
+    if (current == 0 && !loadBelow()) return false;
+
+    const Record record = records.at(current - 1);
+    --current;
+    apply(record.position, int(record.inserted.size()), record.removed);
+    return true;
+}
+
+bool UndoHistory::redo()
+{
+    if (editor->isReadOnly()) return false;
+    if (current == records.size() && !loadAbove()) return false;
+
+    const Record record = records.at(current);
+    ++current;
+    apply(record.position, int(record.removed.size()), record.inserted);
+    return true;
+}
+
+void UndoHistory::clear()
+{
+    release(below);
+    release(above);
+    records.clear();
+    account(-memory);
+    current = 0;
+    base = 0;
+    clean = document->isModified() ? -1 : 0;
+    sealed = true;
+}
+
+void UndoHistory::onContentsChange(int position, int removed, int added)
+{
+    Q_UNUSED(added);
+    // Re-highlighting marks blocks dirty without an edit; those leave the
+    // revision alone.
+    if (document->revision() == revision) return;
+    revision = document->revision();
+
+    // The reported counts can include the document's final paragraph
+    // separator, so the size of the insertion is taken from the lengths.
+    int oldLength = shadow.size();
+    int newLength = document->characterCount() - 1;
+    position = qBound(0, position, oldLength);
+    int removedCount = qBound(0, removed, oldLength - position);
+    int addedCount = removedCount + newLength - oldLength;
+    if (addedCount < 0 || position + addedCount > newLength) {
+        resync();
+        return;
+    }
+
+    QString before = shadow.mid(position, removedCount);
+    QString after = documentText(position, addedCount);
+    shadow.replace(position, removedCount, after);
+    if (applying || editor->isReadOnly()) return;
+
+    int prefix = 0;
+    int limit = qMin(removedCount, addedCount);
+    while (prefix < limit && before.at(prefix) == after.at(prefix)) {
+        ++prefix;
+    }
+    int suffix = 0;
+    limit -= prefix;
+    while (suffix < limit && before.at(removedCount - 1 - suffix) == after.at(addedCount - 1 - suffix)) {
+        ++suffix;
+    }
+    if (prefix + suffix == removedCount && prefix + suffix == addedCount) return;
+
+    add(position + prefix, before.mid(prefix, removedCount - prefix - suffix),
+        after.mid(prefix, addedCount - prefix - suffix));
+}
+
+void UndoHistory::onModificationChanged(bool changed)
+{
+    if (!changed) {
+        clean = base + current;
+        sealed = true;
+    }
+}
+
+void UndoHistory::add(int position, const QString &removed, const QString &inserted)
+{
+    dropRedo();
+    if (!merge(position, removed, inserted)) {
+        records.append(Record{position, removed, inserted});
+        ++current;
+        account(cost(records.last()));
+    }
+    sealed = false;
+    sinceEdit.start();
+    trim();
+}
+
+bool UndoHistory::merge(int position, const QString &removed, const QString &inserted)
+{
+    if (sealed || current == 0 || clean == base + current || sinceEdit.elapsed() > MergeMsecs) return false;
+
+    Record &top = records[current - 1];
+    qint64 before = cost(top);
+    if (removed.isEmpty()) {
+        // Typing on after the previous insertion; a new line starts a new
+        // record so undo goes back a line at a time.
+        if (position != top.position + top.inserted.size() || inserted.contains('\n')
+            || top.inserted.size() + inserted.size() > MaxMergedChars) {
+            return false;
+        }
+        top.inserted += inserted;
+    } else if (!inserted.isEmpty()) {
+        return false;
+    } else if (!top.inserted.isEmpty()) {
+        // Backspacing over what was just typed.
+        if (position + removed.size() != top.position + top.inserted.size() || removed.size() > top.inserted.size()) {
+            return false;
+        }
+        top.inserted.chop(removed.size());
+    } else if (position + removed.size() == top.position) {
+        if (top.removed.size() + removed.size() > MaxMergedChars) return false;
+        top.removed.prepend(removed);
+        top.position = position;
+    } else if (position == top.position) {
+        if (top.removed.size() + removed.size() > MaxMergedChars) return false;
+        top.removed.append(removed);
+    } else {
+        return false;
+    }
+
+    if (top.removed.isEmpty() && top.inserted.isEmpty()) {
+        records.removeLast();
+        --current;
+        account(-before);
+    } else {
+        account(cost(top) - before);
+    }
+    return true;
+}
+
+void UndoHistory::apply(int position, int length, const QString &text)
+{
+    applying = true;
+    QTextCursor cursor(document);
+    cursor.setPosition(position);
+    cursor.setPosition(position + length, QTextCursor::KeepAnchor);
+    cursor.insertText(text);
+    applying = false;
+
+    editor->setTextCursor(cursor);
+    editor->ensureCursorVisible();
+    sealed = true;
+    updateModified();
+}
+
+void UndoHistory::dropRedo()
+{
+    if (current == records.size() && above.isEmpty()) return;
+
+    qint64 freed = 0;
+    for (int i = current; i < records.size(); ++i) {
+        freed += cost(records.at(i));
+    }
+    records.resize(current);
+    account(-freed);
+
+    release(above);
+    if (clean > base + current) clean = -1;
+}
+
+bool UndoHistory::loadBelow()
+{
+    if (below.isEmpty()) return false;
+
+    SpillFile &spill = SpillFile::instance();
+    Segment segment = below.takeLast();
+    QVector<Record> loaded = decode(spill.load(segment.blob));
+    spill.release(segment.blob);
+    if (loaded.size() != segment.count) {
+        // The spill file could not be read back; what lies below is lost.
+        release(below);
+        return false;
+    }
+
+    qint64 bytes = 0;
+    for (const Record &record : loaded) {
+        bytes += cost(record);
+    }
+    records = loaded + records;
+    current += segment.count;
+    base -= segment.count;
+    account(bytes);
+    trim();
+    return current > 0;
+}
+
+bool UndoHistory::loadAbove()
+{
+    if (above.isEmpty()) return false;
+
+    SpillFile &spill = SpillFile::instance();
+    Segment segment = above.takeLast();
+    QVector<Record> loaded = decode(spill.load(segment.blob));
+    spill.release(segment.blob);
+    if (loaded.size() != segment.count) {
+        release(above);
+        return false;
+    }
+
+    qint64 bytes = 0;
+    for (const Record &record : loaded) {
+        bytes += cost(record);
+    }
+    records += loaded;
+    account(bytes);
+    trim();
+    return current < records.size();
+}
+
+bool UndoHistory::spill()
+{
+    // Records next to the current state stay in memory; of the rest, a
+    // chunk goes from whichever side holds more.
+    int lowEnd = current - KeepNear;
+    int highStart = current + KeepNear;
+    qint64 lowBytes = 0;
+    for (int i = 0; i < lowEnd; ++i) {
+        lowBytes += cost(records.at(i));
+    }
+    qint64 highBytes = 0;
+    for (int i = highStart; i < records.size(); ++i) {
+        highBytes += cost(records.at(i));
+    }
+    if (lowBytes == 0 && highBytes == 0) return false;
+
+    SpillFile &spill = SpillFile::instance();
+    qint64 bytes = 0;
+    if (lowBytes >= highBytes) {
+        int count = 0;
+        while (count < lowEnd && bytes < SpillChunk) {
+            bytes += cost(records.at(count++));
+        }
+        quint64 blob = spill.store(encode(records.constData(), count));
+        if (blob) {
+            below.append(Segment{blob, count});
+        } else {
+            release(below);
+        }
+        records.remove(0, count);
+        current -= count;
+        base += count;
+    } else {
+        int start = int(records.size());
+        while (start > highStart && bytes < SpillChunk) {
+            bytes += cost(records.at(--start));
+        }
+        int count = int(records.size()) - start;
+        quint64 blob = spill.store(encode(records.constData() + start, count));
+        if (blob) {
+            above.append(Segment{blob, count});
+        } else {
+            release(above);
+        }
+        records.resize(start);
+    }
+    account(-bytes);
+    return true;
+}
+
+void UndoHistory::trim()
+{
+    while (memory > tabBudget && spill()) {
+    }
+
+    while (totalMemory > totalBudget) {
+        QList<UndoHistory*> largest = histories;
+        std::sort(largest.begin(), largest.end(), [](UndoHistory *a, UndoHistory *b) {
+            return a->memory > b->memory;
+        });
+        bool spilled = false;
+        for (UndoHistory *history : largest) {
+            if (history->spill()) {
+                spilled = true;
+                break;
+            }
+        }
+        if (!spilled) break;
+    }
+}
+
+void UndoHistory::resync()
+{
+    // The copy no longer matches the document, so neither does the history.
+    shadow.reset(documentText(0, document->characterCount() - 1));
+    revision = document->revision();
+    clear();
+}
+
+void UndoHistory::release(QVector<Segment> &segments)
+{
+    SpillFile &spill = SpillFile::instance();
+    for (const Segment &segment : segments) {
+        spill.release(segment.blob);
+    }
+    segments.clear();
+}
+
+void UndoHistory::updateModified()
+{
+    document->setModified(clean != base + current);
+}
+
+void UndoHistory::account(qint64 bytes)
+{
+    memory += bytes;
+    totalMemory += bytes;
+}
+
+QString UndoHistory::documentText(int position, int length) const
+{
+    if (length <= 0) return QString();
+    QTextCursor cursor(document);
+    cursor.setPosition(position);
+    cursor.setPosition(position + length, QTextCursor::KeepAnchor);
+    QString text = cursor.selectedText();
+    text.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+    return text;
+}
+
+qint64 UndoHistory::cost(const Record &record)
+{
+    return qint64(sizeof(Record)) + (record.removed.size() + record.inserted.size()) * qint64(sizeof(QChar));
+}
+
+QByteArray UndoHistory::encode(const Record *records, int count)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << qint32(count);
+    for (int i = 0; i < count; ++i) {
+        stream << qint32(records[i].position) << records[i].removed << records[i].inserted;
+    }
+    return qCompress(data);
+}
+
+QVector<UndoHistory::Record> UndoHistory::decode(const QByteArray &data)
+{
+    QVector<Record> records;
+    QByteArray raw = qUncompress(data);
+    QDataStream stream(raw);
+    stream.setVersion(QDataStream::Qt_5_15);
+    qint32 count = 0;
+    stream >> count;
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        qint32 position = 0;
+        Record record;
+        stream >> position >> record.removed >> record.inserted;
+        if (stream.status() != QDataStream::Ok) break;
+        record.position = position;
+        records.append(record);
+    }
+    return records;
+}
@@ -0,0 +1,118 @@
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class QPlainTextEdit;
+class QTextDocument;
+
+// A document's text with a movable gap, so an edit next to the previous
+// one moves no text.
+class GapText
+{
+public:
+    int size() const { return int(text.size()) - (gapEnd - gapStart); }
+    void reset(const QString &value);
+    QString mid(int position, int length) const;
+    void replace(int position, int removed, const QString &inserted);
+
+private:
+    void moveGap(int position);
+
+    QString text;
+    int gapStart = 0;
+    int gapEnd = 0;
+};
+
+// Undo and redo for a CodeEditor in place of QTextDocument's own stack,
+// which keeps every removed character for the life of the document. Each
+// change is stored as the smallest replaced range, and typing or deleting
+// next to the previous edit extends that record. Records beyond the tab's
+// budget, or beyond the budget shared by all tabs, are compressed and moved
+// to a temporary file in chunks and read back when undo or redo gets there.
+class UndoHistory : public QObject
+{
+    Q_OBJECT
+public:
+    static const qint64 DefaultTabBudget = 8 * 1024 * 1024;
+    static const qint64 DefaultTotalBudget = 64 * 1024 * 1024;
+
+    UndoHistory(QPlainTextEdit *editor);
+    ~UndoHistory();
+
+    bool undo();
+    bool redo();
+    bool isUndoAvailable() const { return current > 0 || !below.isEmpty(); }
+    bool isRedoAvailable() const { return current < records.size() || !above.isEmpty(); }
+    void clear();
+    qint64 memoryUsed() const { return memory; }
+
+    static void setBudgets(qint64 perTab, qint64 total);
+    static qint64 totalMemoryUsed() { return totalMemory; }
+
+private slots:
+    void onContentsChange(int position, int removed, int added);
+    void onModificationChanged(bool changed);
+
+private:
+    static const int KeepNear = 1;
+    static const int MergeMsecs = 1000;
+    static const int MaxMergedChars = 4096;
+    static const qint64 SpillChunk = 1024 * 1024;
+
+    struct Record
+    {
+        int position;
+        QString removed;
+        QString inserted;
+    };
+
+    struct Segment
+    {
+        quint64 blob;
+        int count;
+    };
+
+    void add(int position, const QString &removed, const QString &inserted);
+    bool merge(int position, const QString &removed, const QString &inserted);
+    void apply(int position, int length, const QString &text);
+    void dropRedo();
+    bool loadBelow();
+    bool loadAbove();
+    bool spill();
+    void trim();
+    void resync();
+    void release(QVector<Segment> &segments);
+    void updateModified();
+    void account(qint64 bytes);
+    QString documentText(int position, int length) const;
+    static qint64 cost(const Record &record);
+    static QByteArray encode(const Record *records, int count);
+    static QVector<Record> decode(const QByteArray &data);
+
+    QPlainTextEdit *editor;
+    QTextDocument *document;
+    GapText shadow;
+    QVector<Record> records;
+    QVector<Segment> below;
+    QVector<Segment> above;
+    int current;
+    qint64 base;
+    qint64 clean;
+    qint64 memory;
+    QElapsedTimer sinceEdit;
+    int revision;
+    bool applying;
+    bool sealed;
+
+    static QList<UndoHistory*> histories;
+    static qint64 totalMemory;
+    static qint64 tabBudget;
+    static qint64 totalBudget;
+};
+
+#endif